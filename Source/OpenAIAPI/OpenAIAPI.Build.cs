@@ -40,7 +40,10 @@ public class OpenAIAPI : ModuleRules
 				"Slate",
 				"SlateCore",
 				"Json",
-				"HTTP"
+				"HTTP",
+				"ImageWrapper",
+				"RenderCore",
+				"RHI"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -1,12 +1,21 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "OpenAIAPI.h"
+#include "OpenAIVectorMath.h"
 
 #define LOCTEXT_NAMESPACE "FOpenAIAPIModule"
 
 void FOpenAIAPIModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+
+#if !UE_BUILD_SHIPPING
+	if (!FOpenAIVectorMath::VerifyKernels())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("OpenAIAPI SIMD vector kernels disagree with the scalar reference"));
+	}
+#endif
+	UE_LOG(LogTemp, Log, TEXT("OpenAIAPI using %s vector kernel"), FOpenAIVectorMath::GetKernelName());
 }
 
 void FOpenAIAPIModule::ShutdownModule()
@@ -0,0 +1,464 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIAudioUtils.h"
+#include "Sound/SoundWave.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	void WriteUInt32(uint8*& Out, uint32 Value)
+	{
+		FMemory::Memcpy(Out, &Value, 4);
+		Out += 4;
+	}
+
+	void WriteUInt16(uint8*& Out, uint16 Value)
+	{
+		FMemory::Memcpy(Out, &Value, 2);
+		Out += 2;
+	}
+
+	constexpr int32 WavHeaderSize = 44;
+
+	// little endian RIFF header for 16 bit PCM, the platforms we ship on are all little endian
+	void WriteWavHeader(uint8* Out, uint32 DataSize, int32 NumChannels, int32 SampleRate)
+	{
+		const uint32 BlockAlign = NumChannels * sizeof(int16);
+		FMemory::Memcpy(Out, "RIFF", 4); Out += 4;
+		WriteUInt32(Out, 36 + DataSize);
+		FMemory::Memcpy(Out, "WAVEfmt ", 8); Out += 8;
+		WriteUInt32(Out, 16);
+		WriteUInt16(Out, 1);
+		WriteUInt16(Out, NumChannels);
+		WriteUInt32(Out, SampleRate);
+		WriteUInt32(Out, SampleRate * BlockAlign);
+		WriteUInt16(Out, BlockAlign);
+		WriteUInt16(Out, 16);
+		FMemory::Memcpy(Out, "data", 4); Out += 4;
+		WriteUInt32(Out, DataSize);
+	}
+
+	uint32 ReadUInt32(const uint8* In)
+	{
+		uint32 Value;
+		FMemory::Memcpy(&Value, In, 4);
+		return Value;
+	}
+
+	uint16 ReadUInt16(const uint8* In)
+	{
+		uint16 Value;
+		FMemory::Memcpy(&Value, In, 2);
+		return Value;
+	}
+
+	// sinc zero crossings kept on each side of the resampling kernel and its table resolution per input sample
+	constexpr int32 ResampleZeroCrossings = 8;
+	constexpr int32 KernelOversample = 256;
+	constexpr int32 ResampleBlockSize = 4096;
+
+	constexpr float VoiceFrameSeconds = 0.02f;
+	// zero crossings per sample above which a quiet frame sounds like a fricative rather than hum
+	constexpr float FricativeCrossingRate = 0.25f;
+	constexpr float FricativeMarginDb = 6.0f;
+	// the floor never goes below digital near-silence, so a gated mic does not turn its own noise into speech
+	constexpr float MinNoiseFloorDb = -70.0f;
+}
+
+TArray<uint8> FOpenAIAudioUtils::EncodeWav(TArrayView<const float> Samples, int32 NumChannels, int32 SampleRate)
+{
+	TArray<uint8> Wav;
+	Wav.SetNumUninitialized(WavHeaderSize + Samples.Num() * sizeof(int16));
+	WriteWavHeader(Wav.GetData(), Samples.Num() * sizeof(int16), NumChannels, SampleRate);
+
+	int16* PCM = reinterpret_cast<int16*>(Wav.GetData() + WavHeaderSize);
+	for (int32 i = 0; i < Samples.Num(); ++i)
+	{
+		PCM[i] = (int16)FMath::RoundToInt(FMath::Clamp(Samples[i], -1.0f, 1.0f) * 32767.0f);
+	}
+	return Wav;
+}
+
+bool FOpenAIAudioUtils::DecodeWav(TArrayView<const uint8> Wav, TArray<float>& OutSamples, int32& OutSampleRate, int32& OutNumChannels)
+{
+	OutSamples.Reset();
+	if (Wav.Num() < 12 || FMemory::Memcmp(Wav.GetData(), "RIFF", 4) != 0 || FMemory::Memcmp(Wav.GetData() + 8, "WAVE", 4) != 0)
+	{
+		return false;
+	}
+
+	uint16 Format = 0;
+	uint16 BitsPerSample = 0;
+	OutNumChannels = 0;
+	OutSampleRate = 0;
+
+	int64 Offset = 12;
+	while (Offset + 8 <= Wav.Num())
+	{
+		const uint8* Chunk = Wav.GetData() + Offset;
+		const int64 ChunkSize = FMath::Min<int64>(ReadUInt32(Chunk + 4), Wav.Num() - Offset - 8);
+
+		if (FMemory::Memcmp(Chunk, "fmt ", 4) == 0 && ChunkSize >= 16)
+		{
+			Format = ReadUInt16(Chunk + 8);
+			OutNumChannels = ReadUInt16(Chunk + 10);
+			OutSampleRate = ReadUInt32(Chunk + 12);
+			BitsPerSample = ReadUInt16(Chunk + 22);
+
+			// WAVE_FORMAT_EXTENSIBLE keeps the real format in the first two bytes of the sub format guid
+			if (Format == 0xFFFE && ChunkSize >= 26)
+			{
+				Format = ReadUInt16(Chunk + 32);
+			}
+		}
+		else if (FMemory::Memcmp(Chunk, "data", 4) == 0)
+		{
+			if (OutNumChannels == 0 || OutSampleRate == 0)
+			{
+				return false;
+			}
+
+			const bool bSupported = (Format == 1 && (BitsPerSample == 8 || BitsPerSample == 16 || BitsPerSample == 24 || BitsPerSample == 32))
+				|| (Format == 3 && BitsPerSample == 32);
+			if (!bSupported)
+			{
+				return false;
+			}
+
+			const uint8* Data = Chunk + 8;
+			const int32 BytesPerSample = BitsPerSample / 8;
+			const int32 NumSamples = (int32)(ChunkSize / BytesPerSample);
+			OutSamples.SetNumUninitialized(NumSamples);
+
+			if (Format == 1 && BitsPerSample == 16)
+			{
+				for (int32 i = 0; i < NumSamples; ++i)
+				{
+					OutSamples[i] = (int16)ReadUInt16(Data + i * 2) / 32768.0f;
+				}
+			}
+			else if (Format == 1 && BitsPerSample == 8)
+			{
+				for (int32 i = 0; i < NumSamples; ++i)
+				{
+					OutSamples[i] = (Data[i] - 128) / 128.0f;
+				}
+			}
+			else if (Format == 1 && BitsPerSample == 24)
+			{
+				for (int32 i = 0; i < NumSamples; ++i)
+				{
+					const uint8* Sample = Data + i * 3;
+					const int32 Value = (int32)(((uint32)Sample[0] << 8) | ((uint32)Sample[1] << 16) | ((uint32)Sample[2] << 24)) >> 8;
+					OutSamples[i] = Value / 8388608.0f;
+				}
+			}
+			else if (Format == 1 && BitsPerSample == 32)
+			{
+				for (int32 i = 0; i < NumSamples; ++i)
+				{
+					OutSamples[i] = (int32)ReadUInt32(Data + i * 4) / 2147483648.0f;
+				}
+			}
+			else
+			{
+				FMemory::Memcpy(OutSamples.GetData(), Data, NumSamples * sizeof(float));
+			}
+			return true;
+		}
+
+		// chunks are padded to an even size
+		Offset += 8 + ChunkSize + (ChunkSize & 1);
+	}
+	return false;
+}
+
+TArray<float> FOpenAIAudioUtils::DownmixToMono(TArrayView<const float> Samples, int32 NumChannels)
+{
+	if (NumChannels <= 1)
+	{
+		return TArray<float>(Samples.GetData(), Samples.Num());
+	}
+
+	const int32 NumFrames = Samples.Num() / NumChannels;
+	const float Scale = 1.0f / NumChannels;
+
+	TArray<float> Mono;
+	Mono.SetNumUninitialized(NumFrames);
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		const float* In = Samples.GetData() + Frame * NumChannels;
+		float Sum = 0.0f;
+		for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+		{
+			Sum += In[Channel];
+		}
+		Mono[Frame] = Sum * Scale;
+	}
+	return Mono;
+}
+
+TArray<float> FOpenAIAudioUtils::Resample(TArrayView<const float> Samples, int32 FromRate, int32 ToRate)
+{
+	if (FromRate == ToRate || FromRate <= 0 || ToRate <= 0 || Samples.Num() == 0)
+	{
+		return TArray<float>(Samples.GetData(), Samples.Num());
+	}
+
+	const double Step = (double)FromRate / ToRate;
+	const float Cutoff = FMath::Min(1.0f, (float)ToRate / FromRate);
+	const int32 HalfWidth = FMath::CeilToInt(ResampleZeroCrossings / Cutoff);
+
+	// Blackman windowed sinc with its cutoff at the lower Nyquist frequency, tabulated by distance in input samples
+	TArray<float> Kernel;
+	Kernel.SetNumUninitialized(HalfWidth * KernelOversample + 2);
+	for (int32 k = 0; k < Kernel.Num(); ++k)
+	{
+		const float X = (float)k / KernelOversample;
+		const float W = FMath::Clamp(X / HalfWidth, 0.0f, 1.0f);
+		const float Window = 0.42f + 0.5f * FMath::Cos(PI * W) + 0.08f * FMath::Cos(2.0f * PI * W);
+		const float Arg = PI * Cutoff * X;
+		const float Sinc = k == 0 ? 1.0f : FMath::Sin(Arg) / Arg;
+		Kernel[k] = Cutoff * Sinc * Window;
+	}
+
+	const int32 NumOut = (int32)(Samples.Num() / Step);
+	TArray<float> Out;
+	Out.SetNumUninitialized(NumOut);
+
+	const int32 NumBlocks = FMath::DivideAndRoundUp(NumOut, ResampleBlockSize);
+	ParallelFor(NumBlocks, [&](int32 Block)
+	{
+		const int32 End = FMath::Min(NumOut, (Block + 1) * ResampleBlockSize);
+		for (int32 i = Block * ResampleBlockSize; i < End; ++i)
+		{
+			const double Center = i * Step;
+			const int32 First = FMath::Max(0, FMath::FloorToInt(Center) - HalfWidth + 1);
+			const int32 Last = FMath::Min(Samples.Num() - 1, FMath::FloorToInt(Center) + HalfWidth);
+
+			float Sum = 0.0f;
+			for (int32 j = First; j <= Last; ++j)
+			{
+				const int32 Tap = FMath::RoundToInt(FMath::Abs(Center - j) * KernelOversample);
+				Sum += Samples[j] * Kernel[FMath::Min(Tap, Kernel.Num() - 1)];
+			}
+			Out[i] = Sum;
+		}
+	});
+	return Out;
+}
+
+TArray<FAudioSpeechSpan> FOpenAIAudioUtils::DetectSpeech(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, const FVoiceActivitySettings& Settings)
+{
+	TArray<FAudioSpeechSpan> Spans;
+
+	const int32 FrameLength = FMath::Max(1, FMath::RoundToInt(SampleRate * VoiceFrameSeconds));
+	const int32 NumFrames = Samples.Num() / NumChannels / FrameLength;
+	if (NumFrames == 0)
+	{
+		return Spans;
+	}
+
+	TArray<float> EnergyDb;
+	TArray<float> CrossingRate;
+	EnergyDb.SetNumUninitialized(NumFrames);
+	CrossingRate.SetNumUninitialized(NumFrames);
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		const float* In = Samples.GetData() + Frame * FrameLength * NumChannels;
+		double SumSquares = 0.0;
+		int32 Crossings = 0;
+		float Previous = 0.0f;
+		for (int32 i = 0; i < FrameLength; ++i)
+		{
+			float Sample = 0.0f;
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				Sample += In[i * NumChannels + Channel];
+			}
+			Sample /= NumChannels;
+
+			SumSquares += Sample * Sample;
+			Crossings += (i > 0 && (Sample >= 0.0f) != (Previous >= 0.0f)) ? 1 : 0;
+			Previous = Sample;
+		}
+		EnergyDb[Frame] = 10.0f * FMath::LogX(10.0f, (float)(SumSquares / FrameLength) + 1e-10f);
+		CrossingRate[Frame] = (float)Crossings / FrameLength;
+	}
+
+	// the quietest tenth of the clip is taken as the noise floor
+	TArray<float> Sorted = EnergyDb;
+	Sorted.Sort();
+	const float NoiseFloor = FMath::Max(Sorted[NumFrames / 10], MinNoiseFloorDb);
+	const float Threshold = NoiseFloor + Settings.thresholdDb;
+
+	const int32 MinSilenceFrames = FMath::CeilToInt(Settings.minSilenceSeconds / VoiceFrameSeconds);
+	const int32 MinSpeechFrames = FMath::CeilToInt(Settings.minSpeechSeconds / VoiceFrameSeconds);
+	const float Duration = (float)(Samples.Num() / NumChannels) / SampleRate;
+
+	int32 SpanStart = INDEX_NONE;
+	int32 LastSpeech = INDEX_NONE;
+	auto CloseSpan = [&]()
+	{
+		if (SpanStart != INDEX_NONE && LastSpeech - SpanStart + 1 >= MinSpeechFrames)
+		{
+			FAudioSpeechSpan Span;
+			Span.startTime = FMath::Max(0.0f, SpanStart * VoiceFrameSeconds - Settings.paddingSeconds);
+			Span.endTime = FMath::Min(Duration, (LastSpeech + 1) * VoiceFrameSeconds + Settings.paddingSeconds);
+
+			// padding can make neighbouring spans touch
+			if (Spans.Num() > 0 && Span.startTime <= Spans.Last().endTime)
+			{
+				Spans.Last().endTime = Span.endTime;
+			}
+			else
+			{
+				Spans.Add(Span);
+			}
+		}
+		SpanStart = INDEX_NONE;
+	};
+
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		const bool bSpeech = EnergyDb[Frame] > Threshold
+			|| (EnergyDb[Frame] > Threshold - FricativeMarginDb && CrossingRate[Frame] > FricativeCrossingRate);
+		if (!bSpeech)
+		{
+			if (SpanStart != INDEX_NONE && Frame - LastSpeech > MinSilenceFrames)
+			{
+				CloseSpan();
+			}
+			continue;
+		}
+
+		if (SpanStart == INDEX_NONE)
+		{
+			SpanStart = Frame;
+		}
+		LastSpeech = Frame;
+	}
+	CloseSpan();
+
+	return Spans;
+}
+
+TArray<float> FOpenAIAudioUtils::KeepSpans(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, TArrayView<const FAudioSpeechSpan> Spans, float MaxPauseSeconds)
+{
+	const int32 NumFrames = Samples.Num() / NumChannels;
+	auto ToFrame = [SampleRate, NumFrames](float Seconds)
+	{
+		return FMath::Clamp(FMath::RoundToInt(Seconds * SampleRate), 0, NumFrames);
+	};
+
+	TArray<float> Out;
+	Out.Reserve(Samples.Num());
+	for (int32 i = 0; i < Spans.Num(); ++i)
+	{
+		const int32 First = ToFrame(Spans[i].startTime);
+		const int32 Last = FMath::Max(First, ToFrame(Spans[i].endTime));
+
+		// keep the start of the pause before this span, up to MaxPauseSeconds of it
+		if (i > 0)
+		{
+			const int32 PauseStart = ToFrame(Spans[i - 1].endTime);
+			int32 PauseFrames = FMath::Max(0, First - PauseStart);
+			if (MaxPauseSeconds > 0.0f)
+			{
+				PauseFrames = FMath::Min(PauseFrames, FMath::RoundToInt(MaxPauseSeconds * SampleRate));
+			}
+			Out.Append(Samples.GetData() + PauseStart * NumChannels, PauseFrames * NumChannels);
+		}
+		Out.Append(Samples.GetData() + First * NumChannels, (Last - First) * NumChannels);
+	}
+	return Out;
+}
+
+bool FOpenAIAudioUtils::Preprocess(TArray<float>& Samples, int32& SampleRate, int32& NumChannels, const FAudioPreprocessSettings& Settings, TArray<FAudioSpeechSpan>* OutSpans)
+{
+	bool bChanged = false;
+	if (Settings.downmixToMono && NumChannels > 1)
+	{
+		Samples = DownmixToMono(Samples, NumChannels);
+		NumChannels = 1;
+		bChanged = true;
+	}
+
+	// the resampler works on mono, multichannel audio is resampled one channel at a time
+	if (Settings.sampleRate > 0 && Settings.sampleRate != SampleRate)
+	{
+		if (NumChannels == 1)
+		{
+			Samples = Resample(Samples, SampleRate, Settings.sampleRate);
+		}
+		else
+		{
+			const int32 NumFrames = Samples.Num() / NumChannels;
+			TArray<float> Interleaved;
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				TArray<float> ChannelSamples;
+				ChannelSamples.SetNumUninitialized(NumFrames);
+				for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+				{
+					ChannelSamples[Frame] = Samples[Frame * NumChannels + Channel];
+				}
+
+				const TArray<float> Resampled = Resample(ChannelSamples, SampleRate, Settings.sampleRate);
+				Interleaved.SetNumZeroed(Resampled.Num() * NumChannels);
+				for (int32 Frame = 0; Frame < Resampled.Num(); ++Frame)
+				{
+					Interleaved[Frame * NumChannels + Channel] = Resampled[Frame];
+				}
+			}
+			Samples = MoveTemp(Interleaved);
+		}
+		SampleRate = Settings.sampleRate;
+		bChanged = true;
+	}
+
+	if (Settings.trimSilence)
+	{
+		const TArray<FAudioSpeechSpan> Spans = DetectSpeech(Samples, SampleRate, NumChannels, Settings.voiceActivity);
+		Samples = KeepSpans(Samples, SampleRate, NumChannels, Spans, Settings.maxPauseSeconds);
+		if (OutSpans)
+		{
+			*OutSpans = Spans;
+		}
+		bChanged = true;
+	}
+	return bChanged;
+}
+
+TArray<uint8> FOpenAIAudioUtils::WrapPCM16AsWav(TArrayView<const uint8> PCM, int32 NumChannels, int32 SampleRate)
+{
+	TArray<uint8> Wav;
+	Wav.SetNumUninitialized(WavHeaderSize + PCM.Num());
+	WriteWavHeader(Wav.GetData(), PCM.Num(), NumChannels, SampleRate);
+	FMemory::Memcpy(Wav.GetData() + WavHeaderSize, PCM.GetData(), PCM.Num());
+	return Wav;
+}
+
+void FOpenAIAudioUtils::PCM16ToFloat(const int16* PCM, int32 NumSamples, TArray<float>& OutSamples)
+{
+	OutSamples.SetNumUninitialized(NumSamples);
+	for (int32 i = 0; i < NumSamples; ++i)
+	{
+		OutSamples[i] = PCM[i] / 32768.0f;
+	}
+}
+
+bool FOpenAIAudioUtils::GetSoundWaveSamples(const USoundWave* SoundWave, TArray<float>& OutSamples, int32& OutSampleRate, int32& OutNumChannels)
+{
+	check(IsInGameThread());
+
+	if (!SoundWave || !SoundWave->RawPCMData || SoundWave->RawPCMDataSize <= 0 || SoundWave->NumChannels <= 0)
+	{
+		return false;
+	}
+
+	OutNumChannels = SoundWave->NumChannels;
+	OutSampleRate = (int32)SoundWave->GetSampleRateForCurrentPlatform();
+	PCM16ToFloat(reinterpret_cast<const int16*>(SoundWave->RawPCMData), SoundWave->RawPCMDataSize / sizeof(int16), OutSamples);
+	return true;
+}
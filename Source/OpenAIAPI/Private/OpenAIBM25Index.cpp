@@ -0,0 +1,143 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIBM25Index.h"
+#include "OpenAIVectorMath.h"
+#include "Algo/Unique.h"
+
+namespace
+{
+	bool IsTermChar(TCHAR Char)
+	{
+		return FChar::IsAlnum(Char) || Char == TEXT('_') || Char == TEXT('-');
+	}
+}
+
+FOpenAIBM25Index::FOpenAIBM25Index(float InK1, float InB)
+	: K1(InK1)
+	, B(InB)
+{
+}
+
+TArray<FString> FOpenAIBM25Index::Tokenize(const FString& Text)
+{
+	TArray<FString> Terms;
+
+	const TCHAR* Data = *Text;
+	const int32 Len = Text.Len();
+	int32 Cursor = 0;
+	while (Cursor < Len)
+	{
+		while (Cursor < Len && !IsTermChar(Data[Cursor]))
+		{
+			Cursor++;
+		}
+		const int32 Start = Cursor;
+		while (Cursor < Len && IsTermChar(Data[Cursor]))
+		{
+			Cursor++;
+		}
+
+		// trim joiners so "-" or a trailing "_" doesn't form its own term
+		int32 TermStart = Start;
+		int32 TermEnd = Cursor;
+		while (TermStart < TermEnd && !FChar::IsAlnum(Data[TermStart]))
+		{
+			TermStart++;
+		}
+		while (TermEnd > TermStart && !FChar::IsAlnum(Data[TermEnd - 1]))
+		{
+			TermEnd--;
+		}
+		if (TermEnd > TermStart)
+		{
+			Terms.Add(Text.Mid(TermStart, TermEnd - TermStart).ToLower());
+		}
+	}
+	return Terms;
+}
+
+bool FOpenAIBM25Index::AddDocument(int32 Document, const FString& Text)
+{
+	// count terms outside the lock, only the merge needs it
+	TMap<FString, int32> Frequencies;
+	const TArray<FString> Terms = Tokenize(Text);
+	for (const FString& Term : Terms)
+	{
+		Frequencies.FindOrAdd(Term)++;
+	}
+
+	FWriteScopeLock WriteLock(Lock);
+
+	if (Document != DocumentLengths.Num())
+	{
+		return false;
+	}
+	DocumentLengths.Add(Terms.Num());
+	TotalLength += Terms.Num();
+
+	for (const TPair<FString, int32>& Frequency : Frequencies)
+	{
+		int32& TermId = TermIds.FindOrAdd(Frequency.Key, INDEX_NONE);
+		if (TermId == INDEX_NONE)
+		{
+			TermId = Postings.AddDefaulted();
+		}
+		Postings[TermId].Add({ Document, Frequency.Value });
+	}
+	return true;
+}
+
+int32 FOpenAIBM25Index::Num() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return DocumentLengths.Num();
+}
+
+TArray<FHDVectorSearchResult> FOpenAIBM25Index::Search(const FString& Query, int32 TopK) const
+{
+	TArray<FString> QueryTerms = Tokenize(Query);
+	QueryTerms.Sort();
+	QueryTerms.SetNum(Algo::Unique(QueryTerms));
+
+	FReadScopeLock ReadLock(Lock);
+
+	const int32 NumDocuments = DocumentLengths.Num();
+	if (NumDocuments == 0 || QueryTerms.Num() == 0 || TopK <= 0)
+	{
+		return {};
+	}
+
+	const float AverageLength = FMath::Max((float)((double)TotalLength / NumDocuments), 1.0f);
+
+	TMap<int32, float> Scores;
+	for (const FString& Term : QueryTerms)
+	{
+		const int32* TermId = TermIds.Find(Term);
+		if (!TermId)
+		{
+			continue;
+		}
+
+		const TArray<FPosting>& TermPostings = Postings[*TermId];
+		const float DocumentFrequency = (float)TermPostings.Num();
+		const float Idf = FMath::Loge(1.0f + (NumDocuments - DocumentFrequency + 0.5f) / (DocumentFrequency + 0.5f));
+
+		for (const FPosting& Posting : TermPostings)
+		{
+			const float Frequency = (float)Posting.Frequency;
+			const float LengthNorm = 1.0f - B + B * DocumentLengths[Posting.Document] / AverageLength;
+			Scores.FindOrAdd(Posting.Document) += Idf * Frequency * (K1 + 1.0f) / (Frequency + K1 * LengthNorm);
+		}
+	}
+
+	TArray<FHDVectorSearchResult> Heap;
+	for (const TPair<int32, float>& Score : Scores)
+	{
+		FHDVectorSearchResult Result;
+		Result.Index = Score.Key;
+		Result.Score = Score.Value;
+		FOpenAIVectorMath::PushTopResult(Heap, TopK, Result);
+	}
+	Heap.Sort([](const FHDVectorSearchResult& Left, const FHDVectorSearchResult& Right) { return Left.Score > Right.Score; });
+	return Heap;
+}
@@ -7,6 +7,8 @@
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
 #include "OpenAIParser.h"
+#include "OpenAIAsyncJson.h"
+#include "OpenAIClient.h"
 
 UOpenAICallChat::UOpenAICallChat()
 {
@@ -35,196 +37,175 @@ void UOpenAICallChat::Activate()
 	if (ApiKey.IsEmpty())
 	{
 		Finished.Broadcast({}, TEXT("Api key is not set"), false);
-	}	else
-	{
-	
-		TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+		return;
+	}
+
+	// kept alive while the body is built and the request is in flight
+	AddToRoot();
 
-		FString ApiModelName;
-		switch (ChatSettings.model)
+	// long histories take a while to serialize, the body is built on a worker
+	TWeakObjectPtr<UOpenAICallChat> WeakThis(this);
+	FOpenAIAsyncJson::BuildPayload([Settings = ChatSettings]()
+	{
+		return FOpenAIClient::MakeChatPayload(Settings);
+	},
+	[WeakThis, ApiKey](FString&& Payload)
+	{
+		if (WeakThis.IsValid())
 		{
-		case EOAChatEngineType::GPT_3_5_TURBO:
-			ApiModelName = "gpt-3.5-turbo";
-			break;
-		case EOAChatEngineType::GPT_4:
-			ApiModelName = "gpt-4";
-			break;
-		case EOAChatEngineType::GPT_4_32k:
-			ApiModelName = "gpt-4-32k";
-			break;
-		case EOAChatEngineType::GPT_4_TURBO:
-			ApiModelName = "gpt-4-0125-preview";
-			break;
-		case EOAChatEngineType::CUSTOM:
-			ApiModelName = ChatSettings.customModelName;
-			break;
+			WeakThis->SendRequest(ApiKey, Payload);
 		}
-		
-		//TODO: add aditional params to match the ones listed in the curl response in: https://platform.openai.com/docs/api-reference/making-requests
-	
-		// convert parameters to strings
-		FString TempHeader = "Bearer ";
-		TempHeader += ApiKey;
-
-		// set headers
-		FString Url = UOpenAIUtils::GetApiURL();
-		HttpRequest->SetURL(Url);
-		HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-		HttpRequest->SetHeader(TEXT("Authorization"), TempHeader);
-
-		//build payload
-		TSharedPtr<FJsonObject> PayloadObject = MakeShareable(new FJsonObject());
-		PayloadObject->SetStringField(TEXT("model"), ApiModelName);
-		PayloadObject->SetNumberField(TEXT("max_tokens"), ChatSettings.maxTokens);
-		PayloadObject->SetBoolField(TEXT("stream"), ChatSettings.stream);
-
-		
-		// convert role enum to model string
-		if (!(ChatSettings.messages.Num() == 0))
+	});
+}
+
+void UOpenAICallChat::SendRequest(const FString& ApiKey, const FString& Payload)
+{
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+
+	//TODO: add aditional params to match the ones listed in the curl response in: https://platform.openai.com/docs/api-reference/making-requests
+
+	// convert parameters to strings
+	FString TempHeader = "Bearer ";
+	TempHeader += ApiKey;
+
+	// set headers
+	FString Url = UOpenAIUtils::GetApiURL();
+	HttpRequest->SetURL(Url);
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	HttpRequest->SetHeader(TEXT("Authorization"), TempHeader);
+
+	// commit request
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetContentAsString(Payload);
+	int32 ProcessedChunks = 0;
+
+	if (HttpRequest->ProcessRequest())
+	{
+		HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallChat::OnResponse);
+
+		if (ChatSettings.stream)
 		{
-			TArray<TSharedPtr<FJsonValue>> Messages;
-			FString role;
-			for (int i = 0; i < ChatSettings.messages.Num(); i++)
+			TWeakObjectPtr<UOpenAICallChat> WeakThis(this);
+			HttpRequest->OnRequestProgress64().BindLambda([WeakThis](FHttpRequestPtr HttpRequest, uint64 BytesSent, uint64 InBytesReceived)
 			{
-				TSharedPtr<FJsonObject> Message = MakeShareable(new FJsonObject());
-				switch (ChatSettings.messages[i].role)
+				FHttpResponsePtr HttpResponse = HttpRequest->GetResponse();
+				if (WeakThis.IsValid() && HttpResponse.IsValid() && EHttpResponseCodes::IsOk(HttpResponse->GetResponseCode()))
 				{
-				case EOAChatRole::USER:
-					role = "user";
-					break;
-				case EOAChatRole::ASSISTANT:
-					role = "assistant";
-					break;
-				case EOAChatRole::SYSTEM:
-					role = "system";
-					break;
+					WeakThis->ProcessStreamBytes(HttpResponse->GetContent(), false);
 				}
-				Message->SetStringField(TEXT("role"), role);
-				Message->SetStringField(TEXT("content"), ChatSettings.messages[i].content);
-				Messages.Add(MakeShareable(new FJsonValueObject(Message)));
-			}
-			PayloadObject->SetArrayField(TEXT("messages"), Messages);
+			});
 		}
+	}
+	else
+	{
+		Finish({}, TEXT("Error sending request"), false);
+	}
+}
 
-		// convert payload to string
-		FString Payload;
-		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Payload);
-		FJsonSerializer::Serialize(PayloadObject.ToSharedRef(), Writer);
-
-		// commit request
-		HttpRequest->SetVerb(TEXT("POST"));
-		HttpRequest->SetContentAsString(Payload);
-		int32 ProcessedChunks = 0;
+void UOpenAICallChat::ProcessStreamBytes(const TArray<uint8>& Content, bool bComplete)
+{
+	if (bFinished)
+	{
+		return;
+	}
 
-		if (HttpRequest->ProcessRequest())
+	// only complete lines past the cursor are parsed, a line still arriving is picked up by the next progress event
+	FChatCompletion Last;
+	FString Delta;
+	bool bDidFinish = false;
+	for (int32 LineEnd = StreamBytesParsed; LineEnd < Content.Num() && !bDidFinish; LineEnd++)
+	{
+		if (Content[LineEnd] != '\n')
 		{
-			HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallChat::OnResponse);
+			continue;
+		}
 
-			if (ChatSettings.stream)
-			{
-				HttpRequest->OnRequestProgress64().BindLambda([this](FHttpRequestPtr HttpRequest, uint64 BytesSent, uint64 InBytesReceived)
-				{
-					FHttpResponsePtr HttpResponse = HttpRequest->GetResponse();
-					if (HttpResponse.IsValid())
-					{
-						FString Content = *HttpResponse->GetContentAsString();
-						TArray<TSharedPtr<FJsonObject>> JsonChunks = ProcessStreamChunkString(Content);
-
-						if (!JsonChunks.IsEmpty())
-						{
-							//Check if we finished
-							FChatCompletion Completion = MessageFromJsonChunk(JsonChunks.Last());
-							bool bDidFinish = !Completion.finishReason.IsEmpty();
-
-							if (bDidFinish)
-							{
-								Completion.message.content = FullMessageFromJsonChunks(JsonChunks);
-								Finished.Broadcast(Completion, "", true);
-							}
-							//Stream since last emit
-							else if (Streaming.IsBound())
-							{
-								//Grab all chunks from last emitted index
-								int32 Start = LastEmittedIndex;
-								FString Delta;
-
-								for (int32 i = Start; i < JsonChunks.Num(); i++)
-								{
-									auto Chunk = JsonChunks[i];
-									FChatCompletion PartialCompletion = MessageFromJsonChunk(Chunk);
-									Delta += PartialCompletion.message.content;
-								}
-
-								LastEmittedIndex = JsonChunks.Num();
-
-								//change content
-								Completion.message.content = Delta;
-
-								Streaming.Broadcast(Completion, "", true);
-							}
-						}
-					}
-				});
-			}
+		const FUTF8ToTCHAR Converted((const ANSICHAR*)Content.GetData() + StreamBytesParsed, LineEnd - StreamBytesParsed);
+		const FString Line = FString(Converted.Length(), Converted.Get()).TrimStartAndEnd();
+		StreamBytesParsed = LineEnd + 1;
+
+		//ignore pings and the end marker
+		if (!Line.StartsWith(TEXT("data:")) || Line.EndsWith(TEXT("[DONE]")))
+		{
+			continue;
 		}
-		else
+
+		TSharedPtr<FJsonObject> Chunk;
+		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Line.RightChop(5).TrimStart());
+		if (!FJsonSerializer::Deserialize(Reader, Chunk) || !Chunk.IsValid())
 		{
-			Finished.Broadcast({}, ("Error sending request"), false);
+			continue;
 		}
+
+		Last = MessageFromJsonChunk(Chunk);
+		Delta += Last.message.content;
+		bDidFinish = !Last.finishReason.IsEmpty();
+	}
+
+	StreamedMessage += Delta;
+	if (!Delta.IsEmpty() && Streaming.IsBound())
+	{
+		FChatCompletion Partial = Last;
+		Partial.message.content = Delta;
+		Streaming.Broadcast(Partial, "", true);
+	}
+
+	// a stream that ends without a finish reason still delivers what arrived
+	if (bDidFinish || bComplete)
+	{
+		Last.message.content = StreamedMessage;
+		Finish(Last, "", true);
 	}
 }
 
+void UOpenAICallChat::Finish(const FChatCompletion& Completion, const FString& ErrorMessage, bool Success)
+{
+	if (bFinished)
+	{
+		return;
+	}
+	bFinished = true;
+
+	Finished.Broadcast(Completion, ErrorMessage, Success);
+
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
+
 void UOpenAICallChat::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
 {
 	// print response as debug message
 	if (!WasSuccessful)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s \n%s"), *Response->GetContentAsString(), *Response->GetURL());
-		if (Finished.IsBound())
-		{
-			Finished.Broadcast({}, *Response->GetContentAsString(), false);
-		}
-
+		Finish({}, *Response->GetContentAsString(), false);
 		return;
 	}
 
-	TSharedPtr<FJsonObject> ResponseObject;
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(Reader, ResponseObject))
+	// streamed responses are delivered by the progress updates, the body is not one JSON object. The last lines may not have had one yet
+	if (ChatSettings.stream && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
 	{
-		bool bError = ResponseObject->HasField(TEXT("error"));
+		ProcessStreamBytes(Response->GetContent(), true);
+		return;
+	}
 
-		//look for empty messages error
-		if (!bError)
+	TWeakObjectPtr<UOpenAICallChat> WeakThis(this);
+	FOpenAIAsyncJson::ParseResponse<TOpenAIResult<FChatCompletion>>(Response, [Settings = ChatSettings, Response](const TSharedPtr<FJsonObject>& ResponseObject)
+	{
+		TOpenAIResult<FChatCompletion> Parsed = FOpenAIClient::ParseChat(ResponseObject, Settings);
+		if (!Parsed.bSuccess)
 		{
-			bool bHasDetail = ResponseObject->HasField(TEXT("detail"));
-			if (bHasDetail)
-			{
-				auto DetailArray = ResponseObject->GetArrayField(TEXT("detail"));
-				if (DetailArray.Num() > 0)
-				{
-					FString DetailType = DetailArray[0]->AsObject()->GetStringField(TEXT("type"));
-					if (DetailType == TEXT("missing"))
-					{
-						bError = true;
-					}
-				}
-			}
+			UE_LOG(LogTemp, Warning, TEXT("UOpenAICallChat::OnResponse error: %s"), *Response->GetContentAsString());
 		}
-		
-
-		if (bError)
+		return Parsed;
+	},
+	[WeakThis](TOpenAIResult<FChatCompletion>&& Parsed)
+	{
+		if (WeakThis.IsValid())
 		{
-			UE_LOG(LogTemp, Warning, TEXT("UOpenAICallChat::OnResponse error: %s"), *Response->GetContentAsString());
-			Finished.Broadcast({}, TEXT("Api error"), false);
-			return;
+			WeakThis->Finish(Parsed.Value, Parsed.ErrorMessage, Parsed.bSuccess);
 		}
-
-		OpenAIParser parser(ChatSettings);
-		FChatCompletion Out = parser.ParseChatCompletion(*ResponseObject);
-
-		Finished.Broadcast(Out, "", true);
-	}
+	});
 }
 
 TArray<TSharedPtr<FJsonObject>> UOpenAICallChat::ProcessStreamChunkString(const FString& Chunk)
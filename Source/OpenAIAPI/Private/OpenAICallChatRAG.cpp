@@ -0,0 +1,219 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallChatRAG.h"
+#include "OpenAIEmbedding.h"
+#include "OpenAIUtils.h"
+#include "OpenAIVectorIndex.h"
+#include "Async/Async.h"
+#include "Http.h"
+
+namespace
+{
+	// rough token estimate for English text, good enough to budget a prompt without a tokenizer
+	constexpr int32 CharsPerToken = 4;
+}
+
+UOpenAICallChatRAG::UOpenAICallChatRAG()
+{
+}
+
+UOpenAICallChatRAG::~UOpenAICallChatRAG()
+{
+}
+
+UOpenAICallChatRAG* UOpenAICallChatRAG::OpenAICallChatRAG(UOpenAIVectorIndex* IndexInput, FString QueryInput, FChatSettings ChatSettingsInput, FRetrievalSettings RetrievalSettingsInput)
+{
+	UOpenAICallChatRAG* BPNode = NewObject<UOpenAICallChatRAG>();
+	BPNode->Index = IndexInput;
+	BPNode->Query = QueryInput;
+	BPNode->ChatSettings = ChatSettingsInput;
+	BPNode->RetrievalSettings = RetrievalSettingsInput;
+	return BPNode;
+}
+
+void UOpenAICallChatRAG::Activate()
+{
+	FString ApiKey;
+	if (UOpenAIUtils::GetUseApiKeyFromEnvironmentVars())
+		ApiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		ApiKey = UOpenAIUtils::GetApiKey();
+
+	if (ApiKey.IsEmpty())
+	{
+		Finished.Broadcast({}, TEXT("Api key is not set"), false);
+		return;
+	}
+	if (!Index || !Index->GetStore().IsValid())
+	{
+		Finished.Broadcast({}, TEXT("Vector index is not valid"), false);
+		return;
+	}
+	if (Query.IsEmpty())
+	{
+		Finished.Broadcast({}, TEXT("Query is empty"), false);
+		return;
+	}
+
+	// the node has no outer keeping it alive across the embedding, search and chat hops
+	AddToRoot();
+
+	PrewarmConnection(ApiKey);
+
+	FEmbeddingSettings EmbeddingSettings;
+	EmbeddingSettings.model = RetrievalSettings.embeddingModel;
+	EmbeddingSettings.input = Query;
+
+	TWeakObjectPtr<UOpenAICallChatRAG> WeakThis(this);
+	UOpenAIEmbedding::Embedding(EmbeddingSettings, [WeakThis](const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->OnQueryEmbedded(Result, ErrorMessage, Success);
+		}
+	});
+}
+
+void UOpenAICallChatRAG::PrewarmConnection(const FString& ApiKey) const
+{
+	// a cheap request to the chat host so DNS, TCP and TLS are done by the time the real request goes out,
+	// the http module keeps the connection around for reuse
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(UOpenAIUtils::GetApiURL());
+	HttpRequest->SetVerb(TEXT("HEAD"));
+	HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + ApiKey);
+	HttpRequest->SetTimeout(10.f);
+	HttpRequest->ProcessRequest();
+}
+
+void UOpenAICallChatRAG::OnQueryEmbedded(const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)
+{
+	if (!Success)
+	{
+		Finish({}, ErrorMessage, false);
+		return;
+	}
+
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store = Index->GetStore();
+	if (Result.embeddingVector.Components.Num() != Store->GetDimension())
+	{
+		// a different embedding model than the one the index was built with
+		Finish({}, FString::Printf(TEXT("Query embedding has %d dimensions, the index expects %d"), Result.embeddingVector.Components.Num(), Store->GetDimension()), false);
+		return;
+	}
+
+	TSharedPtr<FOpenAIBM25Index, ESPMode::ThreadSafe> LexicalIndex = RetrievalSettings.hybridSearch ? Index->GetLexicalIndex() : nullptr;
+	const int32 TopK = RetrievalSettings.topK;
+	TWeakObjectPtr<UOpenAICallChatRAG> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [Store, LexicalIndex, QueryText = Query, QueryVector = Result.embeddingVector, TopK, WeakThis]()
+	{
+		TArray<FVectorIndexMatch> Matches;
+		if (LexicalIndex.IsValid())
+		{
+			FHybridSearchSettings HybridSettings;
+			HybridSettings.topK = TopK;
+			Matches = UOpenAIVectorIndex::SearchStoreHybrid(*Store, *LexicalIndex, QueryText, QueryVector, HybridSettings);
+		}
+		else
+		{
+			Matches = UOpenAIVectorIndex::SearchStore(*Store, QueryVector, TopK);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Matches = MoveTemp(Matches)]()
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnContextRetrieved(Matches);
+			}
+		});
+	});
+}
+
+void UOpenAICallChatRAG::OnContextRetrieved(const TArray<FVectorIndexMatch>& Matches)
+{
+	ContextRetrieved.Broadcast(Matches);
+
+	FChatSettings Settings = ChatSettings;
+	Settings.stream = true;
+
+	const FString Context = BuildContext(Matches, RetrievalSettings);
+	if (!Context.IsEmpty())
+	{
+		// after any system prompt the caller set up, before the conversation itself
+		int32 InsertAt = 0;
+		while (InsertAt < Settings.messages.Num() && Settings.messages[InsertAt].role == EOAChatRole::SYSTEM)
+		{
+			InsertAt++;
+		}
+		FChatLog ContextMessage;
+		ContextMessage.role = EOAChatRole::SYSTEM;
+		ContextMessage.content = Context;
+		Settings.messages.Insert(ContextMessage, InsertAt);
+	}
+
+	if (Settings.messages.IsEmpty() || Settings.messages.Last().role != EOAChatRole::USER || Settings.messages.Last().content != Query)
+	{
+		FChatLog QueryMessage;
+		QueryMessage.role = EOAChatRole::USER;
+		QueryMessage.content = Query;
+		Settings.messages.Add(QueryMessage);
+	}
+
+	ChatNode = NewObject<UOpenAICallChat>();
+	ChatNode->ChatSettings = Settings;
+	ChatNode->Streaming.AddDynamic(this, &UOpenAICallChatRAG::HandleChatStreaming);
+	ChatNode->Finished.AddDynamic(this, &UOpenAICallChatRAG::HandleChatFinished);
+	static_cast<UBlueprintAsyncActionBase*>(ChatNode)->Activate();
+}
+
+FString UOpenAICallChatRAG::BuildContext(const TArray<FVectorIndexMatch>& Matches, const FRetrievalSettings& Settings)
+{
+	// the preamble goes into the same prompt, it counts against the budget too
+	const int32 CharBudget = FMath::Max(Settings.contextTokenBudget, 0) * CharsPerToken - Settings.contextPreamble.Len();
+
+	FString Context;
+	for (const FVectorIndexMatch& Match : Matches)
+	{
+		if ((!Settings.hybridSearch && Match.Score < Settings.minScore) || Match.Text.IsEmpty())
+		{
+			continue;
+		}
+		if (Context.Len() + Match.Text.Len() + 2 > CharBudget)
+		{
+			break;
+		}
+		Context += TEXT("\n\n");
+		Context += Match.Text;
+	}
+
+	if (Context.IsEmpty())
+	{
+		return Context;
+	}
+	return Settings.contextPreamble + Context;
+}
+
+void UOpenAICallChatRAG::HandleChatStreaming(const FChatCompletion Message, const FString& ErrorMessage, bool Success)
+{
+	Streaming.Broadcast(Message, ErrorMessage, Success);
+}
+
+void UOpenAICallChatRAG::HandleChatFinished(const FChatCompletion Message, const FString& ErrorMessage, bool Success)
+{
+	Finish(Message, ErrorMessage, Success);
+}
+
+void UOpenAICallChatRAG::Finish(const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(Message, ErrorMessage, Success);
+
+	if (ChatNode)
+	{
+		ChatNode->Streaming.RemoveAll(this);
+		ChatNode->Finished.RemoveAll(this);
+		ChatNode = nullptr;
+	}
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
@@ -0,0 +1,364 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallChatSpeech.h"
+#include "OpenAIRequestQueue.h"
+#include "OpenAISpeech.h"
+#include "OpenAISpeechCache.h"
+#include "Sound/SoundWaveProcedural.h"
+
+namespace
+{
+	bool IsSentencePunctuation(TCHAR C)
+	{
+		return C == TEXT('.') || C == TEXT('!') || C == TEXT('?') || C == TEXT('\x2026');
+	}
+
+	bool IsClausePunctuation(TCHAR C)
+	{
+		return C == TEXT(',') || C == TEXT(';') || C == TEXT(':');
+	}
+
+	bool IsClosingCharacter(TCHAR C)
+	{
+		return C == TEXT('"') || C == TEXT('\'') || C == TEXT(')') || C == TEXT(']') || C == TEXT('\x201D') || C == TEXT('\x2019') || IsSentencePunctuation(C);
+	}
+}
+
+UOpenAICallChatSpeech::UOpenAICallChatSpeech()
+{
+}
+
+UOpenAICallChatSpeech::~UOpenAICallChatSpeech()
+{
+}
+
+UOpenAICallChatSpeech* UOpenAICallChatSpeech::OpenAICallChatSpeech(FChatSettings ChatSettingsInput, FSpeechSettings VoiceSettingsInput, int32 maxConcurrentSpeech, bool useCache)
+{
+	UOpenAICallChatSpeech* BPNode = NewObject<UOpenAICallChatSpeech>();
+	BPNode->ChatSettings = ChatSettingsInput;
+	BPNode->VoiceSettings = VoiceSettingsInput;
+	BPNode->MaxConcurrentSpeech = maxConcurrentSpeech;
+	BPNode->bUseCache = useCache;
+	return BPNode;
+}
+
+void UOpenAICallChatSpeech::Activate()
+{
+	// kept alive until the last sentence is queued on the sound
+	AddToRoot();
+
+	SpeechQueue = FOpenAIRequestQueue::Create(FMath::Max(MaxConcurrentSpeech, 1));
+
+	FChatSettings Settings = ChatSettings;
+	Settings.stream = true;
+
+	ChatNode = NewObject<UOpenAICallChat>();
+	ChatNode->ChatSettings = Settings;
+	ChatNode->Streaming.AddDynamic(this, &UOpenAICallChatSpeech::HandleChatStreaming);
+	ChatNode->Finished.AddDynamic(this, &UOpenAICallChatSpeech::HandleChatFinished);
+	static_cast<UBlueprintAsyncActionBase*>(ChatNode)->Activate();
+}
+
+int32 UOpenAICallChatSpeech::FindSentenceEnd(const FString& Text, int32 MinChars, int32 MaxChars)
+{
+	int32 LastClauseEnd = INDEX_NONE;
+	int32 LastSpace = INDEX_NONE;
+
+	for (int32 i = 0; i < Text.Len(); ++i)
+	{
+		const TCHAR C = Text[i];
+
+		if (C == TEXT('\n') && i + 1 >= MinChars)
+		{
+			return i + 1;
+		}
+
+		// the end is only known once the character after the punctuation arrived, "3." might be "3.14"
+		if (IsSentencePunctuation(C))
+		{
+			int32 End = i + 1;
+			while (End < Text.Len() && IsClosingCharacter(Text[End]))
+			{
+				++End;
+			}
+			if (End < Text.Len() && FChar::IsWhitespace(Text[End]) && End >= MinChars)
+			{
+				return End;
+			}
+		}
+		else if (IsClausePunctuation(C) && i + 1 < Text.Len() && FChar::IsWhitespace(Text[i + 1]))
+		{
+			LastClauseEnd = i + 1;
+		}
+		else if (FChar::IsWhitespace(C))
+		{
+			LastSpace = i;
+		}
+
+		if (i + 1 >= MaxChars)
+		{
+			if (LastClauseEnd != INDEX_NONE)
+			{
+				return LastClauseEnd;
+			}
+			if (LastSpace > 0)
+			{
+				return LastSpace;
+			}
+			return i + 1;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void UOpenAICallChatSpeech::HandleChatStreaming(const FChatCompletion Message, const FString& ErrorMessage, bool Success)
+{
+	if (bChatDone)
+	{
+		return;
+	}
+
+	StreamedText += Message.message.content;
+	PendingText += Message.message.content;
+	Streaming.Broadcast(Message, ErrorMessage, Success);
+
+	ConsumeText(false);
+}
+
+void UOpenAICallChatSpeech::HandleChatFinished(const FChatCompletion Message, const FString& ErrorMessage, bool Success)
+{
+	if (bChatDone)
+	{
+		return;
+	}
+	bChatDone = true;
+	FinalMessage = Message;
+
+	if (!Success)
+	{
+		ChatError = ErrorMessage.IsEmpty() ? TEXT("Chat request failed") : ErrorMessage;
+	}
+	// the last delta only arrives as part of the full message
+	else if (Message.message.content.StartsWith(StreamedText, ESearchCase::CaseSensitive))
+	{
+		PendingText += Message.message.content.Mid(StreamedText.Len());
+	}
+
+	ConsumeText(true);
+	TryFinish();
+}
+
+void UOpenAICallChatSpeech::ConsumeText(bool bFlush)
+{
+	for (int32 End = FindSentenceEnd(PendingText, MinSentenceChars, MaxSentenceChars); End != INDEX_NONE; End = FindSentenceEnd(PendingText, MinSentenceChars, MaxSentenceChars))
+	{
+		const FString Sentence = PendingText.Left(End).TrimStartAndEnd();
+		PendingText.RightChopInline(End);
+		if (!Sentence.IsEmpty())
+		{
+			QueueSentence(Sentence);
+		}
+	}
+
+	if (bFlush)
+	{
+		const FString Sentence = PendingText.TrimStartAndEnd();
+		PendingText.Empty();
+		if (!Sentence.IsEmpty())
+		{
+			QueueSentence(Sentence);
+		}
+	}
+}
+
+void UOpenAICallChatSpeech::QueueSentence(const FString& Text)
+{
+	const int32 SentenceIndex = Sentences.AddDefaulted();
+	Sentences[SentenceIndex].Text = Text;
+	SentenceQueued.Broadcast(Text, SentenceIndex);
+
+	TWeakObjectPtr<UOpenAICallChatSpeech> WeakThis(this);
+	SpeechQueue->Enqueue([WeakThis, SentenceIndex](FOpenAIRequestQueue::FOnRequestDone Done)
+	{
+		if (WeakThis.IsValid() && !WeakThis->bFinished)
+		{
+			WeakThis->SynthesizeSentence(SentenceIndex, Done);
+		}
+		else
+		{
+			Done();
+		}
+	});
+}
+
+void UOpenAICallChatSpeech::SynthesizeSentence(int32 SentenceIndex, TFunction<void()> Done)
+{
+	FSpeechSettings Settings = VoiceSettings;
+	Settings.input = Sentences[SentenceIndex].Text;
+	Settings.responseFormat = EOASpeechResponseFormat::PCM;
+
+	TWeakObjectPtr<UOpenAICallChatSpeech> WeakThis(this);
+	auto StartRequest = [WeakThis, SentenceIndex, Settings, Done]()
+	{
+		if (!WeakThis.IsValid() || WeakThis->bFinished)
+		{
+			Done();
+			return;
+		}
+
+		TSharedRef<FOpenAISpeechRequest> Request = FOpenAISpeechRequest::Start(Settings,
+			[WeakThis, SentenceIndex](TArrayView<const uint8> Audio)
+			{
+				if (WeakThis.IsValid() && !WeakThis->bFinished)
+				{
+					WeakThis->OnSentenceAudio(SentenceIndex, Audio);
+				}
+			},
+			[WeakThis, SentenceIndex, Settings, Done](const TArray<uint8>& Audio, const FString& ErrorMessage, bool Success)
+			{
+				Done();
+				if (WeakThis.IsValid() && !WeakThis->bFinished)
+				{
+					if (Success && WeakThis->bUseCache)
+					{
+						FOpenAISpeechCache::Get().Store(Settings, Audio);
+					}
+					WeakThis->OnSentenceDone(SentenceIndex, ErrorMessage, Success);
+				}
+			});
+
+		// a request that failed to start has already reported back
+		if (WeakThis.IsValid() && !WeakThis->Sentences[SentenceIndex].bDone)
+		{
+			WeakThis->ActiveRequests.Add(SentenceIndex, Request);
+		}
+	};
+
+	if (!bUseCache)
+	{
+		StartRequest();
+		return;
+	}
+
+	FOpenAISpeechCache::Get().Find(Settings, [WeakThis, SentenceIndex, Done, StartRequest](FOpenAISpeechCache::FAudio Audio)
+	{
+		if (!Audio.IsValid())
+		{
+			StartRequest();
+			return;
+		}
+
+		Done();
+		if (WeakThis.IsValid() && !WeakThis->bFinished)
+		{
+			WeakThis->OnSentenceAudio(SentenceIndex, *Audio);
+			WeakThis->OnSentenceDone(SentenceIndex, TEXT(""), true);
+		}
+	});
+}
+
+void UOpenAICallChatSpeech::OnSentenceAudio(int32 SentenceIndex, TArrayView<const uint8> Audio)
+{
+	if (SentenceIndex == NextToPlay)
+	{
+		QueueOnSound(Audio);
+	}
+	else
+	{
+		Sentences[SentenceIndex].Buffered.Append(Audio.GetData(), Audio.Num());
+	}
+}
+
+void UOpenAICallChatSpeech::OnSentenceDone(int32 SentenceIndex, const FString& ErrorMessage, bool Success)
+{
+	ActiveRequests.Remove(SentenceIndex);
+	Sentences[SentenceIndex].bDone = true;
+
+	if (!Success)
+	{
+		// a failed sentence is skipped, the rest of the answer still plays
+		LastError = ErrorMessage;
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAICallChatSpeech could not synthesize \"%s\": %s"), *Sentences[SentenceIndex].Text, *ErrorMessage);
+	}
+
+	// move on to the next sentence in order, queuing whatever it downloaded while it waited
+	while (NextToPlay < Sentences.Num() && Sentences[NextToPlay].bDone)
+	{
+		++NextToPlay;
+		if (NextToPlay < Sentences.Num() && Sentences[NextToPlay].Buffered.Num() > 0)
+		{
+			QueueOnSound(Sentences[NextToPlay].Buffered);
+			Sentences[NextToPlay].Buffered.Empty();
+		}
+	}
+
+	TryFinish();
+}
+
+void UOpenAICallChatSpeech::QueueOnSound(TArrayView<const uint8> Audio)
+{
+	const bool bFirstAudio = Sound == nullptr;
+	if (bFirstAudio)
+	{
+		Sound = UOpenAICallSpeech::CreateStreamingSound();
+	}
+
+	Sound->QueueAudio(Audio.GetData(), Audio.Num());
+
+	if (bFirstAudio)
+	{
+		AudioStarted.Broadcast(Sound);
+	}
+}
+
+void UOpenAICallChatSpeech::TryFinish()
+{
+	if (bChatDone && NextToPlay >= Sentences.Num())
+	{
+		if (!ChatError.IsEmpty())
+		{
+			Finish(ChatError, false);
+		}
+		else
+		{
+			Finish(LastError, LastError.IsEmpty());
+		}
+	}
+}
+
+void UOpenAICallChatSpeech::Cancel()
+{
+	for (const TPair<int32, TSharedPtr<FOpenAISpeechRequest>>& Pair : ActiveRequests)
+	{
+		Pair.Value->Cancel();
+	}
+	ActiveRequests.Empty();
+
+	Finish(TEXT("Chat speech cancelled"), false);
+}
+
+void UOpenAICallChatSpeech::Finish(const FString& ErrorMessage, bool Success)
+{
+	if (bFinished)
+	{
+		return;
+	}
+	bFinished = true;
+	bChatDone = true;
+
+	Finished.Broadcast(FinalMessage, ErrorMessage, Success);
+
+	if (ChatNode)
+	{
+		ChatNode->Streaming.RemoveAll(this);
+		ChatNode->Finished.RemoveAll(this);
+		ChatNode = nullptr;
+	}
+	if (SpeechQueue.IsValid())
+	{
+		SpeechQueue->CancelPending();
+		SpeechQueue.Reset();
+	}
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
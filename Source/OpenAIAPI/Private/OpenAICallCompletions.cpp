@@ -8,6 +8,8 @@
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
 #include "OpenAIParser.h"
+#include "OpenAIAsyncJson.h"
+#include "OpenAICompletionBatch.h"
 
 
 UOpenAICallCompletions::UOpenAICallCompletions()
@@ -40,56 +42,22 @@ void UOpenAICallCompletions::Activate()
 	if (_apiKey.IsEmpty())
 	{
 		Finished.Broadcast({}, TEXT("Api key is not set"), {}, false);
+		return;
 	} else if (prompt.IsEmpty())
 	{
 		Finished.Broadcast({}, TEXT("Prompt is empty"), {}, false);
-	} else if (settings.bestOf < settings.numCompletions)
-	{
-		Finished.Broadcast({}, TEXT("bestOf must be greater than numCompletions"), {}, false);
-	} else if (settings.maxTokens <= 0 || ( engine != EOACompletionsEngineType::TEXT_DAVINCI_003 && settings.maxTokens >= 2048) || ( engine == EOACompletionsEngineType::TEXT_DAVINCI_003 && settings.maxTokens >= 4000))
-	{
-		Finished.Broadcast({}, TEXT("maxTokens must be within 0 and 2048. Up to 4096 if using davinci-3."), {}, false);
-	} else if (settings.stopSequences.Num() > 4)
-	{
-		Finished.Broadcast({}, TEXT("You can only include up to 4 Stop Sequences"), {}, false);
-	} else if (settings.stopSequences.Contains(""))
+		return;
+	}
+
+	// the checks and the request body are shared with the batched and C++ completions
+	const FString ValidationError = FOpenAICompletionBatch::Validate(engine, settings);
+	if (!ValidationError.IsEmpty())
 	{
-		Finished.Broadcast({}, TEXT("One or more Stop Sequences has no value"), {}, false);
+		Finished.Broadcast({}, ValidationError, {}, false);
+		return;
 	}
 	
 	auto HttpRequest = FHttpModule::Get().CreateRequest();
-	
-	FString apiMethod;
-	switch (engine)
-	{
-	case EOACompletionsEngineType::DAVINCI:
-			apiMethod = "davinci";
-	break;
-	case EOACompletionsEngineType::CURIE:
-			apiMethod = "curie";
-	break;
-	case EOACompletionsEngineType::BABBAGE:
-			apiMethod = "babbage";
-	break;
-	case EOACompletionsEngineType::ADA:
-			apiMethod = "ada";
-	break;
-	case EOACompletionsEngineType::TEXT_DAVINCI_002:
-		apiMethod = "text-davinci-002";
-	break;
-	case EOACompletionsEngineType::TEXT_CURIE_001:
-		apiMethod = "text-curie-001";
-	break;
-	case EOACompletionsEngineType::TEXT_BABBAGE_001:
-		apiMethod = "text-babbage-001";
-		break;
-	case EOACompletionsEngineType::TEXT_ADA_001:
-		apiMethod = "text-ada-001";
-		break;
-	case EOACompletionsEngineType::TEXT_DAVINCI_003:
-		apiMethod = "text-davinci-003";
-		break;
-	}
 
 	// convert parameters to strings
 	FString tempPrompt = settings.startSequence + prompt + settings.injectStartText;
@@ -97,36 +65,16 @@ void UOpenAICallCompletions::Activate()
 	tempHeader += _apiKey;
 
 	// set headers
-	FString url = FString::Printf(TEXT("https://api.openai.com/v1/engines/%s/completions"), *apiMethod);
+	FString url = FString::Printf(TEXT("https://api.openai.com/v1/engines/%s/completions"), *FOpenAICompletionBatch::GetEngineName(engine));
 	HttpRequest->SetURL(url);
 	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
 	HttpRequest->SetHeader(TEXT("Authorization"), tempHeader);
 
 	//build payload
-	TSharedPtr<FJsonObject> _payloadObject = MakeShareable(new FJsonObject());
+	TSharedPtr<FJsonObject> _payloadObject = FOpenAICompletionBatch::MakePayload(settings);
 	_payloadObject->SetStringField(TEXT("prompt"), tempPrompt);
-	_payloadObject->SetNumberField(TEXT("max_tokens"), settings.maxTokens);
-	_payloadObject->SetNumberField(TEXT("temperature"), FMath::Clamp(settings.temperature, 0.0f, 1.0f));
-	_payloadObject->SetNumberField(TEXT("top_p"), FMath::Clamp(settings.topP, 0.0f, 1.0f));
-	_payloadObject->SetNumberField(TEXT("n"), settings.numCompletions);
-	_payloadObject->SetNumberField(TEXT("best_of"), settings.bestOf);
-	if (!(settings.presencePenalty == 0))
-		_payloadObject->SetNumberField(TEXT("presence_penalty"), FMath::Clamp(settings.presencePenalty, 0.0f, 1.0f));
-	if (!(settings.logprobs == 0)){
-		_payloadObject->SetNumberField(TEXT("logprobs"), FMath::Clamp(settings.logprobs, 0, 10));
-		_payloadObject->SetNumberField(TEXT("presence_penalty"), FMath::Clamp(settings.presencePenalty, 0.0f, 1.0f));
-	}
-	if (!(settings.frequencyPenalty == 0))
-		_payloadObject->SetNumberField(TEXT("frequency_penalty"), FMath::Clamp(settings.frequencyPenalty, 0.0f, 1.0f));
-	if (!(settings.stopSequences.Num() == 0))
-	{
-		TArray<TSharedPtr<FJsonValue>> StopSequences;
-		for (int i = 0; i < settings.stopSequences.Num(); i++)
-		{
-			StopSequences.Add(MakeShareable(new FJsonValueString(settings.stopSequences[i])));
-		}
-		_payloadObject->SetArrayField(TEXT("stop"), StopSequences);
-	}
+	if (settings.stream && settings.bestOf <= 1)
+		_payloadObject->SetBoolField(TEXT("stream"), true);
 
 	// convert payload to string
 	FString _payload;
@@ -140,6 +88,18 @@ void UOpenAICallCompletions::Activate()
 	if (HttpRequest->ProcessRequest())
 	{
 		HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallCompletions::OnResponse);
+
+		if (settings.stream && settings.bestOf <= 1)
+		{
+			HttpRequest->OnRequestProgress64().BindWeakLambda(this, [this](FHttpRequestPtr Request, uint64 BytesSent, uint64 BytesReceived)
+			{
+				FHttpResponsePtr Response = Request->GetResponse();
+				if (Response.IsValid() && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+				{
+					ProcessStream(Response->GetContent(), false);
+				}
+			});
+		}
 	}
 	else
 	{
@@ -160,32 +120,145 @@ void UOpenAICallCompletions::OnResponse(FHttpRequestPtr Request, FHttpResponsePt
 		return;
 	}
 
-	TSharedPtr<FJsonObject> responseObject;
-	TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	
-	if (FJsonSerializer::Deserialize(reader, responseObject))
+	if (settings.stream && settings.bestOf <= 1 && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		ProcessStream(Response->GetContent(), true);
+		Finished.Broadcast(StreamedChoices, "", StreamedInfo, true);
+		return;
+	}
+
+	struct FCompletionsResponse
 	{
+		TArray<FCompletion> Completions;
+		FCompletionInfo Info;
+		FString ErrorMessage;
+		bool bSuccess = false;
+	};
+
+	TWeakObjectPtr<UOpenAICallCompletions> WeakThis(this);
+	FOpenAIAsyncJson::ParseResponse<FCompletionsResponse>(Response, [Settings = settings, Response](const TSharedPtr<FJsonObject>& responseObject)
+	{
+		FCompletionsResponse Parsed;
+		if (!responseObject.IsValid())
+		{
+			Parsed.ErrorMessage = TEXT("Failed to parse JSON response");
+			return Parsed;
+		}
+
 		bool err = responseObject->HasField(TEXT("error"));
 
 		if (err)
 		{
 			FString ResponseString = Response->GetContentAsString();
 			UE_LOG(LogTemp, Warning, TEXT("%s"), *ResponseString);
-			Finished.Broadcast({}, TEXT("Api error: ") + ResponseString, {}, false);
-			return;
+			Parsed.ErrorMessage = TEXT("Api error: ") + ResponseString;
+			return Parsed;
 		}
 
-		OpenAIParser parser(settings);
-		TArray<FCompletion> _out;
-		FCompletionInfo _info = parser.ParseGPTCompletionInfo(*responseObject);
+		OpenAIParser parser(Settings);
+		Parsed.Info = parser.ParseGPTCompletionInfo(*responseObject);
 
 		auto CompletionsObject = responseObject->GetArrayField(TEXT("Choices"));
 		for (auto& elem : CompletionsObject)
 		{
-			_out.Add(parser.ParseCompletionsResponse(*elem->AsObject()));
+			Parsed.Completions.Add(parser.ParseCompletionsResponse(*elem->AsObject()));
+		}
+		Parsed.bSuccess = true;
+		return Parsed;
+	},
+	[WeakThis](FCompletionsResponse&& Parsed)
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->Finished.Broadcast(Parsed.Completions, Parsed.ErrorMessage, Parsed.Info, Parsed.bSuccess);
 		}
+	});
+}
 
-		Finished.Broadcast(_out, "", _info, true);
+void UOpenAICallCompletions::ProcessStream(const TArray<uint8>& Content, bool bComplete)
+{
+	// only complete lines are parsed, a partial event waits for the next update
+	int32 End = Content.Num();
+	if (!bComplete)
+	{
+		while (End > ParsedBytes && Content[End - 1] != '\n')
+		{
+			End--;
+		}
 	}
-}
+	if (End <= ParsedBytes)
+	{
+		return;
+	}
+
+	FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Content.GetData() + ParsedBytes), End - ParsedBytes);
+	const FString NewText(Converted.Length(), Converted.Get());
+	ParsedBytes = End;
 
+	TArray<FString> Lines;
+	NewText.ParseIntoArrayLines(Lines);
+
+	OpenAIParser parser(settings);
+	for (const FString& Line : Lines)
+	{
+		if (!Line.StartsWith(TEXT("data:")))
+		{
+			continue;
+		}
+		const FString Data = Line.RightChop(5).TrimStartAndEnd();
+		if (Data == TEXT("[DONE]"))
+		{
+			continue;
+		}
+
+		TSharedPtr<FJsonObject> Event;
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Data), Event) || !Event.IsValid())
+		{
+			continue;
+		}
+		if (StreamedInfo.id.IsEmpty())
+		{
+			StreamedInfo = parser.ParseGPTCompletionInfo(*Event);
+		}
+
+		const TArray<TSharedPtr<FJsonValue>>* Choices = nullptr;
+		if (!Event->TryGetArrayField(TEXT("choices"), Choices))
+		{
+			continue;
+		}
+
+		// every event carries deltas for one or more choices, told apart by index
+		for (const TSharedPtr<FJsonValue>& Value : *Choices)
+		{
+			const TSharedPtr<FJsonObject>& Choice = Value->AsObject();
+			const int32 Index = Choice->GetIntegerField(TEXT("index"));
+			if (Index < 0)
+			{
+				continue;
+			}
+			while (StreamedChoices.Num() <= Index)
+			{
+				const int32 NewIndex = StreamedChoices.Num();
+				StreamedChoices.AddDefaulted_GetRef().index = NewIndex;
+			}
+
+			FCompletion Delta;
+			Delta.index = Index;
+			Choice->TryGetStringField(TEXT("text"), Delta.text);
+			Choice->TryGetStringField(TEXT("finish_reason"), Delta.finishReason);
+
+			FCompletion& Accumulated = StreamedChoices[Index];
+			Accumulated.text += Delta.text;
+			if (!Delta.text.IsEmpty())
+			{
+				Streaming.Broadcast(Delta);
+			}
+			if (!Delta.finishReason.IsEmpty() && Accumulated.finishReason.IsEmpty())
+			{
+				Accumulated.finishReason = Delta.finishReason;
+				Accumulated.text += settings.injectRestartText;
+				ChoiceFinished.Broadcast(Accumulated);
+			}
+		}
+	}
+}
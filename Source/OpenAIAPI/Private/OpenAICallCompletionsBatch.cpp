@@ -0,0 +1,95 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallCompletionsBatch.h"
+#include "OpenAICompletionBatch.h"
+
+UOpenAICallCompletionsBatch::UOpenAICallCompletionsBatch()
+{
+}
+
+UOpenAICallCompletionsBatch::~UOpenAICallCompletionsBatch()
+{
+}
+
+UOpenAICallCompletionsBatch* UOpenAICallCompletionsBatch::OpenAICallCompletionsBatch(EOACompletionsEngineType engineInput, const TArray<FString>& promptsInput, FCompletionSettings settingsInput)
+{
+	UOpenAICallCompletionsBatch* BPNode = NewObject<UOpenAICallCompletionsBatch>();
+	BPNode->engine = engineInput;
+	BPNode->prompts = promptsInput;
+	BPNode->settings = settingsInput;
+	return BPNode;
+}
+
+UOpenAICallCompletionsBatch* UOpenAICallCompletionsBatch::OpenAICallCompletionsAutoBatched(EOACompletionsEngineType engineInput, FString promptInput, FCompletionSettings settingsInput)
+{
+	UOpenAICallCompletionsBatch* BPNode = OpenAICallCompletionsBatch(engineInput, { promptInput }, settingsInput);
+	BPNode->autoBatch = true;
+	return BPNode;
+}
+
+void UOpenAICallCompletionsBatch::FlushCompletionsBatcher()
+{
+	FOpenAICompletionBatcher::Get().Flush();
+}
+
+void UOpenAICallCompletionsBatch::Activate()
+{
+	if (prompts.Num() == 0 || prompts.Contains(TEXT("")))
+	{
+		Finished.Broadcast({}, TEXT("Prompt is empty"), {}, false);
+		return;
+	}
+
+	const FString Error = FOpenAICompletionBatch::Validate(engine, settings);
+	if (!Error.IsEmpty())
+	{
+		Finished.Broadcast({}, Error, {}, false);
+		return;
+	}
+
+	// kept alive until the batch it went out with is back
+	AddToRoot();
+	TWeakObjectPtr<UOpenAICallCompletionsBatch> WeakThis(this);
+
+	if (autoBatch)
+	{
+		FOpenAICompletionBatcher::Get().Enqueue(engine, prompts[0], settings, [WeakThis](const TArray<FCompletion>& Completions, const FCompletionInfo& Info, const FString& ErrorMessage, bool Success)
+		{
+			if (WeakThis.IsValid())
+			{
+				FBatchedCompletion Result;
+				Result.prompt = WeakThis->prompts[0];
+				Result.completions = Completions;
+				WeakThis->Finish({ Result }, ErrorMessage, Info, Success);
+			}
+		});
+		return;
+	}
+
+	FOpenAICompletionBatch::Send(engine, prompts, settings, [WeakThis](TArray<TArray<FCompletion>>&& Completions, const FCompletionInfo& Info, const FString& ErrorMessage, bool Success)
+	{
+		if (!WeakThis.IsValid())
+		{
+			return;
+		}
+
+		TArray<FBatchedCompletion> Results;
+		for (int32 i = 0; i < WeakThis->prompts.Num(); i++)
+		{
+			FBatchedCompletion& Result = Results.AddDefaulted_GetRef();
+			Result.prompt = WeakThis->prompts[i];
+			if (Completions.IsValidIndex(i))
+			{
+				Result.completions = MoveTemp(Completions[i]);
+			}
+		}
+		WeakThis->Finish(Results, ErrorMessage, Info, Success);
+	});
+}
+
+void UOpenAICallCompletionsBatch::Finish(const TArray<FBatchedCompletion>& Results, const FString& ErrorMessage, const FCompletionInfo& Info, bool Success)
+{
+	Finished.Broadcast(Results, ErrorMessage, Info, Success);
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
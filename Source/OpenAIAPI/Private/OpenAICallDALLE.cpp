@@ -8,6 +8,15 @@
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
 #include "OpenAIParser.h"
+#include "OpenAIAsyncJson.h"
+#include "OpenAIImageCache.h"
+#include "OpenAIImageUtils.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Algo/Count.h"
+#include "Misc/Base64.h"
+#include "Misc/Paths.h"
+#include "Engine/Texture2D.h"
 
 
 UOpenAICallDALLE::UOpenAICallDALLE()
@@ -18,15 +27,32 @@ UOpenAICallDALLE::~UOpenAICallDALLE()
 {
 }
 
-UOpenAICallDALLE* UOpenAICallDALLE::OpenAICallDALLE(EOAImageSize imageSizeInput, FString promptInput, int32 numImagesInput)
+UOpenAICallDALLE* UOpenAICallDALLE::OpenAICallDALLE(EOAImageSize imageSizeInput, FString promptInput, int32 numImagesInput, bool returnTexturesInput, bool generateMipsInput, bool useCacheInput)
 {
 	UOpenAICallDALLE* BPNode = NewObject<UOpenAICallDALLE>();
 	BPNode->imageSize = imageSizeInput;
 	BPNode->prompt = promptInput;
 	BPNode->numImages = numImagesInput;
+	BPNode->returnTextures = returnTexturesInput;
+	BPNode->generateMips = generateMipsInput;
+	BPNode->useCache = useCacheInput;
 	return BPNode;
 }
 
+void UOpenAICallDALLE::SetImageCacheLimit(int32 maxDiskMegabytes)
+{
+	FOpenAIImageCache::Get().SetMaxBytes((int64)maxDiskMegabytes * 1024 * 1024);
+}
+
+struct UOpenAICallDALLE::FDecodedImages
+{
+	// png bytes as returned by the api or read from the cache
+	TArray<FOpenAIImageCache::FImage> Files;
+	TArray<FOpenAIImageUtils::FDecodedImage> Images;
+	TArray<bool> Decoded;
+	FString ErrorMessage;
+};
+
 void UOpenAICallDALLE::Activate()
 {
 	FString _apiKey;
@@ -40,14 +66,46 @@ void UOpenAICallDALLE::Activate()
 	if (_apiKey.IsEmpty())
 	{
 		Finished.Broadcast({}, TEXT("Api key is not set"), false);
+		return;
 	} else if (prompt.IsEmpty())
 	{
 		Finished.Broadcast({}, TEXT("Prompt is empty"), false);
+		return;
 	} else if (numImages < 1 || numImages > 10)
 	{
 		Finished.Broadcast({}, TEXT("NumImages must be set to a value between 1 and 10"), false);
+		return;
 	}
-	
+
+	// kept alive across the cache lookup, the request and the decode
+	AddToRoot();
+
+	if (!useCache)
+	{
+		SendRequest(_apiKey);
+		return;
+	}
+
+	TWeakObjectPtr<UOpenAICallDALLE> WeakThis(this);
+	FOpenAIImageCache::Get().Find(prompt, imageSize, numImages, [WeakThis, _apiKey](TArray<FOpenAIImageCache::FImage> Images)
+	{
+		if (!WeakThis.IsValid())
+		{
+			return;
+		}
+		if (Images.Num() > 0)
+		{
+			WeakThis->OnCacheHit(MoveTemp(Images));
+		}
+		else
+		{
+			WeakThis->SendRequest(_apiKey);
+		}
+	});
+}
+
+void UOpenAICallDALLE::SendRequest(const FString& ApiKey)
+{
 	auto HttpRequest = FHttpModule::Get().CreateRequest();
 	
 	FString imageResolution;
@@ -66,7 +124,7 @@ void UOpenAICallDALLE::Activate()
 
 	// convert parameters to strings
 	FString tempHeader = "Bearer ";
-	tempHeader += _apiKey;
+	tempHeader += ApiKey;
 
 	// set headers
 	FString url = FString::Printf(TEXT("https://api.openai.com/v1/images/generations"));
@@ -79,6 +137,11 @@ void UOpenAICallDALLE::Activate()
 	_payloadObject->SetStringField(TEXT("prompt"), prompt);
 	_payloadObject->SetNumberField(TEXT("n"), numImages);
 	_payloadObject->SetStringField(TEXT("size"), imageResolution);
+	if (returnTextures || useCache)
+	{
+		// the images come back inline, saving a download per image
+		_payloadObject->SetStringField(TEXT("response_format"), TEXT("b64_json"));
+	}
 
 	// convert payload to string
 	FString _payload;
@@ -95,46 +158,281 @@ void UOpenAICallDALLE::Activate()
 	}
 	else
 	{
-		Finished.Broadcast({}, ("Error sending request"), false);
+		Finish({}, TEXT("Error sending request"), false);
 	}
 }
 
 void UOpenAICallDALLE::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
 {
-	if (!WasSuccessful)
+	if (!WasSuccessful || !Response.IsValid())
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s \n%s"), *Response->GetContentAsString(), *Response->GetURL());
-		if (Finished.IsBound())
-		{
-			Finished.Broadcast({}, *Response->GetContentAsString(), false);
-		}
+		const FString ErrorMessage = Response.IsValid() ? Response->GetContentAsString() : TEXT("Error processing request");
+		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s"), *ErrorMessage);
+		Finish({}, ErrorMessage, false);
 		return;
 	}
 
-	TSharedPtr<FJsonObject> responseObject;
-	TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(reader, responseObject))
+	if (returnTextures || useCache)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
+		DecodeResponse(Response->GetContentAsString());
+		return;
+	}
+
+	struct FUrlResponse
+	{
+		TArray<FString> Urls;
+		FString ErrorMessage;
+		bool bSuccess = false;
+	};
+
+	TWeakObjectPtr<UOpenAICallDALLE> WeakThis(this);
+	FOpenAIAsyncJson::ParseResponse<FUrlResponse>(Response, [Settings = settings, Response](const TSharedPtr<FJsonObject>& responseObject)
+	{
+		FUrlResponse Parsed;
+		if (!responseObject.IsValid())
+		{
+			Parsed.ErrorMessage = TEXT("Failed to parse JSON response");
+			return Parsed;
+		}
+
 		bool err = responseObject->HasField(TEXT("error"));
 		
 		if (err)
 		{
 			UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
-			Finished.Broadcast({}, TEXT("Api error"), false);
-			return;
+			Parsed.ErrorMessage = TEXT("Api error");
+			return Parsed;
 		}
 
-		OpenAIParser parser(settings);
-		TArray<FString> _out;
+		OpenAIParser parser(Settings);
 
 		auto GeneratedImagesObject = responseObject->GetArrayField(TEXT("data"));
 		for (auto& elem : GeneratedImagesObject)
 		{
-		_out.Add(parser.ParseGeneratedImage(*elem->AsObject()));
+			Parsed.Urls.Add(parser.ParseGeneratedImage(*elem->AsObject()));
+		}
+		Parsed.bSuccess = true;
+		return Parsed;
+	},
+	[WeakThis](FUrlResponse&& Parsed)
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->Finish(Parsed.Urls, Parsed.ErrorMessage, Parsed.bSuccess);
+		}
+	});
+}
+
+void UOpenAICallDALLE::DecodeResponse(const FString& Content)
+{
+	// the body holds megabytes of base64, parsing and decoding it all happens on workers
+	IImageWrapperModule& ImageWrapperModule = FOpenAIImageUtils::GetImageWrapperModule();
+	TWeakObjectPtr<UOpenAICallDALLE> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Content, &ImageWrapperModule, bTextures = returnTextures, bMips = generateMips]()
+	{
+		FDecodedImages Result;
+		TArray<FString> Encoded;
+
+		TSharedPtr<FJsonObject> responseObject;
+		TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Content);
+		if (!FJsonSerializer::Deserialize(reader, responseObject) || !responseObject.IsValid())
+		{
+			Result.ErrorMessage = TEXT("Failed to parse JSON response");
+		}
+		else if (responseObject->HasField(TEXT("error")))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s"), *Content);
+			Result.ErrorMessage = TEXT("Api error");
 		}
+		else
+		{
+			for (const TSharedPtr<FJsonValue>& elem : responseObject->GetArrayField(TEXT("data")))
+			{
+				Encoded.Add(elem->AsObject()->GetStringField(TEXT("b64_json")));
+			}
+		}
+
+		Result.Files.SetNum(Encoded.Num());
+		Result.Images.SetNum(Encoded.Num());
+		Result.Decoded.SetNumZeroed(Encoded.Num());
+		ParallelFor(Encoded.Num(), [&](int32 i)
+		{
+			TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> File = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+			if (FBase64::Decode(Encoded[i], *File))
+			{
+				Result.Files[i] = File;
+				Result.Decoded[i] = !bTextures || FOpenAIImageUtils::DecodeImage(ImageWrapperModule, *File, bMips, Result.Images[i]);
+			}
+		});
 
-		Finished.Broadcast(_out, "", true);
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Result = MoveTemp(Result)]() mutable
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnImagesDecoded(Result, false);
+			}
+		});
+	});
+}
+
+void UOpenAICallDALLE::OnCacheHit(TArray<FOpenAIImageCache::FImage>&& Files)
+{
+	if (!returnTextures)
+	{
+		// a file can be evicted between the read and now, those are written again from the bytes just read
+		FDecodedImages Result;
+		Result.Files = MoveTemp(Files);
+		Result.Decoded.Init(true, Result.Files.Num());
+		StoreImages(Result, true, TEXT(""), true);
+		return;
+	}
+
+	IImageWrapperModule& ImageWrapperModule = FOpenAIImageUtils::GetImageWrapperModule();
+	TWeakObjectPtr<UOpenAICallDALLE> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Files = MoveTemp(Files), &ImageWrapperModule, bMips = generateMips]() mutable
+	{
+		FDecodedImages Result;
+		Result.Files = MoveTemp(Files);
+		Result.Images.SetNum(Result.Files.Num());
+		Result.Decoded.SetNumZeroed(Result.Files.Num());
+		ParallelFor(Result.Files.Num(), [&](int32 i)
+		{
+			Result.Decoded[i] = FOpenAIImageUtils::DecodeImage(ImageWrapperModule, *Result.Files[i], bMips, Result.Images[i]);
+		});
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Result = MoveTemp(Result)]() mutable
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnImagesDecoded(Result, true);
+			}
+		});
+	});
+}
+
+void UOpenAICallDALLE::OnImagesDecoded(FDecodedImages& Result, bool bFromCache)
+{
+	if (!Result.ErrorMessage.IsEmpty())
+	{
+		Finish({}, Result.ErrorMessage, false);
+		return;
+	}
+
+	bool bAllDecoded = Algo::Count(Result.Decoded, true) == Result.Decoded.Num();
+	FString ErrorMessage = bAllDecoded ? TEXT("") : TEXT("Failed to decode some of the images");
+
+	if (returnTextures)
+	{
+		TArray<UTexture2D*> Textures;
+		int32 NumFailed = 0;
+		for (int32 i = 0; i < Result.Images.Num(); i++)
+		{
+			UTexture2D* Texture = Result.Decoded[i] ? FOpenAIImageUtils::CreateTexture(MoveTemp(Result.Images[i])) : nullptr;
+			if (Texture)
+			{
+				Textures.Add(Texture);
+			}
+			else if (Result.Decoded[i])
+			{
+				NumFailed++;
+			}
+		}
+		if (NumFailed > 0)
+		{
+			bAllDecoded = false;
+			ErrorMessage = FString::Printf(TEXT("%s%sFailed to create %d of the textures"), *ErrorMessage, ErrorMessage.IsEmpty() ? TEXT("") : TEXT(". "), NumFailed);
+		}
+		TexturesReady.Broadcast(Textures);
+	}
+
+	if (!useCache || bFromCache)
+	{
+		Finish({}, ErrorMessage, bAllDecoded);
+		return;
+	}
+
+	// with textures Finished does not wait for the cache, the files are written in the background
+	if (returnTextures)
+	{
+		Finish({}, ErrorMessage, bAllDecoded);
+	}
+	StoreImages(Result, false, ErrorMessage, bAllDecoded);
+}
+
+void UOpenAICallDALLE::StoreImages(const FDecodedImages& Result, bool bOnlyMissing, const FString& ErrorMessage, bool Success)
+{
+	// without textures the urls are the cached files, so Finished waits until they are written and only lists the ones that were
+	struct FStoreState
+	{
+		TArray<FString> Paths;
+		TArray<bool> Written;
+		int32 NumRemaining = 1;
+		int32 NumFailed = 0;
+	};
+
+	TSharedRef<FStoreState> State = MakeShared<FStoreState>();
+	State->Paths.SetNum(Result.Files.Num());
+	State->Written.SetNumZeroed(Result.Files.Num());
+
+	TWeakObjectPtr<UOpenAICallDALLE> WeakThis(this);
+	auto OnStored = [WeakThis, State, ErrorMessage, Success, bReport = !returnTextures]()
+	{
+		if (--State->NumRemaining > 0 || !bReport || !WeakThis.IsValid())
+		{
+			return;
+		}
+
+		TArray<FString> Paths;
+		for (int32 i = 0; i < State->Paths.Num(); i++)
+		{
+			if (State->Written[i])
+			{
+				Paths.Add(State->Paths[i]);
+			}
+		}
+
+		FString Error = ErrorMessage;
+		if (State->NumFailed > 0)
+		{
+			Error += FString::Printf(TEXT("%sFailed to cache %d of the images"), Error.IsEmpty() ? TEXT("") : TEXT(". "), State->NumFailed);
+		}
+		WeakThis->Finish(Paths, Error, Success && State->NumFailed == 0);
+	};
+
+	for (int32 i = 0; i < Result.Files.Num(); i++)
+	{
+		if (!Result.Decoded[i])
+		{
+			continue;
+		}
+
+		State->Paths[i] = FOpenAIImageCache::Get().GetFilePath(prompt, imageSize, i);
+		if (bOnlyMissing && FPaths::FileExists(State->Paths[i]))
+		{
+			State->Written[i] = true;
+			continue;
+		}
+
+		State->NumRemaining++;
+		FOpenAIImageCache::Get().Store(prompt, imageSize, i, Result.Files[i], [State, i, OnStored](bool bWritten)
+		{
+			State->Written[i] = bWritten;
+			State->NumFailed += bWritten ? 0 : 1;
+			OnStored();
+		});
 	}
+
+	// releases the reference held while the writes were issued
+	OnStored();
 }
 
+void UOpenAICallDALLE::Finish(const TArray<FString>& Urls, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(Urls, ErrorMessage, Success);
+	if (IsRooted())
+	{
+		RemoveFromRoot();
+	}
+}
@@ -0,0 +1,273 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallDALLEEdit.h"
+#include "OpenAIImageUtils.h"
+#include "OpenAIMultipartForm.h"
+#include "OpenAIParser.h"
+#include "OpenAIUtils.h"
+#include "Http.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Engine/Texture.h"
+#include "Engine/Texture2D.h"
+
+UOpenAICallDALLEEdit::UOpenAICallDALLEEdit()
+{
+}
+
+UOpenAICallDALLEEdit::~UOpenAICallDALLEEdit()
+{
+}
+
+UOpenAICallDALLEEdit* UOpenAICallDALLEEdit::OpenAICallDALLEEdit(UTexture* imageInput, UTexture* maskInput, FString promptInput, EOAImageSize imageSizeInput, int32 numImagesInput, bool returnTexturesInput, bool generateMipsInput)
+{
+	UOpenAICallDALLEEdit* BPNode = NewObject<UOpenAICallDALLEEdit>();
+	BPNode->image = imageInput;
+	BPNode->mask = maskInput;
+	BPNode->prompt = promptInput;
+	BPNode->imageSize = imageSizeInput;
+	BPNode->numImages = numImagesInput;
+	BPNode->returnTextures = returnTexturesInput;
+	BPNode->generateMips = generateMipsInput;
+	return BPNode;
+}
+
+UOpenAICallDALLEEdit* UOpenAICallDALLEEdit::OpenAICallDALLEVariation(UTexture* imageInput, EOAImageSize imageSizeInput, int32 numImagesInput, bool returnTexturesInput, bool generateMipsInput)
+{
+	UOpenAICallDALLEEdit* BPNode = OpenAICallDALLEEdit(imageInput, nullptr, TEXT(""), imageSizeInput, numImagesInput, returnTexturesInput, generateMipsInput);
+	BPNode->variation = true;
+	return BPNode;
+}
+
+void UOpenAICallDALLEEdit::Activate()
+{
+	if (UOpenAIUtils::GetUseApiKeyFromEnvironmentVars())
+		ApiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		ApiKey = UOpenAIUtils::GetApiKey();
+
+	if (ApiKey.IsEmpty())
+	{
+		Finished.Broadcast({}, TEXT("Api key is not set"), false);
+		return;
+	}
+	else if (!image)
+	{
+		Finished.Broadcast({}, TEXT("Image is not set"), false);
+		return;
+	}
+	else if (!variation && prompt.IsEmpty())
+	{
+		Finished.Broadcast({}, TEXT("Prompt is empty"), false);
+		return;
+	}
+	else if (numImages < 1 || numImages > 10)
+	{
+		Finished.Broadcast({}, TEXT("NumImages must be set to a value between 1 and 10"), false);
+		return;
+	}
+
+	// kept alive until Finished, the image and mask encode at the same time
+	AddToRoot();
+	NumEncoding = mask ? 2 : 1;
+
+	TWeakObjectPtr<UOpenAICallDALLEEdit> WeakThis(this);
+	FOpenAIImageUtils::EncodeTexturePNG(image, [WeakThis](TArray<uint8>&& Png)
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->ImagePng = MoveTemp(Png);
+			WeakThis->OnEncoded();
+		}
+	});
+	if (mask)
+	{
+		FOpenAIImageUtils::EncodeTexturePNG(mask, [WeakThis](TArray<uint8>&& Png)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->MaskPng = MoveTemp(Png);
+				WeakThis->OnEncoded();
+			}
+		});
+	}
+}
+
+void UOpenAICallDALLEEdit::OnEncoded()
+{
+	if (--NumEncoding > 0)
+	{
+		return;
+	}
+
+	if (ImagePng.Num() == 0 || (mask && MaskPng.Num() == 0))
+	{
+		Finish({}, TEXT("Failed to read back the image, compressed textures have to be drawn to a render target first"), false);
+		return;
+	}
+	SendRequest();
+}
+
+void UOpenAICallDALLEEdit::SendRequest()
+{
+	FString imageResolution;
+	switch (imageSize)
+	{
+	case EOAImageSize::SMALL:
+		imageResolution = "256x256";
+		break;
+	case EOAImageSize::MEDIUM:
+		imageResolution = "512x512";
+		break;
+	case EOAImageSize::LARGE:
+		imageResolution = "1024x1024";
+		break;
+	}
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(variation ? TEXT("https://api.openai.com/v1/images/variations") : TEXT("https://api.openai.com/v1/images/edits"));
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + ApiKey);
+
+	// the encoded pngs move into the form, the upload streams them from memory
+	FOpenAIMultipartForm Form;
+	Form.AddFileData(TEXT("image"), TEXT("image.png"), TEXT("image/png"), MoveTemp(ImagePng));
+	if (!variation)
+	{
+		if (MaskPng.Num() > 0)
+		{
+			Form.AddFileData(TEXT("mask"), TEXT("mask.png"), TEXT("image/png"), MoveTemp(MaskPng));
+		}
+		Form.AddField(TEXT("prompt"), prompt);
+	}
+	Form.AddField(TEXT("n"), FString::FromInt(numImages));
+	Form.AddField(TEXT("size"), imageResolution);
+	if (returnTextures)
+	{
+		Form.AddField(TEXT("response_format"), TEXT("b64_json"));
+	}
+	Form.ApplyTo(*HttpRequest);
+
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallDALLEEdit::OnResponse);
+	if (!HttpRequest->ProcessRequest())
+	{
+		Finish({}, TEXT("Error sending request"), false);
+	}
+}
+
+void UOpenAICallDALLEEdit::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		const FString ErrorMessage = Response.IsValid() ? Response->GetContentAsString() : TEXT("Error processing request");
+		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s"), *ErrorMessage);
+		Finish({}, ErrorMessage, false);
+		return;
+	}
+
+	if (!returnTextures)
+	{
+		TSharedPtr<FJsonObject> responseObject;
+		TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
+		if (!FJsonSerializer::Deserialize(reader, responseObject) || !responseObject.IsValid())
+		{
+			Finish({}, TEXT("Failed to parse JSON response"), false);
+			return;
+		}
+		if (responseObject->HasField(TEXT("error")))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
+			Finish({}, TEXT("Api error"), false);
+			return;
+		}
+
+		OpenAIParser parser;
+		TArray<FString> Urls;
+		for (const TSharedPtr<FJsonValue>& elem : responseObject->GetArrayField(TEXT("data")))
+		{
+			Urls.Add(parser.ParseGeneratedImage(*elem->AsObject()));
+		}
+		Finish(Urls, TEXT(""), true);
+		return;
+	}
+
+	// same as the generation node, base64 and png decoding stay off the game thread
+	IImageWrapperModule& ImageWrapperModule = FOpenAIImageUtils::GetImageWrapperModule();
+	TWeakObjectPtr<UOpenAICallDALLEEdit> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Content = Response->GetContentAsString(), &ImageWrapperModule, bMips = generateMips]()
+	{
+		FString ErrorMessage;
+		TArray<FString> Encoded;
+
+		TSharedPtr<FJsonObject> responseObject;
+		TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Content);
+		if (!FJsonSerializer::Deserialize(reader, responseObject) || !responseObject.IsValid())
+		{
+			ErrorMessage = TEXT("Failed to parse JSON response");
+		}
+		else if (responseObject->HasField(TEXT("error")))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s"), *Content);
+			ErrorMessage = TEXT("Api error");
+		}
+		else
+		{
+			for (const TSharedPtr<FJsonValue>& elem : responseObject->GetArrayField(TEXT("data")))
+			{
+				Encoded.Add(elem->AsObject()->GetStringField(TEXT("b64_json")));
+			}
+		}
+
+		TArray<FOpenAIImageUtils::FDecodedImage> Images;
+		Images.SetNum(Encoded.Num());
+		TArray<bool> Decoded;
+		Decoded.SetNumZeroed(Encoded.Num());
+		ParallelFor(Encoded.Num(), [&](int32 i)
+		{
+			Decoded[i] = FOpenAIImageUtils::DecodeBase64Image(ImageWrapperModule, Encoded[i], bMips, Images[i]);
+		});
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, ErrorMessage, Decoded = MoveTemp(Decoded), Images = MoveTemp(Images)]() mutable
+		{
+			UOpenAICallDALLEEdit* Node = WeakThis.Get();
+			if (!Node)
+			{
+				return;
+			}
+			if (!ErrorMessage.IsEmpty())
+			{
+				Node->Finish({}, ErrorMessage, false);
+				return;
+			}
+
+			TArray<UTexture2D*> Textures;
+			for (int32 i = 0; i < Images.Num(); i++)
+			{
+				UTexture2D* Texture = Decoded[i] ? FOpenAIImageUtils::CreateTexture(MoveTemp(Images[i])) : nullptr;
+				if (Texture)
+				{
+					Textures.Add(Texture);
+				}
+			}
+
+			const bool bAllDecoded = Textures.Num() == Images.Num();
+			Node->TexturesReady.Broadcast(Textures);
+			Node->Finish({}, bAllDecoded ? TEXT("") : TEXT("Failed to decode some of the images"), bAllDecoded);
+		});
+	});
+}
+
+void UOpenAICallDALLEEdit::Finish(const TArray<FString>& Urls, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(Urls, ErrorMessage, Success);
+	if (IsRooted())
+	{
+		RemoveFromRoot();
+	}
+	SetReadyToDestroy();
+}
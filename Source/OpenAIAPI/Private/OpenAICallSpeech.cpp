@@ -0,0 +1,200 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallSpeech.h"
+#include "OpenAISpeech.h"
+#include "OpenAISpeechCache.h"
+#include "Misc/Paths.h"
+#include "Sound/SoundWaveProcedural.h"
+
+UOpenAICallSpeech::UOpenAICallSpeech()
+{
+}
+
+UOpenAICallSpeech::~UOpenAICallSpeech()
+{
+}
+
+UOpenAICallSpeech* UOpenAICallSpeech::OpenAICallSpeech(FSpeechSettings SpeechSettingsInput, bool useCache)
+{
+	UOpenAICallSpeech* BPNode = NewObject<UOpenAICallSpeech>();
+	BPNode->SpeechSettings = SpeechSettingsInput;
+	BPNode->bUseCache = useCache;
+	return BPNode;
+}
+
+void UOpenAICallSpeech::PrewarmSpeechCache(const TArray<FSpeechSettings>& lines, int32 maxConcurrentRequests)
+{
+	FOpenAISpeechCache::Get().Prewarm(lines, maxConcurrentRequests, [](int32 NumReady, int32 NumFailed)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Speech cache prewarmed, %d lines ready, %d failed"), NumReady, NumFailed);
+	});
+}
+
+void UOpenAICallSpeech::SetSpeechCacheLimits(int32 maxDiskMegabytes, int32 maxMemoryMegabytes)
+{
+	FOpenAISpeechCache::Get().SetLimits((int64)maxDiskMegabytes * 1024 * 1024, (int64)maxMemoryMegabytes * 1024 * 1024);
+}
+
+USoundWaveProcedural* UOpenAICallSpeech::CreateStreamingSound()
+{
+	USoundWaveProcedural* StreamingSound = NewObject<USoundWaveProcedural>();
+	StreamingSound->SetSampleRate(FOpenAISpeechRequest::PCMSampleRate);
+	StreamingSound->NumChannels = 1;
+	StreamingSound->Duration = INDEFINITELY_LOOPING_DURATION;
+	StreamingSound->SoundGroup = SOUNDGROUP_Voice;
+	StreamingSound->bLooping = false;
+	return StreamingSound;
+}
+
+void UOpenAICallSpeech::Activate()
+{
+	if (SpeechSettings.input.IsEmpty())
+	{
+		Finished.Broadcast({}, TEXT("Speech input is empty"), false);
+		return;
+	}
+
+	// kept alive while the audio downloads
+	AddToRoot();
+
+	if (!bUseCache)
+	{
+		StartRequest();
+		return;
+	}
+
+	TWeakObjectPtr<UOpenAICallSpeech> WeakThis(this);
+	FOpenAISpeechCache::Get().Find(SpeechSettings, [WeakThis](FOpenAISpeechCache::FAudio Audio)
+	{
+		if (!WeakThis.IsValid() || WeakThis->bFinished)
+		{
+			return;
+		}
+
+		if (Audio.IsValid())
+		{
+			WeakThis->PlayCached(*Audio);
+		}
+		else
+		{
+			WeakThis->StartRequest();
+		}
+	});
+}
+
+void UOpenAICallSpeech::StartRequest()
+{
+	TWeakObjectPtr<UOpenAICallSpeech> WeakThis(this);
+	Request = FOpenAISpeechRequest::Start(SpeechSettings,
+		[WeakThis](TArrayView<const uint8> Audio)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnAudio(Audio);
+			}
+		},
+		[WeakThis](const TArray<uint8>& Audio, const FString& ErrorMessage, bool Success)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnDone(Audio, ErrorMessage, Success);
+			}
+		});
+}
+
+void UOpenAICallSpeech::OnAudio(TArrayView<const uint8> Audio)
+{
+	if (SpeechSettings.responseFormat != EOASpeechResponseFormat::PCM)
+	{
+		return;
+	}
+
+	const bool bFirstAudio = Sound == nullptr;
+	if (bFirstAudio)
+	{
+		Sound = CreateStreamingSound();
+	}
+
+	Sound->QueueAudio(Audio.GetData(), Audio.Num());
+
+	if (bFirstAudio)
+	{
+		AudioStarted.Broadcast(Sound);
+	}
+}
+
+void UOpenAICallSpeech::OnDone(const TArray<uint8>& Audio, const FString& ErrorMessage, bool Success)
+{
+	if (!Success)
+	{
+		Finish({}, ErrorMessage, false);
+		return;
+	}
+
+	TWeakObjectPtr<UOpenAICallSpeech> WeakThis(this);
+	if (bUseCache)
+	{
+		const FString FilePath = FOpenAISpeechCache::Get().GetFilePath(SpeechSettings);
+		FOpenAISpeechCache::Get().Store(SpeechSettings, Audio, [WeakThis, FilePath](bool bWritten)
+		{
+			if (WeakThis.IsValid())
+			{
+				FSpeechCompletion Speech;
+				Speech.audioFilePath = bWritten ? FilePath : TEXT("");
+				Speech.finishReason = TEXT("stop");
+				WeakThis->Finish(Speech, bWritten ? TEXT("") : TEXT("Failed to save speech audio"), bWritten);
+			}
+		});
+		return;
+	}
+
+	// the file is written on the thread pool, Saved/SpeechAudio is trimmed to its budget as new lines come in
+	FOpenAISpeechCache::Get().SaveUncached(SpeechSettings, Audio, [WeakThis](const FString& FilePath)
+	{
+		if (WeakThis.IsValid())
+		{
+			const bool bSaved = !FilePath.IsEmpty();
+			FSpeechCompletion Speech;
+			Speech.audioFilePath = FilePath;
+			Speech.finishReason = bSaved ? TEXT("stop") : TEXT("");
+			WeakThis->Finish(Speech, bSaved ? TEXT("") : TEXT("Failed to save speech audio"), bSaved);
+		}
+	});
+}
+
+void UOpenAICallSpeech::PlayCached(const TArray<uint8>& Audio)
+{
+	// the cache holds pcm as raw samples, so a hit plays exactly like a download that arrived in one piece
+	OnAudio(Audio);
+
+	// a hot line can outlive its file, the disk budget is enforced separately and the write may still be pending
+	FSpeechCompletion Speech;
+	const FString FilePath = FOpenAISpeechCache::Get().GetFilePath(SpeechSettings);
+	Speech.audioFilePath = FPaths::FileExists(FilePath) ? FilePath : TEXT("");
+	Speech.finishReason = TEXT("stop");
+	Finish(Speech, TEXT(""), true);
+}
+
+void UOpenAICallSpeech::Cancel()
+{
+	if (Request.IsValid())
+	{
+		Request->Cancel();
+	}
+	Finish({}, TEXT("Speech cancelled"), false);
+}
+
+void UOpenAICallSpeech::Finish(const FSpeechCompletion& Speech, const FString& ErrorMessage, bool Success)
+{
+	if (bFinished)
+	{
+		return;
+	}
+	bFinished = true;
+	Request.Reset();
+
+	Finished.Broadcast(Speech, ErrorMessage, Success);
+
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
@@ -2,6 +2,8 @@
 
 #include "OpenAICallTranscriptions.h"
 #include "OpenAIUtils.h"
+#include "OpenAIAudioUtils.h"
+#include "OpenAIAsyncJson.h"
 #include "Http.h"
 #include "Dom/JsonObject.h"
 #include "Serialization/JsonReader.h"
@@ -10,6 +12,8 @@
 #include "Misc/Paths.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+#include "Sound/SoundWave.h"
 
 UOpenAICallTranscriptions::UOpenAICallTranscriptions()
 {
@@ -19,10 +23,32 @@ UOpenAICallTranscriptions::~UOpenAICallTranscriptions()
 {
 }
 
-UOpenAICallTranscriptions* UOpenAICallTranscriptions::OpenAICallTranscriptions(FString fileName)
+UOpenAICallTranscriptions* UOpenAICallTranscriptions::OpenAICallTranscriptions(FString fileName, const FAudioPreprocessSettings& preprocess)
 {
 	UOpenAICallTranscriptions* BPNode = NewObject<UOpenAICallTranscriptions>();
 	BPNode->fileName = fileName + ".wav";
+	BPNode->preprocess = preprocess;
+	return BPNode;
+}
+
+UOpenAICallTranscriptions* UOpenAICallTranscriptions::OpenAICallTranscriptionsFromSamples(const TArray<float>& samples, const FAudioPreprocessSettings& preprocess, int32 sampleRate, int32 numChannels)
+{
+	UOpenAICallTranscriptions* BPNode = NewObject<UOpenAICallTranscriptions>();
+	BPNode->preprocess = preprocess;
+	BPNode->Samples = samples;
+	BPNode->SampleRate = sampleRate;
+	BPNode->NumChannels = FMath::Max(numChannels, 1);
+	return BPNode;
+}
+
+UOpenAICallTranscriptions* UOpenAICallTranscriptions::OpenAICallTranscriptionsFromSoundWave(USoundWave* soundWave, const FAudioPreprocessSettings& preprocess)
+{
+	UOpenAICallTranscriptions* BPNode = NewObject<UOpenAICallTranscriptions>();
+	BPNode->preprocess = preprocess;
+	if (!FOpenAIAudioUtils::GetSoundWaveSamples(soundWave, BPNode->Samples, BPNode->SampleRate, BPNode->NumChannels))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("OpenAICallTranscriptionsFromSoundWave: sound wave has no decompressed PCM data."));
+	}
 	return BPNode;
 }
 
@@ -38,14 +64,105 @@ void UOpenAICallTranscriptions::Activate()
 	if (_apiKey.IsEmpty())
 	{
 		Finished.Broadcast({}, TEXT("Api key is not set"), false);
+		return;
+	}
+	
+	if (fileName.IsEmpty() && Samples.Num() == 0)
+	{
+		Finished.Broadcast({}, TEXT("No audio to transcribe"), false);
+		return;
 	}
 	
 	// get the absolutePath to the wav file
 	FString relativePath = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() + "BouncedWavFiles/" + fileName);
 	FString absolutePath = FPaths::ConvertRelativePathToFull(relativePath);
+
+	if (Samples.Num() > 0 || preprocess.enabled)
+	{
+		// decode, preprocess and encode the upload body on a worker, only sending the request happens on the game thread
+		AddToRoot();
+		Async(EAsyncExecution::ThreadPool, [this, _apiKey, absolutePath, PCM = MoveTemp(Samples)]() mutable
+		{
+			TArray<uint8> Wav;
+			FString Error;
+			int32 Rate = SampleRate;
+			int32 Channels = NumChannels;
+
+			bool bDecoded = PCM.Num() > 0;
+			if (!bDecoded)
+			{
+				TArray<uint8> FileData;
+				if (!FFileHelper::LoadFileToArray(FileData, *absolutePath))
+				{
+					Error = FString::Printf(TEXT("Audio file %s not found"), *absolutePath);
+				}
+				else
+				{
+					bDecoded = FOpenAIAudioUtils::DecodeWav(FileData, PCM, Rate, Channels);
+					if (!bDecoded)
+					{
+						// not a PCM wav we can read, upload it unchanged
+						Wav = MoveTemp(FileData);
+					}
+				}
+			}
+
+			TArray<FAudioSpeechSpan> Spans;
+			const bool bTrimmed = preprocess.enabled && preprocess.trimSilence && bDecoded;
+			if (bDecoded)
+			{
+				if (preprocess.enabled)
+				{
+					FOpenAIAudioUtils::Preprocess(PCM, Rate, Channels, preprocess, &Spans);
+				}
+				Wav = FOpenAIAudioUtils::EncodeWav(PCM, Channels, Rate);
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [this, _apiKey, Error, bTrimmed, Spans = MoveTemp(Spans), Wav = MoveTemp(Wav)]() mutable
+			{
+				RemoveFromRoot();
+				if (!Error.IsEmpty())
+				{
+					Finished.Broadcast({}, Error, false);
+					return;
+				}
+
+				if (bTrimmed)
+				{
+					SpeechDetected.Broadcast(Spans);
+
+					// nothing worth paying for
+					if (Spans.Num() == 0)
+					{
+						Finished.Broadcast({}, {}, true);
+						return;
+					}
+				}
+
+				FOpenAIMultipartForm Form;
+				Form.AddFileData(TEXT("file"), fileName.IsEmpty() ? TEXT("audio.wav") : fileName, TEXT("audio/wav"), MoveTemp(Wav));
+				Form.AddField(TEXT("model"), TEXT("whisper-1"));
+				SendRequest(_apiKey, Form);
+			});
+		});
+		return;
+	}
 	
+	// the wav is streamed from disk while the request uploads instead of being loaded and copied into the body
+	FOpenAIMultipartForm Form;
+	if (!Form.AddFile(TEXT("file"), fileName, TEXT("audio/wav"), absolutePath))
+	{
+		Finished.Broadcast({}, FString::Printf(TEXT("Audio file %s not found"), *absolutePath), false);
+		return;
+	}
+	Form.AddField(TEXT("model"), TEXT("whisper-1"));
+	SendRequest(_apiKey, Form);
+}
+
+void UOpenAICallTranscriptions::SendRequest(const FString& ApiKey, const FOpenAIMultipartForm& Form)
+{
 	FString tempHeader = "Bearer ";
-	tempHeader += _apiKey;
+	tempHeader += ApiKey;
 	
 	// Create the HTTP request
 	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
@@ -54,34 +171,8 @@ void UOpenAICallTranscriptions::Activate()
 
 	HttpRequest->SetURL("https://api.openai.com/v1/audio/transcriptions");
 	HttpRequest->SetVerb("POST");
-	
-	// Set the content type, boundary, and form data
 	HttpRequest->SetHeader("Authorization", tempHeader);
-	HttpRequest->SetHeader("Content-Type", "multipart/form-data; boundary=boundary");
-	HttpRequest->SetHeader("model", "whisper-1");
-	
-	TArray<uint8> UpFileRawData;
-	FFileHelper::LoadFileToArray(UpFileRawData, *absolutePath);
-	
-	FString boundaryStart = "\r\n--boundary\r\n";
-	FString contentDispositionFile = FString::Printf(TEXT("Content-Disposition: form-data; name=\"file\"; filename=\"%s\"\r\n"), *fileName);
-	FString contentType = "Content-Type: audio/wav\r\n\r\n";
-	FString boundaryMiddle = "\r\n--boundary\r\n";
-	FString contentDisposition = "Content-Disposition: form-data; name=\"model\"\r\n\r\n";
-	FString transcriptionModel = "whisper-1";
-	FString boundaryEnd = "\r\n--boundary--\r\n";
-
-	TArray<uint8> data;
-	data.Append((uint8*)TCHAR_TO_UTF8(*boundaryStart), boundaryStart.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*contentDispositionFile), contentDispositionFile.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*contentType), contentType.Len());
-	data.Append(UpFileRawData);
-	data.Append((uint8*)TCHAR_TO_UTF8(*boundaryMiddle), boundaryMiddle.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*contentDisposition), contentDisposition.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*transcriptionModel), transcriptionModel.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*boundaryEnd), boundaryEnd.Len());
-
-	HttpRequest->SetContent(data); 
+	Form.ApplyTo(*HttpRequest);
 
 	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallTranscriptions::OnResponse);
 	
@@ -100,25 +191,37 @@ void UOpenAICallTranscriptions::OnResponse(FHttpRequestPtr Request, FHttpRespons
 		return;
 	}
 
-	TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject());
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
+	struct FTranscriptionResponse
+	{
+		FString Text;
+		FString ErrorMessage;
+		bool bSuccess = false;
+	};
 
-	if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+	TWeakObjectPtr<UOpenAICallTranscriptions> WeakThis(this);
+	FOpenAIAsyncJson::ParseResponse<FTranscriptionResponse>(Response, [](const TSharedPtr<FJsonObject>& JsonObject)
 	{
-		FString TextValue;
-		if (JsonObject->TryGetStringField(TEXT("text"), TextValue))
+		FTranscriptionResponse Parsed;
+		if (!JsonObject.IsValid())
 		{
-			UE_LOG(LogTemp, Log, TEXT("Extracted text: %s"), *TextValue);
+			Parsed.ErrorMessage = TEXT("Failed to parse JSON response");
+		}
+		else if (JsonObject->TryGetStringField(TEXT("text"), Parsed.Text))
+		{
+			UE_LOG(LogTemp, Log, TEXT("Extracted text: %s"), *Parsed.Text);
+			Parsed.bSuccess = true;
 		}
 		else
 		{
-			Finished.Broadcast("", "Failed to get 'text' field from JSON response", false);
+			Parsed.ErrorMessage = TEXT("Failed to get 'text' field from JSON response");
 		}
-
-		Finished.Broadcast(TextValue, "", true);
-	}
-	else
+		return Parsed;
+	},
+	[WeakThis](FTranscriptionResponse&& Parsed)
 	{
-		Finished.Broadcast("", "Failed to parse JSON response", false);
-	}
+		if (WeakThis.IsValid())
+		{
+			WeakThis->Finished.Broadcast(Parsed.Text, Parsed.ErrorMessage, Parsed.bSuccess);
+		}
+	});
 }
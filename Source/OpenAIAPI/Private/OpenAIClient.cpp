@@ -0,0 +1,517 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIClient.h"
+#include "OpenAIAPI.h"
+#include "OpenAIUtils.h"
+#include "OpenAIParser.h"
+#include "OpenAIAsyncJson.h"
+#include "OpenAICompletionBatch.h"
+#include "OpenAIMultipartForm.h"
+#include "OpenAISpeech.h"
+#include "Http.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+namespace
+{
+	/** Promise that tolerates being fulfilled twice, a failed ProcessRequest may or may not fire the completion delegate. */
+	template<typename ValueType>
+	struct TClientRequest
+	{
+		TPromise<TOpenAIResult<ValueType>> Promise;
+		std::atomic<bool> bFulfilled{ false };
+
+		void Fulfill(TOpenAIResult<ValueType>&& Result)
+		{
+			if (!bFulfilled.exchange(true))
+			{
+				Promise.SetValue(MoveTemp(Result));
+			}
+		}
+	};
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> CreateRequest(const FString& Url, const FString& ApiKey)
+	{
+		TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+		HttpRequest->SetURL(Url);
+		HttpRequest->SetVerb(TEXT("POST"));
+		HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + ApiKey);
+		return HttpRequest;
+	}
+
+	void SetJsonContent(IHttpRequest& HttpRequest, const TSharedPtr<FJsonObject>& Payload)
+	{
+		FString Content;
+		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Content);
+		FJsonSerializer::Serialize(Payload.ToSharedRef(), Writer);
+
+		HttpRequest.SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+		HttpRequest.SetContentAsString(Content);
+	}
+
+	/** Sends the request, Parse runs on a worker and the future is fulfilled there. */
+	template<typename ValueType>
+	TFuture<TOpenAIResult<ValueType>> Send(TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest, TFunction<TOpenAIResult<ValueType>(const TSharedPtr<FJsonObject>& Json)> Parse)
+	{
+		TSharedRef<TClientRequest<ValueType>, ESPMode::ThreadSafe> Request = MakeShared<TClientRequest<ValueType>, ESPMode::ThreadSafe>();
+		TFuture<TOpenAIResult<ValueType>> Future = Request->Promise.GetFuture();
+
+		HttpRequest->OnProcessRequestComplete().BindLambda([Request, Parse](FHttpRequestPtr, FHttpResponsePtr Response, bool WasSuccessful)
+		{
+			if (!WasSuccessful || !Response.IsValid())
+			{
+				Request->Fulfill(TOpenAIResult<ValueType>::Error(Response.IsValid() ? Response->GetContentAsString() : TEXT("Error processing request")));
+				return;
+			}
+
+			FOpenAIAsyncJson::ParseResponse<TOpenAIResult<ValueType>>(Response, [Parse, Response](const TSharedPtr<FJsonObject>& Json)
+			{
+				TOpenAIResult<ValueType> Result = Parse(Json);
+				if (!Result.bSuccess)
+				{
+					UE_LOG(LogTemp, Warning, TEXT("FOpenAIClient error: %s"), *Response->GetContentAsString());
+				}
+				return Result;
+			},
+			[Request](TOpenAIResult<ValueType>&& Result)
+			{
+				Request->Fulfill(MoveTemp(Result));
+			}, true);
+		});
+
+		if (!HttpRequest->ProcessRequest())
+		{
+			Request->Fulfill(TOpenAIResult<ValueType>::Error(TEXT("Error sending request")));
+		}
+		return Future;
+	}
+
+	template<typename ValueType>
+	TFuture<TOpenAIResult<ValueType>> MakeErrorFuture(const FString& ErrorMessage)
+	{
+		return MakeFulfilledPromise<TOpenAIResult<ValueType>>(TOpenAIResult<ValueType>::Error(ErrorMessage)).GetFuture();
+	}
+
+	bool HasApiError(const TSharedPtr<FJsonObject>& Json, FString& OutErrorMessage)
+	{
+		if (!Json.IsValid())
+		{
+			OutErrorMessage = TEXT("Failed to parse JSON response");
+			return true;
+		}
+		if (Json->HasField(TEXT("error")))
+		{
+			OutErrorMessage = TEXT("Api error");
+			return true;
+		}
+		return false;
+	}
+
+	TOpenAIResult<FString> ParseTranscription(const TSharedPtr<FJsonObject>& Json)
+	{
+		TOpenAIResult<FString> Result;
+		if (HasApiError(Json, Result.ErrorMessage))
+		{
+			return Result;
+		}
+		if (!Json->TryGetStringField(TEXT("text"), Result.Value))
+		{
+			Result.ErrorMessage = TEXT("Failed to get 'text' field from JSON response");
+			return Result;
+		}
+		Result.bSuccess = true;
+		return Result;
+	}
+}
+
+FString FOpenAIClient::GetApiKey()
+{
+	const FOpenAIAPIModule& Module = FModuleManager::GetModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	bool bUseEnvVariable;
+	FString ApiKey;
+	{
+		FScopeLock Lock(&Module.SettingsLock);
+		bUseEnvVariable = Module._useApiKeyFromEnvVariable;
+		ApiKey = Module._apiKey;
+	}
+	return bUseEnvVariable ? UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY")) : ApiKey;
+}
+
+FString FOpenAIClient::GetApiUrl()
+{
+	const FOpenAIAPIModule& Module = FModuleManager::GetModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FScopeLock Lock(&Module.SettingsLock);
+	return Module.ApiUrl;
+}
+
+TFuture<TOpenAIResult<FChatCompletion>> FOpenAIClient::Chat(const FChatSettings& Settings)
+{
+	const FString ApiKey = GetApiKey();
+	if (ApiKey.IsEmpty())
+	{
+		return MakeErrorFuture<FChatCompletion>(TEXT("Api key is not set"));
+	}
+
+	FChatSettings RequestSettings = Settings;
+	RequestSettings.stream = false;
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(GetApiUrl(), ApiKey);
+	SetJsonContent(*HttpRequest, MakeChatPayload(RequestSettings));
+
+	return Send<FChatCompletion>(HttpRequest, [RequestSettings](const TSharedPtr<FJsonObject>& Json)
+	{
+		return ParseChat(Json, RequestSettings);
+	});
+}
+
+TFuture<TOpenAIResult<TArray<FCompletion>>> FOpenAIClient::Completions(EOACompletionsEngineType Engine, const FString& Prompt, const FCompletionSettings& Settings)
+{
+	const FString ApiKey = GetApiKey();
+	FString Error = ApiKey.IsEmpty() ? TEXT("Api key is not set") : FOpenAICompletionBatch::Validate(Engine, Settings);
+	if (!Error.IsEmpty())
+	{
+		return MakeErrorFuture<TArray<FCompletion>>(Error);
+	}
+
+	TSharedRef<FJsonObject> Payload = FOpenAICompletionBatch::MakePayload(Settings);
+	Payload->SetStringField(TEXT("prompt"), Settings.startSequence + Prompt + Settings.injectStartText);
+
+	const FString Url = FString::Printf(TEXT("https://api.openai.com/v1/engines/%s/completions"), *FOpenAICompletionBatch::GetEngineName(Engine));
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(Url, ApiKey);
+	SetJsonContent(*HttpRequest, Payload);
+
+	return Send<TArray<FCompletion>>(HttpRequest, [Settings](const TSharedPtr<FJsonObject>& Json)
+	{
+		TOpenAIResult<TArray<FCompletion>> Result;
+		if (HasApiError(Json, Result.ErrorMessage))
+		{
+			return Result;
+		}
+
+		OpenAIParser Parser(Settings);
+		for (const TSharedPtr<FJsonValue>& Choice : Json->GetArrayField(TEXT("choices")))
+		{
+			Result.Value.Add(Parser.ParseCompletionsResponse(*Choice->AsObject()));
+		}
+		Result.bSuccess = true;
+		return Result;
+	});
+}
+
+TFuture<TOpenAIResult<FEmbeddingResult>> FOpenAIClient::Embeddings(const FEmbeddingSettings& Settings)
+{
+	const FString ApiKey = GetApiKey();
+	if (ApiKey.IsEmpty())
+	{
+		return MakeErrorFuture<FEmbeddingResult>(TEXT("Api key is not set"));
+	}
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("https://api.openai.com/v1/embeddings"), ApiKey);
+	SetJsonContent(*HttpRequest, MakeEmbeddingPayload(Settings));
+	HttpRequest->SetTimeout(Settings.inputs.Num() > 0 ? 60.f : 10.f);
+
+	return Send<FEmbeddingResult>(HttpRequest, [](const TSharedPtr<FJsonObject>& Json)
+	{
+		return ParseEmbeddings(Json);
+	});
+}
+
+TFuture<TOpenAIResult<TArray<FString>>> FOpenAIClient::Images(const FString& Prompt, EOAImageSize Size, int32 NumImages)
+{
+	const FString ApiKey = GetApiKey();
+	if (ApiKey.IsEmpty())
+	{
+		return MakeErrorFuture<TArray<FString>>(TEXT("Api key is not set"));
+	}
+	if (Prompt.IsEmpty())
+	{
+		return MakeErrorFuture<TArray<FString>>(TEXT("Prompt is empty"));
+	}
+	if (NumImages < 1 || NumImages > 10)
+	{
+		return MakeErrorFuture<TArray<FString>>(TEXT("NumImages must be set to a value between 1 and 10"));
+	}
+
+	FString ImageResolution;
+	switch (Size)
+	{
+	case EOAImageSize::SMALL:
+		ImageResolution = "256x256";
+		break;
+	case EOAImageSize::MEDIUM:
+		ImageResolution = "512x512";
+		break;
+	case EOAImageSize::LARGE:
+		ImageResolution = "1024x1024";
+		break;
+	}
+
+	TSharedPtr<FJsonObject> Payload = MakeShareable(new FJsonObject());
+	Payload->SetStringField(TEXT("prompt"), Prompt);
+	Payload->SetNumberField(TEXT("n"), NumImages);
+	Payload->SetStringField(TEXT("size"), ImageResolution);
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("https://api.openai.com/v1/images/generations"), ApiKey);
+	SetJsonContent(*HttpRequest, Payload);
+
+	return Send<TArray<FString>>(HttpRequest, [](const TSharedPtr<FJsonObject>& Json)
+	{
+		TOpenAIResult<TArray<FString>> Result;
+		if (HasApiError(Json, Result.ErrorMessage))
+		{
+			return Result;
+		}
+
+		OpenAIParser Parser;
+		for (const TSharedPtr<FJsonValue>& Image : Json->GetArrayField(TEXT("data")))
+		{
+			Result.Value.Add(Parser.ParseGeneratedImage(*Image->AsObject()));
+		}
+		Result.bSuccess = true;
+		return Result;
+	});
+}
+
+TFuture<TOpenAIResult<TArray<uint8>>> FOpenAIClient::Speech(const FSpeechSettings& Settings)
+{
+	TSharedRef<TClientRequest<TArray<uint8>>, ESPMode::ThreadSafe> Request = MakeShared<TClientRequest<TArray<uint8>>, ESPMode::ThreadSafe>();
+	TFuture<TOpenAIResult<TArray<uint8>>> Future = Request->Promise.GetFuture();
+
+	// the speech request reads the key through UOpenAIUtils and streams on the game thread, only the start is moved there
+	auto Start = [Request, Settings]()
+	{
+		FOpenAISpeechRequest::Start(Settings, nullptr, [Request](const TArray<uint8>& Audio, const FString& ErrorMessage, bool Success)
+		{
+			TOpenAIResult<TArray<uint8>> Result;
+			Result.Value = Audio;
+			Result.ErrorMessage = ErrorMessage;
+			Result.bSuccess = Success;
+			Request->Fulfill(MoveTemp(Result));
+		});
+	};
+
+	if (IsInGameThread())
+	{
+		Start();
+	}
+	else
+	{
+		AsyncTask(ENamedThreads::GameThread, MoveTemp(Start));
+	}
+	return Future;
+}
+
+TFuture<TOpenAIResult<FString>> FOpenAIClient::Transcription(TArray<uint8>&& Wav, const FString& FileName)
+{
+	const FString ApiKey = GetApiKey();
+	if (ApiKey.IsEmpty())
+	{
+		return MakeErrorFuture<FString>(TEXT("Api key is not set"));
+	}
+	if (Wav.Num() == 0)
+	{
+		return MakeErrorFuture<FString>(TEXT("No audio to transcribe"));
+	}
+
+	FOpenAIMultipartForm Form;
+	Form.AddFileData(TEXT("file"), FileName, TEXT("audio/wav"), MoveTemp(Wav));
+	Form.AddField(TEXT("model"), TEXT("whisper-1"));
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("https://api.openai.com/v1/audio/transcriptions"), ApiKey);
+	Form.ApplyTo(*HttpRequest);
+
+	return Send<FString>(HttpRequest, &ParseTranscription);
+}
+
+TFuture<TOpenAIResult<FString>> FOpenAIClient::TranscriptionFromFile(const FString& FilePath)
+{
+	const FString ApiKey = GetApiKey();
+	if (ApiKey.IsEmpty())
+	{
+		return MakeErrorFuture<FString>(TEXT("Api key is not set"));
+	}
+
+	FOpenAIMultipartForm Form;
+	if (!Form.AddFile(TEXT("file"), FPaths::GetCleanFilename(FilePath), TEXT("audio/wav"), FilePath))
+	{
+		return MakeErrorFuture<FString>(FString::Printf(TEXT("Audio file %s not found"), *FilePath));
+	}
+	Form.AddField(TEXT("model"), TEXT("whisper-1"));
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("https://api.openai.com/v1/audio/transcriptions"), ApiKey);
+	Form.ApplyTo(*HttpRequest);
+
+	return Send<FString>(HttpRequest, &ParseTranscription);
+}
+
+TSharedPtr<FJsonObject> FOpenAIClient::MakeChatPayload(const FChatSettings& Settings)
+{
+	FString ApiModelName;
+	switch (Settings.model)
+	{
+	case EOAChatEngineType::GPT_3_5_TURBO:
+		ApiModelName = "gpt-3.5-turbo";
+		break;
+	case EOAChatEngineType::GPT_4:
+		ApiModelName = "gpt-4";
+		break;
+	case EOAChatEngineType::GPT_4_32k:
+		ApiModelName = "gpt-4-32k";
+		break;
+	case EOAChatEngineType::GPT_4_TURBO:
+		ApiModelName = "gpt-4-0125-preview";
+		break;
+	case EOAChatEngineType::CUSTOM:
+		ApiModelName = Settings.customModelName;
+		break;
+	}
+
+	TSharedPtr<FJsonObject> PayloadObject = MakeShareable(new FJsonObject());
+	PayloadObject->SetStringField(TEXT("model"), ApiModelName);
+	PayloadObject->SetNumberField(TEXT("max_tokens"), Settings.maxTokens);
+	PayloadObject->SetBoolField(TEXT("stream"), Settings.stream);
+
+	// convert role enum to model string
+	if (Settings.messages.Num() > 0)
+	{
+		TArray<TSharedPtr<FJsonValue>> Messages;
+		FString Role;
+		for (const FChatLog& Log : Settings.messages)
+		{
+			TSharedPtr<FJsonObject> Message = MakeShareable(new FJsonObject());
+			switch (Log.role)
+			{
+			case EOAChatRole::USER:
+				Role = "user";
+				break;
+			case EOAChatRole::ASSISTANT:
+				Role = "assistant";
+				break;
+			case EOAChatRole::SYSTEM:
+				Role = "system";
+				break;
+			}
+			Message->SetStringField(TEXT("role"), Role);
+			Message->SetStringField(TEXT("content"), Log.content);
+			Messages.Add(MakeShareable(new FJsonValueObject(Message)));
+		}
+		PayloadObject->SetArrayField(TEXT("messages"), Messages);
+	}
+
+	return PayloadObject;
+}
+
+TSharedPtr<FJsonObject> FOpenAIClient::MakeEmbeddingPayload(const FEmbeddingSettings& Settings)
+{
+	FString ApiModelName;
+	switch (Settings.model)
+	{
+	case EEmbeddingEngineType::TEXT_EMBEDDING_3_SMALL:
+		ApiModelName = "text-embedding-3-small";
+		break;
+	case EEmbeddingEngineType::TEXT_EMBEDDING_3_LARGE:
+		ApiModelName = "text-embedding-3-large";
+		break;
+	case EEmbeddingEngineType::TEXT_EMBEDDING_ADA_002:
+		ApiModelName = "text-embedding-ada";
+		break;
+	}
+
+	TSharedPtr<FJsonObject> PayloadObject = MakeShareable(new FJsonObject());
+	PayloadObject->SetStringField(TEXT("model"), ApiModelName);
+	if (Settings.inputs.Num() > 0)
+	{
+		TArray<TSharedPtr<FJsonValue>> Inputs;
+		for (const FString& Input : Settings.inputs)
+		{
+			Inputs.Add(MakeShareable(new FJsonValueString(Input.Replace(TEXT("\n"), TEXT(" ")))));
+		}
+		PayloadObject->SetArrayField(TEXT("input"), Inputs);
+	}
+	else
+	{
+		PayloadObject->SetStringField(TEXT("input"), Settings.input.Replace(TEXT("\n"), TEXT(" ")));
+	}
+	return PayloadObject;
+}
+
+TOpenAIResult<FChatCompletion> FOpenAIClient::ParseChat(const TSharedPtr<FJsonObject>& Json, const FChatSettings& Settings)
+{
+	TOpenAIResult<FChatCompletion> Result;
+	if (HasApiError(Json, Result.ErrorMessage))
+	{
+		return Result;
+	}
+
+	// look for empty messages error
+	const TArray<TSharedPtr<FJsonValue>>* DetailArray;
+	if (Json->TryGetArrayField(TEXT("detail"), DetailArray) && DetailArray->Num() > 0)
+	{
+		const TSharedPtr<FJsonObject>* Detail;
+		FString DetailType;
+		if ((*DetailArray)[0]->TryGetObject(Detail) && (*Detail)->TryGetStringField(TEXT("type"), DetailType) && DetailType == TEXT("missing"))
+		{
+			Result.ErrorMessage = TEXT("Api error");
+			return Result;
+		}
+	}
+
+	OpenAIParser Parser(Settings);
+	Result.Value = Parser.ParseChatCompletion(*Json);
+	Result.bSuccess = true;
+	return Result;
+}
+
+TOpenAIResult<FEmbeddingResult> FOpenAIClient::ParseEmbeddings(const TSharedPtr<FJsonObject>& Json)
+{
+	TOpenAIResult<FEmbeddingResult> Parsed;
+	if (HasApiError(Json, Parsed.ErrorMessage))
+	{
+		return Parsed;
+	}
+
+	FEmbeddingResult& Result = Parsed.Value;
+	const TArray<TSharedPtr<FJsonValue>>* DataArray;
+	if (Json->TryGetArrayField(TEXT("data"), DataArray))
+	{
+		Result.embeddingVectors.SetNum(DataArray->Num());
+		for (int32 i = 0; i < DataArray->Num(); i++)
+		{
+			const TSharedPtr<FJsonObject>* DataObject;
+			if (!(*DataArray)[i]->TryGetObject(DataObject))
+			{
+				continue;
+			}
+
+			// batched results carry their input index, don't rely on the array order
+			int32 InputIndex = i;
+			(*DataObject)->TryGetNumberField(TEXT("index"), InputIndex);
+			if (!Result.embeddingVectors.IsValidIndex(InputIndex))
+			{
+				continue;
+			}
+
+			const TArray<TSharedPtr<FJsonValue>>* EmbeddingsArray;
+			if ((*DataObject)->TryGetArrayField(TEXT("embedding"), EmbeddingsArray))
+			{
+				TArray<float>& Components = Result.embeddingVectors[InputIndex].Components;
+				Components.Reserve(EmbeddingsArray->Num());
+				for (const TSharedPtr<FJsonValue>& EmbeddingValue : *EmbeddingsArray)
+				{
+					Components.Add(static_cast<float>(EmbeddingValue->AsNumber()));
+				}
+			}
+		}
+
+		if (Result.embeddingVectors.Num() > 0)
+		{
+			Result.embeddingVector = Result.embeddingVectors[0];
+		}
+	}
+	Parsed.bSuccess = true;
+	return Parsed;
+}
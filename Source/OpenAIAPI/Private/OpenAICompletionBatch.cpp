@@ -0,0 +1,292 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICompletionBatch.h"
+#include "OpenAIParser.h"
+#include "OpenAIUtils.h"
+#include "Http.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Interfaces/IHttpResponse.h"
+
+void FOpenAICompletionBatch::Send(EOACompletionsEngineType Engine, const TArray<FString>& Prompts, const FCompletionSettings& Settings, FOnDone OnDone)
+{
+	check(IsInGameThread());
+
+	FString ApiKey;
+	if (UOpenAIUtils::GetUseApiKeyFromEnvironmentVars())
+		ApiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		ApiKey = UOpenAIUtils::GetApiKey();
+
+	FString Error = ApiKey.IsEmpty() ? TEXT("Api key is not set") : Validate(Engine, Settings);
+	if (Error.IsEmpty() && Prompts.Num() == 0)
+	{
+		Error = TEXT("No prompts");
+	}
+	if (!Error.IsEmpty())
+	{
+		OnDone({}, {}, Error, false);
+		return;
+	}
+
+	struct FBatchState
+	{
+		TArray<TArray<FCompletion>> Completions;
+		FCompletionInfo Info;
+		bool bHasInfo = false;
+		int32 NumRemaining = 0;
+		FString LastError;
+		FOnDone OnDone;
+	};
+
+	TSharedRef<FBatchState> State = MakeShared<FBatchState>();
+	State->Completions.SetNum(Prompts.Num());
+	State->NumRemaining = FMath::DivideAndRoundUp(Prompts.Num(), MaxPromptsPerRequest);
+	State->OnDone = MoveTemp(OnDone);
+
+	const FString Url = FString::Printf(TEXT("https://api.openai.com/v1/engines/%s/completions"), *GetEngineName(Engine));
+	const int32 NumChoices = FMath::Max(Settings.numCompletions, 1);
+
+	for (int32 First = 0; First < Prompts.Num(); First += MaxPromptsPerRequest)
+	{
+		const int32 Count = FMath::Min(MaxPromptsPerRequest, Prompts.Num() - First);
+
+		TSharedRef<FJsonObject> Payload = MakePayload(Settings);
+		TArray<TSharedPtr<FJsonValue>> PromptValues;
+		for (int32 i = First; i < First + Count; i++)
+		{
+			PromptValues.Add(MakeShared<FJsonValueString>(Settings.startSequence + Prompts[i] + Settings.injectStartText));
+		}
+		Payload->SetArrayField(TEXT("prompt"), PromptValues);
+
+		FString Content;
+		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Content);
+		FJsonSerializer::Serialize(Payload, Writer);
+
+		TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+		HttpRequest->SetURL(Url);
+		HttpRequest->SetVerb(TEXT("POST"));
+		HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+		HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + ApiKey);
+		HttpRequest->SetContentAsString(Content);
+
+		HttpRequest->OnProcessRequestComplete().BindLambda([State, Settings, First, Count, NumChoices](FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+		{
+			TSharedPtr<FJsonObject> ResponseObject;
+			if (!WasSuccessful || !Response.IsValid())
+			{
+				State->LastError = Response.IsValid() ? Response->GetContentAsString() : TEXT("Error processing request");
+			}
+			else if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Response->GetContentAsString()), ResponseObject) || !ResponseObject.IsValid())
+			{
+				State->LastError = TEXT("Failed to parse JSON response");
+			}
+			else if (ResponseObject->HasField(TEXT("error")))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
+				State->LastError = TEXT("Api error: ") + Response->GetContentAsString();
+			}
+			else
+			{
+				OpenAIParser Parser(Settings);
+				if (!State->bHasInfo)
+				{
+					State->Info = Parser.ParseGPTCompletionInfo(*ResponseObject);
+					State->bHasInfo = true;
+				}
+
+				// choices come back flattened, prompt-major
+				for (const TSharedPtr<FJsonValue>& Choice : ResponseObject->GetArrayField(TEXT("choices")))
+				{
+					FCompletion Completion = Parser.ParseCompletionsResponse(*Choice->AsObject());
+					const int32 PromptIndex = Completion.index / NumChoices;
+					if (PromptIndex < Count)
+					{
+						Completion.index %= NumChoices;
+						State->Completions[First + PromptIndex].Add(MoveTemp(Completion));
+					}
+				}
+			}
+
+			if (--State->NumRemaining == 0)
+			{
+				for (TArray<FCompletion>& Choices : State->Completions)
+				{
+					Choices.Sort([](const FCompletion& A, const FCompletion& B) { return A.index < B.index; });
+				}
+				const bool bSuccess = State->LastError.IsEmpty();
+				State->OnDone(MoveTemp(State->Completions), State->Info, State->LastError, bSuccess);
+			}
+		});
+		HttpRequest->ProcessRequest();
+	}
+}
+
+FString FOpenAICompletionBatch::Validate(EOACompletionsEngineType Engine, const FCompletionSettings& Settings)
+{
+	if (Settings.bestOf < Settings.numCompletions)
+	{
+		return TEXT("bestOf must be greater than numCompletions");
+	}
+	if (Settings.maxTokens <= 0 || (Engine != EOACompletionsEngineType::TEXT_DAVINCI_003 && Settings.maxTokens >= 2048) || (Engine == EOACompletionsEngineType::TEXT_DAVINCI_003 && Settings.maxTokens >= 4000))
+	{
+		return TEXT("maxTokens must be within 0 and 2048. Up to 4096 if using davinci-3.");
+	}
+	if (Settings.stopSequences.Num() > 4)
+	{
+		return TEXT("You can only include up to 4 Stop Sequences");
+	}
+	if (Settings.stopSequences.Contains(""))
+	{
+		return TEXT("One or more Stop Sequences has no value");
+	}
+	return FString();
+}
+
+FString FOpenAICompletionBatch::GetEngineName(EOACompletionsEngineType Engine)
+{
+	switch (Engine)
+	{
+	case EOACompletionsEngineType::DAVINCI:
+		return TEXT("davinci");
+	case EOACompletionsEngineType::CURIE:
+		return TEXT("curie");
+	case EOACompletionsEngineType::BABBAGE:
+		return TEXT("babbage");
+	case EOACompletionsEngineType::ADA:
+		return TEXT("ada");
+	case EOACompletionsEngineType::TEXT_DAVINCI_002:
+		return TEXT("text-davinci-002");
+	case EOACompletionsEngineType::TEXT_CURIE_001:
+		return TEXT("text-curie-001");
+	case EOACompletionsEngineType::TEXT_BABBAGE_001:
+		return TEXT("text-babbage-001");
+	case EOACompletionsEngineType::TEXT_ADA_001:
+		return TEXT("text-ada-001");
+	case EOACompletionsEngineType::TEXT_DAVINCI_003:
+		return TEXT("text-davinci-003");
+	}
+	return TEXT("text-davinci-003");
+}
+
+TSharedRef<FJsonObject> FOpenAICompletionBatch::MakePayload(const FCompletionSettings& Settings)
+{
+	TSharedRef<FJsonObject> Payload = MakeShared<FJsonObject>();
+	Payload->SetNumberField(TEXT("max_tokens"), Settings.maxTokens);
+	Payload->SetNumberField(TEXT("temperature"), FMath::Clamp(Settings.temperature, 0.0f, 1.0f));
+	Payload->SetNumberField(TEXT("top_p"), FMath::Clamp(Settings.topP, 0.0f, 1.0f));
+	Payload->SetNumberField(TEXT("n"), Settings.numCompletions);
+	Payload->SetNumberField(TEXT("best_of"), Settings.bestOf);
+	if (Settings.presencePenalty != 0)
+	{
+		Payload->SetNumberField(TEXT("presence_penalty"), FMath::Clamp(Settings.presencePenalty, 0.0f, 1.0f));
+	}
+	if (Settings.logprobs != 0)
+	{
+		Payload->SetNumberField(TEXT("logprobs"), FMath::Clamp(Settings.logprobs, 0, 10));
+	}
+	if (Settings.frequencyPenalty != 0)
+	{
+		Payload->SetNumberField(TEXT("frequency_penalty"), FMath::Clamp(Settings.frequencyPenalty, 0.0f, 1.0f));
+	}
+	if (Settings.stopSequences.Num() > 0)
+	{
+		TArray<TSharedPtr<FJsonValue>> StopSequences;
+		for (const FString& StopSequence : Settings.stopSequences)
+		{
+			StopSequences.Add(MakeShared<FJsonValueString>(StopSequence));
+		}
+		Payload->SetArrayField(TEXT("stop"), StopSequences);
+	}
+	return Payload;
+}
+
+FOpenAICompletionBatcher& FOpenAICompletionBatcher::Get()
+{
+	static FOpenAICompletionBatcher Instance;
+	return Instance;
+}
+
+FOpenAICompletionBatcher::~FOpenAICompletionBatcher()
+{
+	if (TickHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	}
+}
+
+void FOpenAICompletionBatcher::Enqueue(EOACompletionsEngineType Engine, const FString& Prompt, const FCompletionSettings& Settings, FOnCompletions OnDone)
+{
+	check(IsInGameThread());
+
+	// prompts can share a request when everything but the prompt serializes the same
+	FString Key;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Key);
+	FJsonSerializer::Serialize(MakePayload(Settings), Writer);
+	Key = FString::Printf(TEXT("%d|%s|%s|%s|%s"), (int32)Engine, *Settings.startSequence, *Settings.injectStartText, *Settings.injectRestartText, *Key);
+
+	FGroup* Group = Groups.Find(Key);
+	if (!Group)
+	{
+		Group = &Groups.Add(Key);
+		Group->Engine = Engine;
+		Group->Settings = Settings;
+		Group->FirstQueued = FPlatformTime::Seconds();
+	}
+	Group->Prompts.Add(Prompt);
+	Group->Callbacks.Add(MoveTemp(OnDone));
+
+	if (Group->Prompts.Num() >= FOpenAICompletionBatch::MaxPromptsPerRequest)
+	{
+		SendGroup(Groups.FindAndRemoveChecked(Key));
+	}
+	else if (!TickHandle.IsValid())
+	{
+		TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FOpenAICompletionBatcher::Tick));
+	}
+}
+
+void FOpenAICompletionBatcher::Flush()
+{
+	TMap<FString, FGroup> Sending = MoveTemp(Groups);
+	Groups.Reset();
+	for (TPair<FString, FGroup>& Pair : Sending)
+	{
+		SendGroup(MoveTemp(Pair.Value));
+	}
+}
+
+bool FOpenAICompletionBatcher::Tick(float DeltaTime)
+{
+	const double Now = FPlatformTime::Seconds();
+	for (auto It = Groups.CreateIterator(); It; ++It)
+	{
+		if (Now - It->Value.FirstQueued >= Window)
+		{
+			FGroup Group = MoveTemp(It->Value);
+			It.RemoveCurrent();
+			SendGroup(MoveTemp(Group));
+		}
+	}
+
+	if (Groups.Num() == 0)
+	{
+		TickHandle.Reset();
+		return false;
+	}
+	return true;
+}
+
+void FOpenAICompletionBatcher::SendGroup(FGroup&& Group)
+{
+	FOpenAICompletionBatch::Send(Group.Engine, Group.Prompts, Group.Settings, [Callbacks = MoveTemp(Group.Callbacks)](TArray<TArray<FCompletion>>&& Completions, const FCompletionInfo& Info, const FString& ErrorMessage, bool Success)
+	{
+		for (int32 i = 0; i < Callbacks.Num(); i++)
+		{
+			// a prompt with choices succeeded even when another request of the batch failed
+			const bool bHasChoices = Completions.IsValidIndex(i) && Completions[i].Num() > 0;
+			Callbacks[i](bHasChoices ? Completions[i] : TArray<FCompletion>(), Info, bHasChoices ? FString() : ErrorMessage, bHasChoices || Success);
+		}
+	});
+}
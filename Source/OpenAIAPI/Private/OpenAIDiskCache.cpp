@@ -0,0 +1,218 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIDiskCache.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	const TCHAR* TempSuffix = TEXT(".tmp");
+}
+
+TSharedRef<FOpenAIDiskCache> FOpenAIDiskCache::Create(const FString& Directory, int64 MaxBytes)
+{
+	const FString FullPath = FPaths::IsRelative(Directory) ? FPaths::Combine(FPaths::ProjectSavedDir(), Directory) : Directory;
+	return MakeShareable(new FOpenAIDiskCache(FullPath, MaxBytes));
+}
+
+FOpenAIDiskCache::FOpenAIDiskCache(const FString& InDirectory, int64 InMaxBytes)
+	: Directory(InDirectory)
+	, MaxBytes(InMaxBytes)
+{
+}
+
+bool FOpenAIDiskCache::Contains(const FString& Key)
+{
+	BuildIndex();
+	return Entries.Contains(Key);
+}
+
+FString FOpenAIDiskCache::GetFilePath(const FString& Key) const
+{
+	return FPaths::Combine(Directory, Key);
+}
+
+void FOpenAIDiskCache::Read(const FString& Key, TFunction<void(FData Data)> OnRead)
+{
+	check(IsInGameThread());
+
+	if (!Contains(Key))
+	{
+		OnRead(nullptr);
+		return;
+	}
+
+	Touch(Key, Entries[Key].Size);
+
+	// the file may be half written, the bytes are still in memory
+	if (const FPendingWrite* Pending = Writing.Find(Key))
+	{
+		OnRead(Pending->Data);
+		return;
+	}
+
+	const FString FilePath = GetFilePath(Key);
+
+	TWeakPtr<FOpenAIDiskCache> WeakThis = AsShared();
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Key, FilePath, OnRead = MoveTemp(OnRead)]() mutable
+	{
+		TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> Data = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+		const bool bRead = FFileHelper::LoadFileToArray(*Data, *FilePath, FILEREAD_Silent);
+		if (bRead)
+		{
+			IFileManager::Get().SetTimeStamp(*FilePath, FDateTime::UtcNow());
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Key, bRead, Data, OnRead = MoveTemp(OnRead)]()
+		{
+			if (!bRead)
+			{
+				// deleted behind our back, forget it unless a new write started in the meantime
+				TSharedPtr<FOpenAIDiskCache> This = WeakThis.Pin();
+				if (This.IsValid() && !This->Writing.Contains(Key))
+				{
+					FEntry Entry;
+					if (This->Entries.RemoveAndCopyValue(Key, Entry))
+					{
+						This->TotalBytes -= Entry.Size;
+					}
+				}
+			}
+			OnRead(bRead ? FData(Data) : nullptr);
+		});
+	});
+}
+
+void FOpenAIDiskCache::Write(const FString& Key, FData Data, TFunction<void(bool Success)> OnWritten)
+{
+	check(IsInGameThread());
+
+	BuildIndex();
+	Touch(Key, Data.IsValid() ? Data->Num() : 0);
+	Evict(Key);
+
+	const uint32 Serial = ++NextWriteSerial;
+	FPendingWrite& Pending = Writing.Add(Key);
+	Pending.Data = Data;
+	Pending.Serial = Serial;
+
+	TWeakPtr<FOpenAIDiskCache> WeakThis = AsShared();
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Key, Serial, FilePath = GetFilePath(Key), Data, OnWritten = MoveTemp(OnWritten)]() mutable
+	{
+		// readers of the final name only ever see a complete file
+		const FString TempPath = FString::Printf(TEXT("%s.%u%s"), *FilePath, Serial, TempSuffix);
+		bool bWritten = Data.IsValid() && FFileHelper::SaveArrayToFile(*Data, *TempPath);
+		bWritten = bWritten && IFileManager::Get().Move(*FilePath, *TempPath, true, true);
+		if (!bWritten)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FOpenAIDiskCache could not write %s"), *FilePath);
+			IFileManager::Get().Delete(*TempPath, false, false, true);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Key, Serial, bWritten, OnWritten = MoveTemp(OnWritten)]()
+		{
+			TSharedPtr<FOpenAIDiskCache> This = WeakThis.Pin();
+			const FPendingWrite* Pending = This.IsValid() ? This->Writing.Find(Key) : nullptr;
+			if (Pending && Pending->Serial == Serial)
+			{
+				This->Writing.Remove(Key);
+
+				FEntry Entry;
+				if (!bWritten && This->Entries.RemoveAndCopyValue(Key, Entry))
+				{
+					This->TotalBytes -= Entry.Size;
+				}
+			}
+
+			if (OnWritten)
+			{
+				OnWritten(bWritten);
+			}
+		});
+	});
+}
+
+void FOpenAIDiskCache::SetMaxBytes(int64 InMaxBytes)
+{
+	MaxBytes = InMaxBytes;
+	Evict();
+}
+
+void FOpenAIDiskCache::BuildIndex()
+{
+	if (bIndexed)
+	{
+		return;
+	}
+	bIndexed = true;
+
+	IFileManager::Get().MakeDirectory(*Directory, true);
+	IFileManager::Get().IterateDirectoryStat(*Directory, [this](const TCHAR* Path, const FFileStatData& Stat)
+	{
+		if (FString(Path).EndsWith(TempSuffix))
+		{
+			// left behind by a write that never finished
+			IFileManager::Get().Delete(Path, false, false, true);
+		}
+		else if (!Stat.bIsDirectory)
+		{
+			FEntry& Entry = Entries.Add(FPaths::GetCleanFilename(Path));
+			Entry.Size = Stat.FileSize;
+			Entry.LastAccess = Stat.ModificationTime;
+			TotalBytes += Stat.FileSize;
+		}
+		return true;
+	});
+}
+
+void FOpenAIDiskCache::Touch(const FString& Key, int64 Size)
+{
+	FEntry& Entry = Entries.FindOrAdd(Key);
+	TotalBytes += Size - Entry.Size;
+	Entry.Size = Size;
+	Entry.LastAccess = FDateTime::UtcNow();
+}
+
+void FOpenAIDiskCache::Evict(const FString& Keep)
+{
+	if (!bIndexed || TotalBytes <= MaxBytes)
+	{
+		return;
+	}
+
+	TArray<TPair<FDateTime, FString>> ByAge;
+	for (const TPair<FString, FEntry>& Pair : Entries)
+	{
+		ByAge.Emplace(Pair.Value.LastAccess, Pair.Key);
+	}
+	ByAge.Sort([](const TPair<FDateTime, FString>& Left, const TPair<FDateTime, FString>& Right)
+	{
+		return Left.Key < Right.Key;
+	});
+
+	TArray<FString> Evicted;
+	for (const TPair<FDateTime, FString>& Oldest : ByAge)
+	{
+		if (TotalBytes <= MaxBytes)
+		{
+			break;
+		}
+		// never a file that is being written
+		if (Oldest.Value == Keep || Writing.Contains(Oldest.Value))
+		{
+			continue;
+		}
+		TotalBytes -= Entries.FindAndRemoveChecked(Oldest.Value).Size;
+		Evicted.Add(GetFilePath(Oldest.Value));
+	}
+
+	Async(EAsyncExecution::ThreadPool, [Evicted = MoveTemp(Evicted)]()
+	{
+		for (const FString& FilePath : Evicted)
+		{
+			IFileManager::Get().Delete(*FilePath, false, false, true);
+		}
+	});
+}
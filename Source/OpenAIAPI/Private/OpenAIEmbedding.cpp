@@ -3,6 +3,8 @@
 #include "OpenAIEmbedding.h"
 #include "HttpModule.h"
 #include "OpenAIUtils.h"
+#include "OpenAIAsyncJson.h"
+#include "OpenAIClient.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
 #include "Serialization/JsonSerializer.h"
@@ -47,71 +49,61 @@ void UOpenAIEmbedding::StartEmbedding()
 	{
 		OnResponseReceived.ExecuteIfBound({}, TEXT("Api key is not set"), false);
 		OnResponseReceivedF.ExecuteIfBound({}, TEXT("Api key is not set"), false);
+		return;
 	}
-	else
-	{
-		auto HttpRequest = FHttpModule::Get().CreateRequest();
 
-		FString apiMethod;
-		switch (EmbeddingSettings.model)
+	// thousands of inputs make a large body, it is built on a worker
+	TWeakObjectPtr<UOpenAIEmbedding> WeakThis(this);
+	FOpenAIAsyncJson::BuildPayload([Settings = EmbeddingSettings]()
+	{
+		return FOpenAIClient::MakeEmbeddingPayload(Settings);
+	},
+	[WeakThis, _apiKey](FString&& Payload)
+	{
+		if (WeakThis.IsValid())
 		{
-		case EEmbeddingEngineType::TEXT_EMBEDDING_3_SMALL:
-			apiMethod = "text-embedding-3-small";
-			break;
-		case EEmbeddingEngineType::TEXT_EMBEDDING_3_LARGE:
-			apiMethod = "text-embedding-3-large";
-			break;
-		case EEmbeddingEngineType::TEXT_EMBEDDING_ADA_002:
-			apiMethod = "text-embedding-ada";
-			break;
+			WeakThis->SendRequest(_apiKey, Payload);
 		}
-		// TODO: Add additional params to match the ones listed in the curl response in: https://platform.openai.com/docs/api-reference/making-requests
-		
-		// convert parameters to strings
-		FString tempHeader = "Bearer ";
-		tempHeader += _apiKey;
-
-		// set headers
-		FString url = FString::Printf(TEXT("https://api.openai.com/v1/embeddings"));
-		HttpRequest->SetURL(url);
-		HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-		HttpRequest->SetHeader(TEXT("Authorization"), tempHeader);
-
-		// build payload
-		TSharedPtr<FJsonObject> _payloadObject = MakeShareable(new FJsonObject());
-		_payloadObject->SetStringField(TEXT("model"), apiMethod);
-		_payloadObject->SetStringField(TEXT("input"),
-			EmbeddingSettings.input.Replace(TEXT("\n"), TEXT(" ")));
-
-		// convert payload to string
-		FString _payload;
-		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&_payload);
-		FJsonSerializer::Serialize(_payloadObject.ToSharedRef(), Writer);
-
-		// commit request
-		HttpRequest->SetVerb(TEXT("POST"));
-		HttpRequest->SetContentAsString(_payload);
-
-		UE_LOG(LogEmbedding, Log, TEXT("UOpenAIEmbedding ProcessHttpRequest"));
-
-		// ensure fast connection, I will retry it
-		HttpRequest->SetTimeout(10.f);
-		
-		HttpRequest->OnRequestProgress64().BindUObject(this, &UOpenAIEmbedding::HandleRequestProgress);
-		HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAIEmbedding::OnResponse);
-		UE_LOG(LogEmbedding, Log, TEXT("UOpenAIEmbedding BindProcessRequestComplete"));
+	});
+}
 
-		CurrentRequest = HttpRequest;
-		
-		if (HttpRequest->ProcessRequest())
-		{
-			UE_LOG(LogEmbedding, Log, TEXT("UOpenAIEmbedding StartProcessRequest"));
-		}
-		else
-		{
-			OnResponseReceived.ExecuteIfBound({}, TEXT("Error sending request"), false);
-			OnResponseReceivedF.ExecuteIfBound({}, TEXT("Error sending request"), false);
-		}
+void UOpenAIEmbedding::SendRequest(const FString& ApiKey, const FString& Payload)
+{
+	auto HttpRequest = FHttpModule::Get().CreateRequest();
+
+	// convert parameters to strings
+	FString tempHeader = "Bearer ";
+	tempHeader += ApiKey;
+
+	// set headers
+	FString url = FString::Printf(TEXT("https://api.openai.com/v1/embeddings"));
+	HttpRequest->SetURL(url);
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	HttpRequest->SetHeader(TEXT("Authorization"), tempHeader);
+
+	// commit request
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetContentAsString(Payload);
+
+	UE_LOG(LogEmbedding, Log, TEXT("UOpenAIEmbedding ProcessHttpRequest"));
+
+	// ensure fast connection, I will retry it
+	HttpRequest->SetTimeout(EmbeddingSettings.inputs.Num() > 0 ? 60.f : 10.f);
+	
+	HttpRequest->OnRequestProgress64().BindUObject(this, &UOpenAIEmbedding::HandleRequestProgress);
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAIEmbedding::OnResponse);
+	UE_LOG(LogEmbedding, Log, TEXT("UOpenAIEmbedding BindProcessRequestComplete"));
+
+	CurrentRequest = HttpRequest;
+	
+	if (HttpRequest->ProcessRequest())
+	{
+		UE_LOG(LogEmbedding, Log, TEXT("UOpenAIEmbedding StartProcessRequest"));
+	}
+	else
+	{
+		OnResponseReceived.ExecuteIfBound({}, TEXT("Error sending request"), false);
+		OnResponseReceivedF.ExecuteIfBound({}, TEXT("Error sending request"), false);
 	}
 }
 
@@ -132,54 +124,44 @@ void UOpenAIEmbedding::CancelRequest()
 
 void UOpenAIEmbedding::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful)
 {
-	if (bWasSuccessful && Response.IsValid())
+	if (!bWasSuccessful || !Response.IsValid())
 	{
-		TSharedPtr<FJsonObject> JsonResponse;
-		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
+		FString ErrorMessage = Response.IsValid() ? TEXT("HTTP request failed: ") + Response->GetContentAsString() : TEXT("HTTP request failed: No response from server");
+		OnResponseReceived.ExecuteIfBound({}, ErrorMessage, false);
+		OnResponseReceivedF.ExecuteIfBound({}, ErrorMessage, false);
+		return;
+	}
 
-		if (FJsonSerializer::Deserialize(Reader, JsonResponse) && JsonResponse.IsValid())
+	// a batch of large vectors is megabytes of JSON numbers, parsed on a worker
+	TWeakObjectPtr<UOpenAIEmbedding> WeakThis(this);
+	FOnEmbeddingResponseReceivedF WorkerCallback = bDeliverOnWorker ? OnResponseReceivedF : FOnEmbeddingResponseReceivedF();
+	FOpenAIAsyncJson::ParseResponse<TOpenAIResult<FEmbeddingResult>>(Response, [](const TSharedPtr<FJsonObject>& JsonResponse)
+	{
+		return FOpenAIClient::ParseEmbeddings(JsonResponse);
+	},
+	[WeakThis, WorkerCallback](TOpenAIResult<FEmbeddingResult>&& Parsed)
+	{
+		if (WorkerCallback.IsBound())
 		{
-			TArray<float> embeddingVector;
-			const TArray<TSharedPtr<FJsonValue>>* DataArray;
-			if (JsonResponse->TryGetArrayField(TEXT("data"), DataArray))
-			{
-				const TSharedPtr<FJsonObject>* FirstObject;
-				if ((*DataArray)[0]->TryGetObject(FirstObject))
-				{
-					const TArray<TSharedPtr<FJsonValue>>* EmbeddingsArray;
-					if ((*FirstObject)->TryGetArrayField(TEXT("embedding"), EmbeddingsArray))
-					{
-						for (const TSharedPtr<FJsonValue>& EmbeddingValue : *EmbeddingsArray)
-						{
-							embeddingVector.Add(static_cast<float>(EmbeddingValue->AsNumber()));
-						}
-					}
-				}
-			}
-
-			FEmbeddingResult Result{embeddingVector};
-			OnResponseReceived.ExecuteIfBound(Result, TEXT(""), true);
-			OnResponseReceivedF.ExecuteIfBound(Result, TEXT(""), true);
+			// only the native delegate is called here, the object itself is not touched off the game thread
+			WorkerCallback.Execute(Parsed.Value, Parsed.ErrorMessage, Parsed.bSuccess);
+			return;
 		}
-		else
+
+		if (UOpenAIEmbedding* This = WeakThis.Get())
 		{
-			OnResponseReceived.ExecuteIfBound({}, TEXT("Failed to parse response"), false);
-			OnResponseReceivedF.ExecuteIfBound({}, TEXT("Failed to parse response"), false);
+			This->OnResponseReceived.ExecuteIfBound(Parsed.Value, Parsed.ErrorMessage, Parsed.bSuccess);
+			This->OnResponseReceivedF.ExecuteIfBound(Parsed.Value, Parsed.ErrorMessage, Parsed.bSuccess);
 		}
-	}
-	else
-	{
-		FString ErrorMessage = Response.IsValid() ? TEXT("HTTP request failed: ") + Response->GetContentAsString() : TEXT("HTTP request failed: No response from server");
-		OnResponseReceived.ExecuteIfBound({}, ErrorMessage, false);
-		OnResponseReceivedF.ExecuteIfBound({}, ErrorMessage, false);
-	}
+	}, WorkerCallback.IsBound());
 }
 
 UOpenAIEmbedding* UOpenAIEmbedding::Embedding(const FEmbeddingSettings& EmbeddingSettings,
-	TFunction<void(const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)> Callback)
+	TFunction<void(const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)> Callback, bool bCallbackOnWorker)
 {
 	UOpenAIEmbedding* OpenAIEmbeddingInstance = CreateEmbeddingInstance();
 	OpenAIEmbeddingInstance->Init(EmbeddingSettings);
+	OpenAIEmbeddingInstance->bDeliverOnWorker = bCallbackOnWorker;
 
 	OpenAIEmbeddingInstance->AddToRoot();
 	
@@ -203,10 +185,20 @@ UOpenAIEmbedding* UOpenAIEmbedding::Embedding(const FEmbeddingSettings& Embeddin
 			UE_LOG(LogEmbedding, Error, TEXT("Embedding Callback is null."));
 		}
 		
-		OpenAIEmbeddingInstance->RemoveFromRoot();
-		
-		// Destroy OpenAIEmbeddingInstance after receiving the response
-		OpenAIEmbeddingInstance->ConditionalBeginDestroy();
+		// Destroy OpenAIEmbeddingInstance after receiving the response, on the game thread even when the callback ran on a worker
+		if (IsInGameThread())
+		{
+			OpenAIEmbeddingInstance->RemoveFromRoot();
+			OpenAIEmbeddingInstance->ConditionalBeginDestroy();
+		}
+		else
+		{
+			AsyncTask(ENamedThreads::GameThread, [OpenAIEmbeddingInstance]()
+			{
+				OpenAIEmbeddingInstance->RemoveFromRoot();
+				OpenAIEmbeddingInstance->ConditionalBeginDestroy();
+			});
+		}
 	};
 
 	// Bind the lambda callback function to OnResponseReceived delegate
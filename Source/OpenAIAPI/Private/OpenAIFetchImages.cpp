@@ -0,0 +1,203 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIFetchImages.h"
+#include "OpenAIImageUtils.h"
+#include "OpenAIRequestQueue.h"
+#include "Http.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+#include "Engine/Texture2D.h"
+#include "Misc/FileHelper.h"
+
+UOpenAIFetchImages::UOpenAIFetchImages()
+{
+}
+
+UOpenAIFetchImages::~UOpenAIFetchImages()
+{
+}
+
+UOpenAIFetchImages* UOpenAIFetchImages::OpenAIFetchImages(const TArray<FString>& urlsInput, bool generateMipsInput)
+{
+	UOpenAIFetchImages* BPNode = NewObject<UOpenAIFetchImages>();
+	BPNode->urls = urlsInput;
+	BPNode->generateMips = generateMipsInput;
+	return BPNode;
+}
+
+FOpenAIRequestQueue& UOpenAIFetchImages::GetDownloadQueue()
+{
+	// one queue for every fetch, so several galleries loading at once still share the limit
+	static TSharedRef<FOpenAIRequestQueue> Queue = FOpenAIRequestQueue::Create(MaxConcurrentDownloads);
+	return *Queue;
+}
+
+void UOpenAIFetchImages::Activate()
+{
+	NumExpected = urls.Num();
+	Textures.SetNum(urls.Num());
+
+	if (NumExpected == 0)
+	{
+		Finish();
+		return;
+	}
+
+	// kept alive until the last image is decoded
+	AddToRoot();
+
+	TWeakObjectPtr<UOpenAIFetchImages> WeakThis(this);
+	for (int32 Index = 0; Index < urls.Num(); Index++)
+	{
+		GetDownloadQueue().Enqueue([WeakThis, Index](FOpenAIRequestQueue::FOnRequestDone Done)
+		{
+			if (WeakThis.IsValid() && !WeakThis->bCancelled)
+			{
+				WeakThis->Download(Index, Done);
+			}
+			else
+			{
+				Done();
+			}
+		});
+	}
+}
+
+void UOpenAIFetchImages::Download(int32 Index, TFunction<void()> Done)
+{
+	NumStarted++;
+
+	// cached images come as file paths, they skip the http request
+	if (!urls[Index].StartsWith(TEXT("http://")) && !urls[Index].StartsWith(TEXT("https://")))
+	{
+		Done();
+		Decode(Index, nullptr);
+		return;
+	}
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(urls[Index]);
+	HttpRequest->SetVerb("GET");
+
+	TWeakObjectPtr<UOpenAIFetchImages> WeakThis(this);
+	HttpRequest->OnProcessRequestComplete().BindLambda([WeakThis, Index, Done](FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+	{
+		// the download slot is free as soon as the bytes are in, decoding does not hold it
+		Done();
+		if (WeakThis.IsValid())
+		{
+			WeakThis->OnDownloaded(Index, Response, WasSuccessful);
+		}
+	});
+	HttpRequest->ProcessRequest();
+}
+
+void UOpenAIFetchImages::OnDownloaded(int32 Index, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	if (!WasSuccessful || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		const FString Error = Response.IsValid()
+			? FString::Printf(TEXT("Download of %s failed with %d"), *urls[Index], Response->GetResponseCode())
+			: FString::Printf(TEXT("Download of %s failed"), *urls[Index]);
+		OnImageDone(Index, nullptr, Error);
+		return;
+	}
+
+	Decode(Index, Response);
+}
+
+void UOpenAIFetchImages::Decode(int32 Index, FHttpResponsePtr Response)
+{
+	IImageWrapperModule& ImageWrapperModule = FOpenAIImageUtils::GetImageWrapperModule();
+	TWeakObjectPtr<UOpenAIFetchImages> WeakThis(this);
+
+	// the response owns the bytes, holding on to it avoids copying a multi-megabyte png
+	Async(EAsyncExecution::TaskGraph, [WeakThis, Index, Response, FilePath = urls[Index], &ImageWrapperModule, bMips = generateMips]()
+	{
+		TArray<uint8> FileData;
+		const bool bLoaded = Response.IsValid() || FFileHelper::LoadFileToArray(FileData, *FilePath);
+		const TArrayView<const uint8> Compressed = Response.IsValid() ? TArrayView<const uint8>(Response->GetContent()) : TArrayView<const uint8>(FileData);
+
+		FOpenAIImageUtils::FDecodedImage Image;
+		const bool bDecoded = bLoaded && FOpenAIImageUtils::DecodeImage(ImageWrapperModule, Compressed, bMips, Image);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Index, bLoaded, bDecoded, Image = MoveTemp(Image)]() mutable
+		{
+			if (UOpenAIFetchImages* Fetch = WeakThis.Get())
+			{
+				UTexture2D* Texture = bDecoded ? FOpenAIImageUtils::CreateTexture(MoveTemp(Image)) : nullptr;
+				const FString Error = !bLoaded ? FString::Printf(TEXT("%s not found"), *Fetch->urls[Index])
+					: FString::Printf(TEXT("%s is not an image"), *Fetch->urls[Index]);
+				Fetch->OnImageDone(Index, Texture, Texture ? FString() : Error);
+			}
+		});
+	});
+}
+
+void UOpenAIFetchImages::OnImageDone(int32 Index, UTexture2D* Texture, const FString& Error)
+{
+	NumDone++;
+	if (Texture)
+	{
+		Textures[Index] = Texture;
+		if (!bFinished)
+		{
+			ImageReady.Broadcast(Texture, Index);
+		}
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAIFetchImages %s"), *Error);
+		NumFailed++;
+		LastError = Error;
+	}
+
+	if (NumDone >= NumExpected)
+	{
+		Finish();
+	}
+}
+
+void UOpenAIFetchImages::Cancel()
+{
+	if (bCancelled || bFinished)
+	{
+		return;
+	}
+	bCancelled = true;
+
+	// downloads still queued skip themselves when their turn comes, only the started ones report back
+	NumExpected = NumStarted;
+	if (NumDone >= NumExpected)
+	{
+		Finish();
+	}
+}
+
+void UOpenAIFetchImages::Finish()
+{
+	if (bFinished)
+	{
+		return;
+	}
+	bFinished = true;
+
+	if (bCancelled)
+	{
+		Finished.Broadcast(Textures, TEXT("Fetch cancelled"), false);
+	}
+	else if (NumFailed > 0)
+	{
+		Finished.Broadcast(Textures, FString::Printf(TEXT("%d images failed: %s"), NumFailed, *LastError), false);
+	}
+	else
+	{
+		Finished.Broadcast(Textures, TEXT(""), true);
+	}
+
+	if (IsRooted())
+	{
+		RemoveFromRoot();
+	}
+	SetReadyToDestroy();
+}
@@ -0,0 +1,94 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIImageCache.h"
+#include "Misc/SecureHash.h"
+
+namespace
+{
+	constexpr int64 DefaultMaxDiskBytes = 512ll * 1024 * 1024;
+}
+
+FOpenAIImageCache& FOpenAIImageCache::Get()
+{
+	static FOpenAIImageCache Instance;
+	return Instance;
+}
+
+FOpenAIImageCache::FOpenAIImageCache()
+	: Disk(FOpenAIDiskCache::Create(TEXT("ImageCache"), DefaultMaxDiskBytes))
+{
+}
+
+void FOpenAIImageCache::SetMaxBytes(int64 MaxDiskBytes)
+{
+	Disk->SetMaxBytes(MaxDiskBytes);
+}
+
+FString FOpenAIImageCache::MakeKey(const FString& Prompt, EOAImageSize Size, int32 Index)
+{
+	const FString Identity = FString::Printf(TEXT("%d|%d|%s"), (int32)Size, Index, *Prompt);
+
+	FTCHARToUTF8 Converted(*Identity);
+	FSHAHash Hash;
+	FSHA1::HashBuffer(Converted.Get(), Converted.Length(), Hash.Hash);
+	return Hash.ToString() + TEXT(".png");
+}
+
+FString FOpenAIImageCache::GetFilePath(const FString& Prompt, EOAImageSize Size, int32 Index) const
+{
+	return Disk->GetFilePath(MakeKey(Prompt, Size, Index));
+}
+
+void FOpenAIImageCache::Find(const FString& Prompt, EOAImageSize Size, int32 NumImages, TFunction<void(TArray<FImage> Images)> OnFound)
+{
+	check(IsInGameThread());
+
+	// a partial hit still needs the request, so only read when every image is there
+	TArray<FString> Keys;
+	for (int32 Index = 0; Index < NumImages; Index++)
+	{
+		Keys.Add(MakeKey(Prompt, Size, Index));
+		if (!Disk->Contains(Keys.Last()))
+		{
+			OnFound({});
+			return;
+		}
+	}
+	if (Keys.Num() == 0)
+	{
+		OnFound({});
+		return;
+	}
+
+	struct FFindState
+	{
+		TArray<FImage> Images;
+		int32 NumRemaining = 0;
+		bool bMissing = false;
+		TFunction<void(TArray<FImage>)> OnFound;
+	};
+
+	TSharedRef<FFindState> State = MakeShared<FFindState>();
+	State->Images.SetNum(Keys.Num());
+	State->NumRemaining = Keys.Num();
+	State->OnFound = MoveTemp(OnFound);
+
+	for (int32 Index = 0; Index < Keys.Num(); Index++)
+	{
+		Disk->Read(Keys[Index], [State, Index](FOpenAIDiskCache::FData Data)
+		{
+			State->Images[Index] = Data;
+			State->bMissing |= !Data.IsValid();
+			if (--State->NumRemaining == 0)
+			{
+				State->OnFound(State->bMissing ? TArray<FImage>() : MoveTemp(State->Images));
+			}
+		});
+	}
+}
+
+void FOpenAIImageCache::Store(const FString& Prompt, EOAImageSize Size, int32 Index, FImage Image, TFunction<void(bool Success)> OnWritten)
+{
+	check(IsInGameThread());
+	Disk->Write(MakeKey(Prompt, Size, Index), Image, MoveTemp(OnWritten));
+}
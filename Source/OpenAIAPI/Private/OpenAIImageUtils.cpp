@@ -0,0 +1,181 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIImageUtils.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Engine/Texture2D.h"
+#include "Async/Async.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+#include "Misc/Base64.h"
+#include "Modules/ModuleManager.h"
+
+IImageWrapperModule& FOpenAIImageUtils::GetImageWrapperModule()
+{
+	return FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+}
+
+bool FOpenAIImageUtils::DecodeImage(IImageWrapperModule& ImageWrapperModule, TArrayView<const uint8> Compressed, bool bGenerateMips, FDecodedImage& OutImage)
+{
+	const EImageFormat Format = ImageWrapperModule.DetectImageFormat(Compressed.GetData(), Compressed.Num());
+	if (Format == EImageFormat::Invalid)
+	{
+		return false;
+	}
+
+	TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(Format);
+	TArray<uint8> Pixels;
+	if (!ImageWrapper.IsValid()
+		|| !ImageWrapper->SetCompressed(Compressed.GetData(), Compressed.Num())
+		|| !ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, Pixels))
+	{
+		return false;
+	}
+
+	OutImage.Width = ImageWrapper->GetWidth();
+	OutImage.Height = ImageWrapper->GetHeight();
+	OutImage.Mips.Reset();
+	OutImage.Mips.Add(MoveTemp(Pixels));
+
+	if (bGenerateMips)
+	{
+		int32 Width = OutImage.Width;
+		int32 Height = OutImage.Height;
+		while (Width > 1 || Height > 1)
+		{
+			const int32 MipWidth = FMath::Max(Width / 2, 1);
+			const int32 MipHeight = FMath::Max(Height / 2, 1);
+			const uint8* Source = OutImage.Mips.Last().GetData();
+
+			TArray<uint8> Mip;
+			Mip.SetNumUninitialized(MipWidth * MipHeight * 4);
+			for (int32 Y = 0; Y < MipHeight; ++Y)
+			{
+				// odd sizes fold the last row and column into their neighbours
+				const int32 Y0 = FMath::Min(Y * 2, Height - 1);
+				const int32 Y1 = FMath::Min(Y * 2 + 1, Height - 1);
+				for (int32 X = 0; X < MipWidth; ++X)
+				{
+					const int32 X0 = FMath::Min(X * 2, Width - 1);
+					const int32 X1 = FMath::Min(X * 2 + 1, Width - 1);
+					for (int32 Channel = 0; Channel < 4; ++Channel)
+					{
+						const int32 Sum = Source[(Y0 * Width + X0) * 4 + Channel] + Source[(Y0 * Width + X1) * 4 + Channel]
+							+ Source[(Y1 * Width + X0) * 4 + Channel] + Source[(Y1 * Width + X1) * 4 + Channel];
+						Mip[(Y * MipWidth + X) * 4 + Channel] = (uint8)((Sum + 2) / 4);
+					}
+				}
+			}
+
+			OutImage.Mips.Add(MoveTemp(Mip));
+			Width = MipWidth;
+			Height = MipHeight;
+		}
+	}
+	return true;
+}
+
+bool FOpenAIImageUtils::DecodeBase64Image(IImageWrapperModule& ImageWrapperModule, const FString& Base64, bool bGenerateMips, FDecodedImage& OutImage)
+{
+	TArray<uint8> Compressed;
+	return FBase64::Decode(Base64, Compressed) && DecodeImage(ImageWrapperModule, Compressed, bGenerateMips, OutImage);
+}
+
+UTexture2D* FOpenAIImageUtils::CreateTexture(FDecodedImage&& Image)
+{
+	check(IsInGameThread());
+
+	if (Image.Mips.Num() == 0)
+	{
+		return nullptr;
+	}
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(Image.Width, Image.Height, PF_B8G8R8A8);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	FTexturePlatformData* PlatformData = Texture->GetPlatformData();
+	int32 Width = Image.Width;
+	int32 Height = Image.Height;
+	for (int32 MipIndex = 0; MipIndex < Image.Mips.Num(); ++MipIndex)
+	{
+		if (MipIndex >= PlatformData->Mips.Num())
+		{
+			FTexture2DMipMap* NewMip = new FTexture2DMipMap();
+			NewMip->SizeX = Width;
+			NewMip->SizeY = Height;
+			NewMip->SizeZ = 1;
+			PlatformData->Mips.Add(NewMip);
+		}
+
+		FTexture2DMipMap& Mip = PlatformData->Mips[MipIndex];
+		const TArray<uint8>& Pixels = Image.Mips[MipIndex];
+		Mip.BulkData.Lock(LOCK_READ_WRITE);
+		void* Data = Mip.BulkData.Realloc(Pixels.Num());
+		FMemory::Memcpy(Data, Pixels.GetData(), Pixels.Num());
+		Mip.BulkData.Unlock();
+
+		Width = FMath::Max(Width / 2, 1);
+		Height = FMath::Max(Height / 2, 1);
+	}
+
+	Texture->SRGB = true;
+	Texture->UpdateResource();
+	return Texture;
+}
+
+TArray<uint8> FOpenAIImageUtils::EncodePNG(IImageWrapperModule& ImageWrapperModule, TArrayView<const FColor> Pixels, int32 Width, int32 Height)
+{
+	TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+	if (!ImageWrapper.IsValid() || Pixels.Num() != Width * Height
+		|| !ImageWrapper->SetRaw(Pixels.GetData(), Pixels.Num() * sizeof(FColor), Width, Height, ERGBFormat::BGRA, 8))
+	{
+		return {};
+	}
+	return ImageWrapper->GetCompressed();
+}
+
+void FOpenAIImageUtils::EncodeTexturePNG(UTexture* Texture, TFunction<void(TArray<uint8>&& Png)> OnEncoded)
+{
+	check(IsInGameThread());
+
+	FTextureResource* Resource = Texture ? Texture->GetResource() : nullptr;
+	if (!Resource)
+	{
+		OnEncoded({});
+		return;
+	}
+
+	IImageWrapperModule& ImageWrapperModule = GetImageWrapperModule();
+	ENQUEUE_RENDER_COMMAND(OpenAIReadTexturePixels)([Resource, &ImageWrapperModule, OnEncoded = MoveTemp(OnEncoded)](FRHICommandListImmediate& RHICmdList) mutable
+	{
+		TArray<FColor> Pixels;
+		FRHITexture* TextureRHI = Resource->GetTextureRHI();
+		const int32 Width = (int32)Resource->GetSizeX();
+		const int32 Height = (int32)Resource->GetSizeY();
+		if (TextureRHI)
+		{
+			FReadSurfaceDataFlags Flags(RCM_UNorm);
+			Flags.SetLinearToGamma(false);
+			RHICmdList.ReadSurfaceData(TextureRHI, FIntRect(0, 0, Width, Height), Pixels, Flags);
+		}
+
+		// the render thread only pays for the readback, compression happens on a worker
+		Async(EAsyncExecution::ThreadPool, [Pixels = MoveTemp(Pixels), Width, Height, &ImageWrapperModule, OnEncoded = MoveTemp(OnEncoded)]() mutable
+		{
+			TArray<uint8> Png;
+			if (Pixels.Num() > 0)
+			{
+				Png = EncodePNG(ImageWrapperModule, Pixels, Width, Height);
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [Png = MoveTemp(Png), OnEncoded = MoveTemp(OnEncoded)]() mutable
+			{
+				OnEncoded(MoveTemp(Png));
+			});
+		});
+	});
+}
@@ -0,0 +1,244 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIIngestionJob.h"
+#include "OpenAIEmbedding.h"
+#include "OpenAIRequestQueue.h"
+#include "OpenAITextChunker.h"
+#include "OpenAIVectorIndex.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Containers/Ticker.h"
+#include "Misc/FileHelper.h"
+
+UOpenAIIngestionJob::UOpenAIIngestionJob()
+{
+}
+
+UOpenAIIngestionJob::~UOpenAIIngestionJob()
+{
+}
+
+UOpenAIIngestionJob* UOpenAIIngestionJob::OpenAIIngestDocuments(UOpenAIVectorIndex* IndexInput, TArray<FString> FilePathsInput, FIngestionSettings SettingsInput)
+{
+	UOpenAIIngestionJob* BPNode = NewObject<UOpenAIIngestionJob>();
+	BPNode->Index = IndexInput;
+	BPNode->FilePaths = FilePathsInput;
+	BPNode->Settings = SettingsInput;
+	return BPNode;
+}
+
+void UOpenAIIngestionJob::Activate()
+{
+	if (!Index || !Index->GetStore().IsValid())
+	{
+		Finished.Broadcast(0, TEXT("Vector index is not valid"), false);
+		return;
+	}
+
+	// kept alive until the last batch is written
+	AddToRoot();
+
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store = Index->GetStore();
+	TWeakObjectPtr<UOpenAIIngestionJob> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Store, FilePaths = FilePaths, Documents = Documents, Settings = Settings]() mutable
+	{
+		for (const FString& FilePath : FilePaths)
+		{
+			FString& Document = Documents.AddDefaulted_GetRef();
+			if (!FFileHelper::LoadFileToString(Document, *FilePath))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("UOpenAIIngestionJob could not read %s"), *FilePath);
+			}
+		}
+
+		TArray<FString> Chunks = FOpenAITextChunker::ChunkDocuments(Documents, Settings.chunkTokens, Settings.overlapTokens);
+		Documents.Empty();
+
+		TArray<FString> Hashes;
+		Hashes.SetNum(Chunks.Num());
+		ParallelFor(Chunks.Num(), [&](int32 i)
+		{
+			Hashes[i] = FOpenAITextChunker::HashChunk(Chunks[i]);
+		});
+
+		// identical chunks are embedded once, and anything a previous run already stored is skipped
+		TSet<FString> Seen;
+		TArray<FString> Ids;
+		TArray<FString> Texts;
+		for (int32 i = 0; i < Chunks.Num(); i++)
+		{
+			bool bAlreadySeen = false;
+			Seen.Add(Hashes[i], &bAlreadySeen);
+			if (!bAlreadySeen && !Store->Contains(Hashes[i]))
+			{
+				Ids.Add(MoveTemp(Hashes[i]));
+				Texts.Add(MoveTemp(Chunks[i]));
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("UOpenAIIngestionJob %d chunks, %d left to embed"), Chunks.Num(), Ids.Num());
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Ids = MoveTemp(Ids), Texts = MoveTemp(Texts)]() mutable
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnChunked(MoveTemp(Ids), MoveTemp(Texts));
+			}
+		});
+	});
+}
+
+void UOpenAIIngestionJob::OnChunked(TArray<FString>&& Ids, TArray<FString>&& Texts)
+{
+	ChunkIds = MoveTemp(Ids);
+	ChunkTexts = MoveTemp(Texts);
+
+	const int32 BatchSize = FMath::Max(Settings.batchSize, 1);
+	NumBatches = FMath::DivideAndRoundUp(ChunkIds.Num(), BatchSize);
+	Progress.Broadcast(0, ChunkIds.Num());
+
+	if (NumBatches == 0 || bCancelled)
+	{
+		Finish();
+		return;
+	}
+
+	RequestQueue = FOpenAIRequestQueue::Create(Settings.maxConcurrentRequests, Settings.requestsPerMinute);
+
+	TWeakObjectPtr<UOpenAIIngestionJob> WeakThis(this);
+	for (int32 BatchStart = 0; BatchStart < ChunkIds.Num(); BatchStart += BatchSize)
+	{
+		RequestQueue->Enqueue([WeakThis, BatchStart](FOpenAIRequestQueue::FOnRequestDone Done)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->SendBatch(BatchStart, 0, Done);
+			}
+			else
+			{
+				Done();
+			}
+		});
+	}
+}
+
+void UOpenAIIngestionJob::SendBatch(int32 BatchStart, int32 Attempt, TFunction<void()> Done)
+{
+	const int32 BatchEnd = FMath::Min(BatchStart + FMath::Max(Settings.batchSize, 1), ChunkIds.Num());
+
+	FEmbeddingSettings EmbeddingSettings;
+	EmbeddingSettings.model = Settings.embeddingModel;
+	EmbeddingSettings.inputs = TArray<FString>(ChunkTexts.GetData() + BatchStart, BatchEnd - BatchStart);
+
+	TWeakObjectPtr<UOpenAIIngestionJob> WeakThis(this);
+	UOpenAIEmbedding::Embedding(EmbeddingSettings, [WeakThis, BatchStart, BatchEnd, Attempt, Done](const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)
+	{
+		UOpenAIIngestionJob* Job = WeakThis.Get();
+		if (!Job)
+		{
+			Done();
+			return;
+		}
+
+		if (Success && Result.embeddingVectors.Num() == BatchEnd - BatchStart)
+		{
+			TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store = Job->Index->GetStore();
+			const TArray<FString> Ids(Job->ChunkIds.GetData() + BatchStart, BatchEnd - BatchStart);
+			const TArray<FString> Texts(Job->ChunkTexts.GetData() + BatchStart, BatchEnd - BatchStart);
+			if (Store->AddBatch(Ids, Result.embeddingVectors, Texts))
+			{
+				Job->NumChunksAdded += Ids.Num();
+			}
+			// the log is the resume point, make sure this batch is in it before moving on
+			Store->Flush();
+
+			Job->NumChunksDone += BatchEnd - BatchStart;
+			Job->Progress.Broadcast(Job->NumChunksDone, Job->ChunkIds.Num());
+		}
+		else if (Attempt + 1 < Job->Settings.maxRetries && !Job->bCancelled)
+		{
+			const float Delay = FMath::Pow(2.0f, (float)Attempt);
+			UE_LOG(LogTemp, Warning, TEXT("UOpenAIIngestionJob batch at %d failed, retrying in %.0fs: %s"), BatchStart, Delay, *ErrorMessage);
+			FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis, BatchStart, Attempt, Done](float)
+			{
+				if (!WeakThis.IsValid())
+				{
+					Done();
+				}
+				else if (WeakThis->bCancelled)
+				{
+					// Cancel counted this batch as active, it reports back without resending
+					Done();
+					WeakThis->OnBatchDone();
+				}
+				else
+				{
+					WeakThis->SendBatch(BatchStart, Attempt + 1, Done);
+				}
+				return false;
+			}), Delay);
+			return;
+		}
+		else
+		{
+			Job->NumBatchesFailed++;
+			Job->LastError = Success ? TEXT("Embedding count does not match the batch") : ErrorMessage;
+		}
+
+		Done();
+		Job->OnBatchDone();
+	});
+}
+
+void UOpenAIIngestionJob::OnBatchDone()
+{
+	NumBatchesDone++;
+	if (NumBatchesDone >= NumBatches)
+	{
+		Finish();
+	}
+}
+
+void UOpenAIIngestionJob::Cancel()
+{
+	bCancelled = true;
+	if (RequestQueue.IsValid())
+	{
+		// batches that never started won't report back
+		NumBatches = NumBatchesDone + RequestQueue->NumActive();
+		RequestQueue->CancelPending();
+		if (NumBatchesDone >= NumBatches)
+		{
+			Finish();
+		}
+	}
+}
+
+void UOpenAIIngestionJob::Finish()
+{
+	if (bFinished)
+	{
+		return;
+	}
+	bFinished = true;
+
+	if (bCancelled)
+	{
+		Finished.Broadcast(NumChunksAdded, TEXT("Ingestion cancelled"), false);
+	}
+	else if (NumBatchesFailed > 0)
+	{
+		Finished.Broadcast(NumChunksAdded, FString::Printf(TEXT("%d batches failed, run again to resume: %s"), NumBatchesFailed, *LastError), false);
+	}
+	else
+	{
+		Finished.Broadcast(NumChunksAdded, TEXT(""), true);
+	}
+
+	RequestQueue.Reset();
+	ChunkIds.Empty();
+	ChunkTexts.Empty();
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
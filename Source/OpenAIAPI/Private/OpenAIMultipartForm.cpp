@@ -0,0 +1,222 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIMultipartForm.h"
+#include "HAL/FileManager.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Misc/Guid.h"
+
+namespace
+{
+	/** Reads the parts back to back, opening each file only while it is being read. */
+	class FOpenAIMultipartReader : public FArchive
+	{
+	public:
+		explicit FOpenAIMultipartReader(TArray<FOpenAIMultipartForm::FPartRef>&& InParts)
+			: Parts(MoveTemp(InParts))
+		{
+			SetIsLoading(true);
+			SetIsPersistent(true);
+
+			for (const FOpenAIMultipartForm::FPartRef& Part : Parts)
+			{
+				Size += Part->Size;
+			}
+		}
+
+		virtual void Serialize(void* Data, int64 Length) override
+		{
+			uint8* Out = static_cast<uint8*>(Data);
+			while (Length > 0 && !IsError())
+			{
+				// find the part that holds Pos, the parts are few so a scan is fine
+				int64 PartStart = 0;
+				int32 PartIndex = 0;
+				while (PartIndex < Parts.Num() && PartStart + Parts[PartIndex]->Size <= Pos)
+				{
+					PartStart += Parts[PartIndex]->Size;
+					++PartIndex;
+				}
+				if (PartIndex == Parts.Num())
+				{
+					SetError();
+					break;
+				}
+
+				const FOpenAIMultipartForm::FPart& Part = *Parts[PartIndex];
+				const int64 Offset = Pos - PartStart;
+				const int64 Count = FMath::Min(Length, Part.Size - Offset);
+
+				if (Part.FilePath.IsEmpty())
+				{
+					FMemory::Memcpy(Out, Part.Bytes.GetData() + Offset, Count);
+				}
+				else
+				{
+					if (OpenPart != PartIndex)
+					{
+						File.Reset(IFileManager::Get().CreateFileReader(*Part.FilePath));
+						OpenPart = File ? PartIndex : INDEX_NONE;
+					}
+					if (!File || File->TotalSize() < Part.Size)
+					{
+						UE_LOG(LogTemp, Warning, TEXT("Multipart upload: %s is missing or shorter than when it was added."), *Part.FilePath);
+						SetError();
+						break;
+					}
+					if (File->Tell() != Offset)
+					{
+						File->Seek(Offset);
+					}
+					File->Serialize(Out, Count);
+					if (File->IsError())
+					{
+						SetError();
+						break;
+					}
+				}
+
+				Out += Count;
+				Pos += Count;
+				Length -= Count;
+			}
+		}
+
+		virtual void Seek(int64 InPos) override
+		{
+			Pos = FMath::Clamp<int64>(InPos, 0, Size);
+		}
+
+		virtual int64 Tell() override { return Pos; }
+		virtual int64 TotalSize() override { return Size; }
+		virtual FString GetArchiveName() const override { return TEXT("FOpenAIMultipartReader"); }
+
+	private:
+		TArray<FOpenAIMultipartForm::FPartRef> Parts;
+		int64 Size = 0;
+		int64 Pos = 0;
+
+		TUniquePtr<FArchive> File;
+		int32 OpenPart = INDEX_NONE;
+	};
+
+	TArray<uint8> ToUTF8(const FString& Text)
+	{
+		// byte length of the converted string, Text.Len() counts characters
+		FTCHARToUTF8 Converted(*Text, Text.Len());
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	}
+}
+
+FOpenAIMultipartForm::FOpenAIMultipartForm()
+	: Boundary(TEXT("OpenAIBoundary") + FGuid::NewGuid().ToString(EGuidFormats::Digits))
+{
+}
+
+void FOpenAIMultipartForm::AddField(const FString& Name, const FString& Value)
+{
+	AppendPartHeader(Name, nullptr, nullptr);
+	AppendText(Value + TEXT("\r\n"));
+}
+
+bool FOpenAIMultipartForm::AddFile(const FString& Name, const FString& FileName, const FString& ContentType, const FString& FilePath)
+{
+	const int64 FileSize = IFileManager::Get().FileSize(*FilePath);
+	if (FileSize < 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Multipart upload: file %s not found."), *FilePath);
+		return false;
+	}
+
+	AppendPartHeader(Name, &FileName, &ContentType);
+
+	FPartRef Part = MakeShared<FPart, ESPMode::ThreadSafe>();
+	Part->FilePath = FilePath;
+	Part->Size = FileSize;
+	Parts.Add(Part);
+
+	AppendText(TEXT("\r\n"));
+	return true;
+}
+
+void FOpenAIMultipartForm::AddFileData(const FString& Name, const FString& FileName, const FString& ContentType, TArray<uint8>&& Data)
+{
+	AppendPartHeader(Name, &FileName, &ContentType);
+
+	FPartRef Part = MakeShared<FPart, ESPMode::ThreadSafe>();
+	Part->Bytes = MoveTemp(Data);
+	Part->Size = Part->Bytes.Num();
+	Parts.Add(Part);
+
+	AppendText(TEXT("\r\n"));
+}
+
+FString FOpenAIMultipartForm::GetContentType() const
+{
+	return TEXT("multipart/form-data; boundary=") + Boundary;
+}
+
+int64 FOpenAIMultipartForm::GetContentLength() const
+{
+	int64 Length = MakeTrailer()->Size;
+	for (const FPartRef& Part : Parts)
+	{
+		Length += Part->Size;
+	}
+	return Length;
+}
+
+bool FOpenAIMultipartForm::ApplyTo(IHttpRequest& Request) const
+{
+	Request.SetHeader(TEXT("Content-Type"), GetContentType());
+	return Request.SetContentFromStream(CreateReader());
+}
+
+TSharedRef<FArchive, ESPMode::ThreadSafe> FOpenAIMultipartForm::CreateReader() const
+{
+	TArray<FPartRef> ReaderParts = Parts;
+	ReaderParts.Add(MakeTrailer());
+	return MakeShared<FOpenAIMultipartReader, ESPMode::ThreadSafe>(MoveTemp(ReaderParts));
+}
+
+void FOpenAIMultipartForm::AppendText(const FString& Text)
+{
+	TArray<uint8> Bytes = ToUTF8(Text);
+
+	// consecutive headers and fields share one buffer
+	if (Parts.Num() > 0 && Parts.Last()->bText)
+	{
+		Parts.Last()->Bytes.Append(Bytes);
+		Parts.Last()->Size = Parts.Last()->Bytes.Num();
+		return;
+	}
+
+	FPartRef Part = MakeShared<FPart, ESPMode::ThreadSafe>();
+	Part->Bytes = MoveTemp(Bytes);
+	Part->Size = Part->Bytes.Num();
+	Part->bText = true;
+	Parts.Add(Part);
+}
+
+void FOpenAIMultipartForm::AppendPartHeader(const FString& Name, const FString* FileName, const FString* ContentType)
+{
+	FString Header = FString::Printf(TEXT("--%s\r\nContent-Disposition: form-data; name=\"%s\""), *Boundary, *Name);
+	if (FileName)
+	{
+		Header += FString::Printf(TEXT("; filename=\"%s\""), **FileName);
+	}
+	Header += TEXT("\r\n");
+	if (ContentType)
+	{
+		Header += FString::Printf(TEXT("Content-Type: %s\r\n"), **ContentType);
+	}
+	Header += TEXT("\r\n");
+	AppendText(Header);
+}
+
+FOpenAIMultipartForm::FPartRef FOpenAIMultipartForm::MakeTrailer() const
+{
+	FPartRef Trailer = MakeShared<FPart, ESPMode::ThreadSafe>();
+	Trailer->Bytes = ToUTF8(FString::Printf(TEXT("--%s--\r\n"), *Boundary));
+	Trailer->Size = Trailer->Bytes.Num();
+	return Trailer;
+}
@@ -2,10 +2,17 @@
 
 #include "OpenAIParser.h"
 #include "OpenAIUtils.h"
+#include "OpenAISpeechCache.h"
 #include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
 
 
 // Constructor
+OpenAIParser::OpenAIParser()
+{
+}
+
 OpenAIParser::OpenAIParser(const FCompletionSettings& settings)
 	: completionSettings(settings)
 {
@@ -73,57 +80,22 @@ FChatCompletion OpenAIParser::ParseChatCompletion(const FJsonObject& json)
 	return res;
 }
 
-FSpeechCompletion OpenAIParser::ParseSpeechCompletion(const FJsonObject&)
+// the speech endpoint returns the audio file itself, it is written to Saved/SpeechAudio the same way FOpenAISpeechCache::SaveUncached writes it.
+// The file is written synchronously and outside that cache's index, the directory is trimmed to its budget the next time the index is built.
+// Safe to call from a worker thread.
+FSpeechCompletion OpenAIParser::ParseSpeechCompletion(const TArray<uint8>& audio)
 {
-	/*
-*Create speech
-POST
-
-https://api.openai.com/v1/audio/speech
-
-Generates audio from the input text.
-
-Request body
-model
-string
-Required
-One of the available TTS models: tts-1 or tts-1-hd
-
-input
-string
-Required
-The text to generate audio for. The maximum length is 4096 characters.
-
-voice
-string
-Required
-The voice to use when generating the audio. Supported voices are alloy, echo, fable, onyx, nova, and shimmer.
-
-response_format
-string
-Optional
-Defaults to mp3
-The format to audio in. Supported formats are mp3, opus, aac, and flac.
-
-speed
-number
-Optional
-Defaults to 1
-The speed of the generated audio. Select a value from 0.25 to 4.0. 1.0 is the default.
-
-Returns
-The audio file content.
- */
-
-///	FString res = "";
-
-	// Handle the received audio data
-	//TArray<uint8> ReceivedData = Response->GetContent();
-            
-	// For demonstration purposes, write the data to a file on disk
-	//FFileHelper::SaveArrayToFile(ReceivedData, *FPaths::ProjectSavedDir() / TEXT("ReceivedAudio.mp3"));
-
-	return {};
+	FSpeechCompletion res = {};
+
+	const FOpenAISpeechCache::FAudio fileData = FOpenAISpeechCache::MakeFileData(speechSettings, audio);
+	const FString path = FPaths::Combine(FOpenAISpeechCache::GetUncachedDirectory(), FOpenAISpeechCache::MakeUncachedFileName(speechSettings));
+	if (FFileHelper::SaveArrayToFile(*fileData, *path))
+	{
+		res.audioFilePath = path;
+		res.finishReason = TEXT("stop");
+	}
+
+	return res;
 }
 
 FString OpenAIParser::ParseTranscriptionCompletion(const FJsonObject& json)
@@ -0,0 +1,100 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIRequestQueue.h"
+
+TSharedRef<FOpenAIRequestQueue> FOpenAIRequestQueue::Create(int32 MaxConcurrent, int32 RequestsPerMinute)
+{
+	return MakeShareable(new FOpenAIRequestQueue(MaxConcurrent, RequestsPerMinute));
+}
+
+FOpenAIRequestQueue::FOpenAIRequestQueue(int32 InMaxConcurrent, int32 InRequestsPerMinute)
+	: MaxConcurrent(FMath::Max(InMaxConcurrent, 1))
+	, RequestsPerMinute(FMath::Max(InRequestsPerMinute, 0))
+{
+}
+
+FOpenAIRequestQueue::~FOpenAIRequestQueue()
+{
+	if (TickHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	}
+}
+
+void FOpenAIRequestQueue::Enqueue(FRequest Request)
+{
+	check(IsInGameThread());
+	Pending.Add(MoveTemp(Request));
+	Pump();
+}
+
+void FOpenAIRequestQueue::CancelPending()
+{
+	Pending.Reset();
+	NextPending = 0;
+}
+
+bool FOpenAIRequestQueue::CanStartRequest(double Now)
+{
+	if (NumInFlight >= MaxConcurrent)
+	{
+		return false;
+	}
+	if (RequestsPerMinute == 0)
+	{
+		return true;
+	}
+
+	RecentStarts.RemoveAll([Now](double Start) { return Now - Start >= 60.0; });
+	return RecentStarts.Num() < RequestsPerMinute;
+}
+
+void FOpenAIRequestQueue::Pump()
+{
+	const double Now = FPlatformTime::Seconds();
+	while (NumPending() > 0 && CanStartRequest(Now))
+	{
+		FRequest Request = MoveTemp(Pending[NextPending++]);
+		NumInFlight++;
+		if (RequestsPerMinute > 0)
+		{
+			RecentStarts.Add(Now);
+		}
+
+		TWeakPtr<FOpenAIRequestQueue> WeakThis = AsShared();
+		TSharedRef<bool> bDone = MakeShared<bool>(false);
+		Request([WeakThis, bDone]()
+		{
+			TSharedPtr<FOpenAIRequestQueue> Queue = WeakThis.Pin();
+			if (Queue.IsValid() && !*bDone)
+			{
+				*bDone = true;
+				Queue->OnRequestDone();
+			}
+		});
+	}
+
+	if (NumPending() == 0)
+	{
+		Pending.Reset();
+		NextPending = 0;
+	}
+	else if (NumInFlight < MaxConcurrent && !TickHandle.IsValid())
+	{
+		// rate limited, check again once the oldest start leaves the window
+		TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateSP(this, &FOpenAIRequestQueue::Tick), 0.25f);
+	}
+}
+
+void FOpenAIRequestQueue::OnRequestDone()
+{
+	NumInFlight--;
+	Pump();
+}
+
+bool FOpenAIRequestQueue::Tick(float DeltaTime)
+{
+	TickHandle.Reset();
+	Pump();
+	return false;
+}
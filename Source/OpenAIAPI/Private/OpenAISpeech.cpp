@@ -0,0 +1,205 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAISpeech.h"
+#include "OpenAIUtils.h"
+#include "Http.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Interfaces/IHttpResponse.h"
+
+TSharedRef<FOpenAISpeechRequest> FOpenAISpeechRequest::Start(const FSpeechSettings& Settings, FOnAudio OnAudio, FOnDone OnDone)
+{
+	TSharedRef<FOpenAISpeechRequest> Request = MakeShareable(new FOpenAISpeechRequest(Settings, MoveTemp(OnAudio), MoveTemp(OnDone)));
+	Request->Send();
+	return Request;
+}
+
+FOpenAISpeechRequest::FOpenAISpeechRequest(const FSpeechSettings& InSettings, FOnAudio InOnAudio, FOnDone InOnDone)
+	: Settings(InSettings)
+	, OnAudio(MoveTemp(InOnAudio))
+	, OnDone(MoveTemp(InOnDone))
+{
+}
+
+void FOpenAISpeechRequest::Send()
+{
+	FString ApiKey;
+	if (UOpenAIUtils::GetUseApiKeyFromEnvironmentVars())
+		ApiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		ApiKey = UOpenAIUtils::GetApiKey();
+
+	if (ApiKey.IsEmpty())
+	{
+		if (OnDone)
+		{
+			OnDone({}, TEXT("Api key is not set"), false);
+		}
+		return;
+	}
+
+	TSharedPtr<FJsonObject> PayloadObject = MakeShareable(new FJsonObject());
+	PayloadObject->SetStringField(TEXT("model"), GetModelName(Settings.model));
+	PayloadObject->SetStringField(TEXT("input"), Settings.input);
+	PayloadObject->SetStringField(TEXT("voice"), GetVoiceName(Settings.voice));
+	PayloadObject->SetStringField(TEXT("response_format"), GetFormatName(Settings.responseFormat));
+	PayloadObject->SetNumberField(TEXT("speed"), FMath::Clamp(Settings.speed, 0.25f, 4.0f));
+
+	FString Payload;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Payload);
+	FJsonSerializer::Serialize(PayloadObject.ToSharedRef(), Writer);
+
+	HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(TEXT("https://api.openai.com/v1/audio/speech"));
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + ApiKey);
+	HttpRequest->SetContentAsString(Payload);
+
+	// the progress delegate fires as the body arrives, which is what lets playback start before the download ends
+	TWeakPtr<FOpenAISpeechRequest> WeakThis = AsShared();
+	HttpRequest->OnRequestProgress64().BindLambda([WeakThis](FHttpRequestPtr Request, uint64 BytesSent, uint64 BytesReceived)
+	{
+		if (TSharedPtr<FOpenAISpeechRequest> This = WeakThis.Pin())
+		{
+			This->OnProgress(Request);
+		}
+	});
+	HttpRequest->OnProcessRequestComplete().BindLambda([WeakThis](FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+	{
+		if (TSharedPtr<FOpenAISpeechRequest> This = WeakThis.Pin())
+		{
+			This->OnComplete(Request, Response, WasSuccessful);
+		}
+	});
+
+	Self = AsShared();
+	if (!HttpRequest->ProcessRequest())
+	{
+		Self.Reset();
+		if (OnDone)
+		{
+			OnDone({}, TEXT("Error sending request"), false);
+		}
+	}
+}
+
+void FOpenAISpeechRequest::Cancel()
+{
+	OnAudio = nullptr;
+	OnDone = nullptr;
+	if (HttpRequest.IsValid())
+	{
+		HttpRequest->OnRequestProgress64().Unbind();
+		HttpRequest->OnProcessRequestComplete().Unbind();
+		HttpRequest->CancelRequest();
+	}
+	Self.Reset();
+}
+
+void FOpenAISpeechRequest::OnProgress(FHttpRequestPtr Request)
+{
+	FHttpResponsePtr Response = Request->GetResponse();
+	if (Response.IsValid() && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		DeliverAudio(Response->GetContent());
+	}
+}
+
+void FOpenAISpeechRequest::OnComplete(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	// released on return, callbacks may drop the last outside reference
+	TSharedPtr<FOpenAISpeechRequest> KeepAlive = MoveTemp(Self);
+
+	if (!WasSuccessful || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		const FString ErrorMessage = Response.IsValid() ? Response->GetContentAsString() : TEXT("Error processing request");
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAISpeechRequest failed: %s"), *ErrorMessage);
+		if (OnDone)
+		{
+			OnDone({}, ErrorMessage, false);
+		}
+		return;
+	}
+
+	DeliverAudio(Response->GetContent());
+	if (OnDone)
+	{
+		OnDone(Response->GetContent(), TEXT(""), true);
+	}
+}
+
+void FOpenAISpeechRequest::DeliverAudio(const TArray<uint8>& Content)
+{
+	int64 Available = Content.Num();
+
+	// a pcm sample split across two reads is held back until its second byte arrives
+	if (Settings.responseFormat == EOASpeechResponseFormat::PCM)
+	{
+		Available &= ~int64(1);
+	}
+
+	if (Available > NumDelivered && OnAudio)
+	{
+		OnAudio(TArrayView<const uint8>(Content.GetData() + NumDelivered, Available - NumDelivered));
+	}
+	NumDelivered = FMath::Max(NumDelivered, Available);
+}
+
+FString FOpenAISpeechRequest::GetModelName(EOASpeechEngineType Model)
+{
+	switch (Model)
+	{
+	case EOASpeechEngineType::TTS_1_HD:
+		return TEXT("tts-1-hd");
+	case EOASpeechEngineType::TTS_1:
+	default:
+		return TEXT("tts-1");
+	}
+}
+
+FString FOpenAISpeechRequest::GetVoiceName(EOASpeechVoice Voice)
+{
+	switch (Voice)
+	{
+	case EOASpeechVoice::ECHO:
+		return TEXT("echo");
+	case EOASpeechVoice::FABLE:
+		return TEXT("fable");
+	case EOASpeechVoice::ONYX:
+		return TEXT("onyx");
+	case EOASpeechVoice::NOVA:
+		return TEXT("nova");
+	case EOASpeechVoice::SHIMMER:
+		return TEXT("shimmer");
+	case EOASpeechVoice::ALLOY:
+	default:
+		return TEXT("alloy");
+	}
+}
+
+FString FOpenAISpeechRequest::GetFormatName(EOASpeechResponseFormat Format)
+{
+	switch (Format)
+	{
+	case EOASpeechResponseFormat::OPUS:
+		return TEXT("opus");
+	case EOASpeechResponseFormat::AAC:
+		return TEXT("aac");
+	case EOASpeechResponseFormat::FLAC:
+		return TEXT("flac");
+	case EOASpeechResponseFormat::WAV:
+		return TEXT("wav");
+	case EOASpeechResponseFormat::PCM:
+		return TEXT("pcm");
+	case EOASpeechResponseFormat::MP3:
+	default:
+		return TEXT("mp3");
+	}
+}
+
+FString FOpenAISpeechRequest::GetFileExtension(EOASpeechResponseFormat Format)
+{
+	// raw pcm is stored with a wav header so it can be opened by anything
+	return Format == EOASpeechResponseFormat::PCM ? TEXT("wav") : GetFormatName(Format);
+}
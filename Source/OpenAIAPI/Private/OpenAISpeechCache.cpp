@@ -0,0 +1,241 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAISpeechCache.h"
+#include "OpenAIAudioUtils.h"
+#include "OpenAIRequestQueue.h"
+#include "OpenAISpeech.h"
+#include "Misc/Guid.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+
+namespace
+{
+	constexpr int64 DefaultMaxDiskBytes = 256ll * 1024 * 1024;
+	constexpr int64 DefaultMaxMemoryBytes = 32ll * 1024 * 1024;
+	constexpr int64 MaxUncachedBytes = 64ll * 1024 * 1024;
+	constexpr int32 WavHeaderSize = 44;
+	const TCHAR* UncachedDirectoryName = TEXT("SpeechAudio");
+}
+
+FOpenAISpeechCache& FOpenAISpeechCache::Get()
+{
+	static FOpenAISpeechCache Instance;
+	return Instance;
+}
+
+FOpenAISpeechCache::FOpenAISpeechCache()
+	: Disk(FOpenAIDiskCache::Create(TEXT("SpeechCache"), DefaultMaxDiskBytes))
+	, UncachedDisk(FOpenAIDiskCache::Create(UncachedDirectoryName, MaxUncachedBytes))
+	, MaxHotBytes(DefaultMaxMemoryBytes)
+{
+}
+
+void FOpenAISpeechCache::SetLimits(int64 MaxDiskBytes, int64 MaxMemoryBytes)
+{
+	Disk->SetMaxBytes(MaxDiskBytes);
+	MaxHotBytes = MaxMemoryBytes;
+	AddToMemory(FString(), nullptr);
+}
+
+FString FOpenAISpeechCache::MakeKey(const FSpeechSettings& Settings)
+{
+	const FString Identity = FString::Printf(TEXT("%s|%s|%.3f|%s|%s"),
+		*FOpenAISpeechRequest::GetModelName(Settings.model),
+		*FOpenAISpeechRequest::GetVoiceName(Settings.voice),
+		FMath::Clamp(Settings.speed, 0.25f, 4.0f),
+		*FOpenAISpeechRequest::GetFormatName(Settings.responseFormat),
+		*Settings.input);
+
+	FTCHARToUTF8 Converted(*Identity);
+	FSHAHash Hash;
+	FSHA1::HashBuffer(Converted.Get(), Converted.Length(), Hash.Hash);
+	return Hash.ToString() + TEXT(".") + FOpenAISpeechRequest::GetFileExtension(Settings.responseFormat);
+}
+
+FString FOpenAISpeechCache::GetFilePath(const FSpeechSettings& Settings) const
+{
+	return Disk->GetFilePath(MakeKey(Settings));
+}
+
+FOpenAISpeechCache::FAudio FOpenAISpeechCache::FindInMemory(const FSpeechSettings& Settings)
+{
+	if (FHotEntry* Entry = Hot.Find(MakeKey(Settings)))
+	{
+		Entry->LastUse = ++UseCounter;
+		return Entry->Audio;
+	}
+	return nullptr;
+}
+
+void FOpenAISpeechCache::Find(const FSpeechSettings& Settings, TFunction<void(FAudio Audio)> OnFound)
+{
+	check(IsInGameThread());
+
+	if (FAudio Audio = FindInMemory(Settings))
+	{
+		OnFound(Audio);
+		return;
+	}
+
+	const FString Key = MakeKey(Settings);
+	const bool bRawPCM = Settings.responseFormat == EOASpeechResponseFormat::PCM;
+	Disk->Read(Key, [this, Key, bRawPCM, OnFound = MoveTemp(OnFound)](FOpenAIDiskCache::FData Data)
+	{
+		// pcm is stored as wav, memory holds the samples ready to queue on a sound
+		if (Data.IsValid() && bRawPCM)
+		{
+			FAudio Samples;
+			if (Data->Num() >= WavHeaderSize)
+			{
+				Samples = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(Data->GetData() + WavHeaderSize, Data->Num() - WavHeaderSize);
+				AddToMemory(Key, Samples);
+			}
+			Data = Samples;
+		}
+		OnFound(Data);
+	});
+}
+
+void FOpenAISpeechCache::Store(const FSpeechSettings& Settings, const TArray<uint8>& Audio, TFunction<void(bool Success)> OnWritten)
+{
+	check(IsInGameThread());
+
+	const FString Key = MakeKey(Settings);
+	if (Settings.responseFormat == EOASpeechResponseFormat::PCM)
+	{
+		AddToMemory(Key, MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(Audio));
+	}
+	Disk->Write(Key, MakeFileData(Settings, Audio), MoveTemp(OnWritten));
+}
+
+void FOpenAISpeechCache::SaveUncached(const FSpeechSettings& Settings, const TArray<uint8>& Audio, TFunction<void(const FString& FilePath)> OnSaved)
+{
+	check(IsInGameThread());
+
+	// every call gets its own file, the caller may still be playing the previous one
+	const FString Key = MakeUncachedFileName(Settings);
+	UncachedDisk->Write(Key, MakeFileData(Settings, Audio), [FilePath = UncachedDisk->GetFilePath(Key), OnSaved = MoveTemp(OnSaved)](bool bWritten)
+	{
+		OnSaved(bWritten ? FilePath : FString());
+	});
+}
+
+FString FOpenAISpeechCache::GetUncachedDirectory()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), UncachedDirectoryName);
+}
+
+FString FOpenAISpeechCache::MakeUncachedFileName(const FSpeechSettings& Settings)
+{
+	return FGuid::NewGuid().ToString() + TEXT(".") + FOpenAISpeechRequest::GetFileExtension(Settings.responseFormat);
+}
+
+FOpenAISpeechCache::FAudio FOpenAISpeechCache::MakeFileData(const FSpeechSettings& Settings, const TArray<uint8>& Audio)
+{
+	// pcm is written with a wav header so the file plays anywhere, other formats are written as returned
+	if (Settings.responseFormat == EOASpeechResponseFormat::PCM)
+	{
+		return MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(FOpenAIAudioUtils::WrapPCM16AsWav(Audio, 1, FOpenAISpeechRequest::PCMSampleRate));
+	}
+	return MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(Audio);
+}
+
+void FOpenAISpeechCache::Prewarm(const TArray<FSpeechSettings>& Lines, int32 MaxConcurrent, TFunction<void(int32 NumReady, int32 NumFailed)> OnDone)
+{
+	check(IsInGameThread());
+
+	struct FPrewarmState
+	{
+		int32 NumRemaining = 0;
+		int32 NumReady = 0;
+		int32 NumFailed = 0;
+		TFunction<void(int32, int32)> OnDone;
+
+		void LineDone(bool bReady)
+		{
+			(bReady ? NumReady : NumFailed)++;
+			if (--NumRemaining == 0 && OnDone)
+			{
+				OnDone(NumReady, NumFailed);
+			}
+		}
+	};
+
+	TSharedRef<FPrewarmState> State = MakeShared<FPrewarmState>();
+	State->NumRemaining = Lines.Num();
+	State->OnDone = MoveTemp(OnDone);
+	if (Lines.Num() == 0)
+	{
+		if (State->OnDone)
+		{
+			State->OnDone(0, 0);
+		}
+		return;
+	}
+
+	if (!PrewarmQueue.IsValid())
+	{
+		PrewarmQueue = FOpenAIRequestQueue::Create(FMath::Max(MaxConcurrent, 1));
+	}
+
+	for (const FSpeechSettings& Line : Lines)
+	{
+		Find(Line, [this, Line, State](FAudio Audio)
+		{
+			if (Audio.IsValid())
+			{
+				State->LineDone(true);
+				return;
+			}
+
+			PrewarmQueue->Enqueue([this, Line, State](FOpenAIRequestQueue::FOnRequestDone Done)
+			{
+				FOpenAISpeechRequest::Start(Line, nullptr, [this, Line, State, Done](const TArray<uint8>& Audio, const FString& ErrorMessage, bool Success)
+				{
+					if (Success)
+					{
+						Store(Line, Audio);
+					}
+					else
+					{
+						UE_LOG(LogTemp, Warning, TEXT("FOpenAISpeechCache could not prewarm \"%s\": %s"), *Line.input, *ErrorMessage);
+					}
+					Done();
+					State->LineDone(Success);
+				});
+			});
+		});
+	}
+}
+
+void FOpenAISpeechCache::AddToMemory(const FString& Key, FAudio Audio)
+{
+	if (Audio.IsValid())
+	{
+		if (FHotEntry* Existing = Hot.Find(Key))
+		{
+			HotBytes -= Existing->Audio->Num();
+		}
+		FHotEntry& Entry = Hot.Add(Key);
+		Entry.Audio = Audio;
+		Entry.LastUse = ++UseCounter;
+		HotBytes += Audio->Num();
+	}
+
+	// drop least recently used lines until the hot set fits, the newest entry always stays
+	while (HotBytes > MaxHotBytes && Hot.Num() > 1)
+	{
+		const FString* Oldest = nullptr;
+		uint64 OldestUse = MAX_uint64;
+		for (const TPair<FString, FHotEntry>& Pair : Hot)
+		{
+			if (Pair.Value.LastUse < OldestUse)
+			{
+				OldestUse = Pair.Value.LastUse;
+				Oldest = &Pair.Key;
+			}
+		}
+		const FString OldestKey = *Oldest;
+		HotBytes -= Hot.FindAndRemoveChecked(OldestKey).Audio->Num();
+	}
+}
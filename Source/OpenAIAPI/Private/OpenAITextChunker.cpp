@@ -0,0 +1,216 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAITextChunker.h"
+#include "Async/ParallelFor.h"
+#include "Misc/SecureHash.h"
+
+namespace
+{
+	constexpr int32 CharsPerToken = 4;
+
+	// documents larger than this are split at paragraph breaks so one big file still uses every worker
+	constexpr int32 SectionChars = 256 * 1024;
+
+	struct FPiece
+	{
+		int32 Start;
+		int32 End;
+		int32 Tokens;
+		bool bEndsSentence;
+		bool bEndsParagraph;
+	};
+
+	// a piece is a word or punctuation run together with the whitespace in front of it
+	TArray<FPiece> SplitPieces(const FString& Text)
+	{
+		TArray<FPiece> Pieces;
+		Pieces.Reserve(Text.Len() / 5 + 1);
+
+		const TCHAR* Data = *Text;
+		const int32 Len = Text.Len();
+		int32 Cursor = 0;
+		while (Cursor < Len)
+		{
+			FPiece Piece;
+			Piece.Start = Cursor;
+
+			int32 NewLines = 0;
+			while (Cursor < Len && FChar::IsWhitespace(Data[Cursor]))
+			{
+				NewLines += Data[Cursor] == TEXT('\n');
+				Cursor++;
+			}
+			if (NewLines >= 2 && Pieces.Num() > 0)
+			{
+				Pieces.Last().bEndsParagraph = true;
+			}
+
+			const int32 WordStart = Cursor;
+			int32 Punctuation = 0;
+			while (Cursor < Len && !FChar::IsWhitespace(Data[Cursor]))
+			{
+				Punctuation += FChar::IsPunct(Data[Cursor]);
+				Cursor++;
+			}
+
+			const int32 WordChars = Cursor - WordStart;
+			if (WordChars == 0)
+			{
+				// trailing whitespace, fold it into the previous piece
+				if (Pieces.Num() > 0)
+				{
+					Pieces.Last().End = Cursor;
+				}
+				break;
+			}
+
+			const TCHAR Last = Data[Cursor - 1];
+			Piece.End = Cursor;
+			Piece.Tokens = FMath::Max(FMath::DivideAndRoundUp(WordChars - Punctuation, CharsPerToken), 1) + Punctuation;
+			Piece.bEndsSentence = Last == TEXT('.') || Last == TEXT('!') || Last == TEXT('?');
+			Piece.bEndsParagraph = false;
+			Pieces.Add(Piece);
+		}
+		return Pieces;
+	}
+
+	TArray<FString> SplitSections(const FString& Text)
+	{
+		TArray<FString> Sections;
+		int32 Start = 0;
+		while (Text.Len() - Start > SectionChars)
+		{
+			int32 Cut = Text.Find(TEXT("\n\n"), ESearchCase::CaseSensitive, ESearchDir::FromStart, Start + SectionChars);
+			if (Cut == INDEX_NONE)
+			{
+				break;
+			}
+			Sections.Add(Text.Mid(Start, Cut - Start));
+			Start = Cut + 2;
+		}
+		Sections.Add(Text.Mid(Start));
+		return Sections;
+	}
+}
+
+int32 FOpenAITextChunker::EstimateTokens(const FStringView& Text)
+{
+	int32 Tokens = 0;
+	int32 WordChars = 0;
+	for (const TCHAR Char : Text)
+	{
+		if (FChar::IsWhitespace(Char))
+		{
+			Tokens += FMath::DivideAndRoundUp(WordChars, CharsPerToken);
+			WordChars = 0;
+		}
+		else if (FChar::IsPunct(Char))
+		{
+			Tokens++;
+		}
+		else
+		{
+			WordChars++;
+		}
+	}
+	return Tokens + FMath::DivideAndRoundUp(WordChars, CharsPerToken);
+}
+
+TArray<FString> FOpenAITextChunker::Chunk(const FString& Text, int32 ChunkTokens, int32 OverlapTokens)
+{
+	ChunkTokens = FMath::Max(ChunkTokens, 1);
+	OverlapTokens = FMath::Clamp(OverlapTokens, 0, ChunkTokens / 2);
+
+	const TArray<FPiece> Pieces = SplitPieces(Text);
+
+	TArray<FString> Chunks;
+	int32 First = 0;
+	while (First < Pieces.Num())
+	{
+		// grow the chunk up to the budget, remembering the last good place to cut
+		int32 Tokens = 0;
+		int32 Last = First;
+		int32 SentenceCut = INDEX_NONE;
+		int32 ParagraphCut = INDEX_NONE;
+		while (Last < Pieces.Num() && (Last == First || Tokens + Pieces[Last].Tokens <= ChunkTokens))
+		{
+			Tokens += Pieces[Last].Tokens;
+			if (Pieces[Last].bEndsParagraph)
+			{
+				ParagraphCut = Last;
+			}
+			if (Pieces[Last].bEndsSentence)
+			{
+				SentenceCut = Last;
+			}
+			Last++;
+		}
+
+		int32 End = Last - 1;
+		if (Last < Pieces.Num())
+		{
+			// only cut early if it keeps at least half the chunk
+			const int32 MinEnd = First + (Last - First) / 2;
+			if (ParagraphCut >= MinEnd)
+			{
+				End = ParagraphCut;
+			}
+			else if (SentenceCut >= MinEnd)
+			{
+				End = SentenceCut;
+			}
+		}
+
+		const int32 StartChar = Pieces[First].Start;
+		Chunks.Add(Text.Mid(StartChar, Pieces[End].End - StartChar).TrimStartAndEnd());
+
+		if (End + 1 >= Pieces.Num())
+		{
+			break;
+		}
+
+		// step back over the overlap, but always move forward
+		int32 Next = End + 1;
+		int32 Overlap = 0;
+		while (Next - 1 > First && Overlap + Pieces[Next - 1].Tokens <= OverlapTokens)
+		{
+			Next--;
+			Overlap += Pieces[Next].Tokens;
+		}
+		First = Next;
+	}
+
+	Chunks.RemoveAll([](const FString& Chunk) { return Chunk.IsEmpty(); });
+	return Chunks;
+}
+
+TArray<FString> FOpenAITextChunker::ChunkDocuments(const TArray<FString>& Documents, int32 ChunkTokens, int32 OverlapTokens)
+{
+	TArray<FString> Sections;
+	for (const FString& Document : Documents)
+	{
+		Sections.Append(SplitSections(Document));
+	}
+
+	TArray<TArray<FString>> SectionChunks;
+	SectionChunks.SetNum(Sections.Num());
+	ParallelFor(Sections.Num(), [&](int32 Index)
+	{
+		SectionChunks[Index] = Chunk(Sections[Index], ChunkTokens, OverlapTokens);
+	});
+
+	TArray<FString> Chunks;
+	for (TArray<FString>& Section : SectionChunks)
+	{
+		Chunks.Append(MoveTemp(Section));
+	}
+	return Chunks;
+}
+
+FString FOpenAITextChunker::HashChunk(const FString& Chunk)
+{
+	FTCHARToUTF8 Converted(*Chunk);
+	FSHAHash Hash;
+	FSHA1::HashBuffer(Converted.Get(), Converted.Length(), Hash.Hash);
+	return Hash.ToString();
+}
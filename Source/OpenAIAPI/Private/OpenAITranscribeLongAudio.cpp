@@ -0,0 +1,342 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAITranscribeLongAudio.h"
+#include "OpenAIAudioUtils.h"
+#include "OpenAIMultipartForm.h"
+#include "OpenAIRequestQueue.h"
+#include "OpenAIUtils.h"
+#include "Http.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Containers/Ticker.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+UOpenAITranscribeLongAudio::UOpenAITranscribeLongAudio()
+{
+}
+
+UOpenAITranscribeLongAudio::~UOpenAITranscribeLongAudio()
+{
+}
+
+UOpenAITranscribeLongAudio* UOpenAITranscribeLongAudio::OpenAITranscribeLongAudio(FString FilePathInput, FLongTranscriptionSettings SettingsInput)
+{
+	UOpenAITranscribeLongAudio* BPNode = NewObject<UOpenAITranscribeLongAudio>();
+	BPNode->FilePath = FilePathInput;
+	BPNode->Settings = SettingsInput;
+	return BPNode;
+}
+
+void UOpenAITranscribeLongAudio::Activate()
+{
+	if (UOpenAIUtils::GetUseApiKeyFromEnvironmentVars())
+		ApiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		ApiKey = UOpenAIUtils::GetApiKey();
+
+	if (ApiKey.IsEmpty())
+	{
+		Finished.Broadcast({}, {}, TEXT("Api key is not set"), false);
+		return;
+	}
+
+	// kept alive until the last piece is back
+	AddToRoot();
+
+	const FString AbsolutePath = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), FilePath);
+	TWeakObjectPtr<UOpenAITranscribeLongAudio> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, AbsolutePath, PCM = MoveTemp(Samples), Rate = SampleRate, Channels = NumChannels, Settings = Settings]() mutable
+	{
+		FString Error;
+		if (PCM.Num() == 0)
+		{
+			TArray<uint8> FileData;
+			if (!FFileHelper::LoadFileToArray(FileData, *AbsolutePath))
+			{
+				Error = FString::Printf(TEXT("Audio file %s not found"), *AbsolutePath);
+			}
+			else if (!FOpenAIAudioUtils::DecodeWav(FileData, PCM, Rate, Channels))
+			{
+				Error = FString::Printf(TEXT("%s is not a PCM wav file"), *AbsolutePath);
+			}
+		}
+
+		TArray<FPiece> NewPieces;
+		if (Error.IsEmpty() && PCM.Num() > 0)
+		{
+			FAudioPreprocessSettings Preprocess;
+			Preprocess.sampleRate = Settings.sampleRate;
+			FOpenAIAudioUtils::Preprocess(PCM, Rate, Channels, Preprocess);
+
+			// pieces are cut in the pauses between speech spans, only a span longer than a piece is cut inside speech
+			const TArray<FAudioSpeechSpan> Spans = FOpenAIAudioUtils::DetectSpeech(PCM, Rate, Channels, Settings.voiceActivity);
+			const float MaxSeconds = FMath::Max(Settings.maxSegmentSeconds, 1.0f);
+			for (const FAudioSpeechSpan& Span : Spans)
+			{
+				if (NewPieces.Num() > 0 && Span.endTime - NewPieces.Last().StartTime <= MaxSeconds)
+				{
+					NewPieces.Last().EndTime = Span.endTime;
+					continue;
+				}
+
+				for (float Start = Span.startTime; Start < Span.endTime; Start += MaxSeconds)
+				{
+					FPiece& Piece = NewPieces.AddDefaulted_GetRef();
+					Piece.StartTime = Start;
+					Piece.EndTime = FMath::Min(Start + MaxSeconds, Span.endTime);
+				}
+			}
+
+			ParallelFor(NewPieces.Num(), [&](int32 i)
+			{
+				const int32 First = FMath::RoundToInt(NewPieces[i].StartTime * Rate) * Channels;
+				const int32 Last = FMath::Min(FMath::RoundToInt(NewPieces[i].EndTime * Rate) * Channels, PCM.Num());
+				NewPieces[i].Wav = FOpenAIAudioUtils::EncodeWav(TArrayView<const float>(PCM.GetData() + First, FMath::Max(Last - First, 0)), Channels, Rate);
+			});
+
+			UE_LOG(LogTemp, Log, TEXT("UOpenAITranscribeLongAudio %.0fs of audio, %d speech spans in %d pieces"), (float)PCM.Num() / Channels / Rate, Spans.Num(), NewPieces.Num());
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Error, NewPieces = MoveTemp(NewPieces)]() mutable
+		{
+			UOpenAITranscribeLongAudio* Job = WeakThis.Get();
+			if (!Job)
+			{
+				return;
+			}
+
+			if (!Error.IsEmpty())
+			{
+				Job->bFinished = true;
+				Job->Finished.Broadcast({}, {}, Error, false);
+				Job->RemoveFromRoot();
+				Job->SetReadyToDestroy();
+				return;
+			}
+			Job->OnSplit(MoveTemp(NewPieces));
+		});
+	});
+}
+
+void UOpenAITranscribeLongAudio::OnSplit(TArray<FPiece>&& InPieces)
+{
+	Pieces = MoveTemp(InPieces);
+	NumPiecesExpected = Pieces.Num();
+
+	if (NumPiecesExpected == 0 || bCancelled)
+	{
+		Finish();
+		return;
+	}
+
+	RequestQueue = FOpenAIRequestQueue::Create(Settings.maxConcurrentRequests, Settings.requestsPerMinute);
+
+	TWeakObjectPtr<UOpenAITranscribeLongAudio> WeakThis(this);
+	for (int32 PieceIndex = 0; PieceIndex < Pieces.Num(); PieceIndex++)
+	{
+		RequestQueue->Enqueue([WeakThis, PieceIndex](FOpenAIRequestQueue::FOnRequestDone Done)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->SendPiece(PieceIndex, 0, Done);
+			}
+			else
+			{
+				Done();
+			}
+		});
+	}
+}
+
+void UOpenAITranscribeLongAudio::SendPiece(int32 PieceIndex, int32 Attempt, TFunction<void()> Done)
+{
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL("https://api.openai.com/v1/audio/transcriptions");
+	HttpRequest->SetVerb("POST");
+	HttpRequest->SetHeader("Authorization", TEXT("Bearer ") + ApiKey);
+
+	// verbose_json returns timestamped segments that are shifted to the piece's position in the recording
+	FOpenAIMultipartForm Form;
+	Form.AddFileData(TEXT("file"), FString::Printf(TEXT("piece%d.wav"), PieceIndex), TEXT("audio/wav"), CopyTemp(Pieces[PieceIndex].Wav));
+	Form.AddField(TEXT("model"), TEXT("whisper-1"));
+	Form.AddField(TEXT("response_format"), TEXT("verbose_json"));
+	Form.ApplyTo(*HttpRequest);
+
+	TWeakObjectPtr<UOpenAITranscribeLongAudio> WeakThis(this);
+	HttpRequest->OnProcessRequestComplete().BindLambda([WeakThis, PieceIndex, Attempt, Done](FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->OnPieceResponse(PieceIndex, Attempt, Done, Response, WasSuccessful);
+		}
+		else
+		{
+			Done();
+		}
+	});
+	HttpRequest->ProcessRequest();
+}
+
+void UOpenAITranscribeLongAudio::OnPieceResponse(int32 PieceIndex, int32 Attempt, TFunction<void()> Done, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	if (bFinished)
+	{
+		Done();
+		return;
+	}
+
+	FPiece& Piece = Pieces[PieceIndex];
+	const int32 ResponseCode = Response.IsValid() ? Response->GetResponseCode() : 0;
+
+	FString Error;
+	if (WasSuccessful && Response.IsValid() && EHttpResponseCodes::IsOk(ResponseCode))
+	{
+		TSharedPtr<FJsonObject> JsonObject;
+		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
+		FString Text;
+		if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid() && JsonObject->TryGetStringField(TEXT("text"), Text))
+		{
+			const TArray<TSharedPtr<FJsonValue>>* JsonSegments = nullptr;
+			if (JsonObject->TryGetArrayField(TEXT("segments"), JsonSegments))
+			{
+				for (const TSharedPtr<FJsonValue>& Value : *JsonSegments)
+				{
+					const TSharedPtr<FJsonObject>* SegmentObject = nullptr;
+					if (Value->TryGetObject(SegmentObject))
+					{
+						FTranscriptionSegment& Segment = Piece.Segments.AddDefaulted_GetRef();
+						Segment.text = (*SegmentObject)->GetStringField(TEXT("text")).TrimStartAndEnd();
+						Segment.startTime = Piece.StartTime + (float)(*SegmentObject)->GetNumberField(TEXT("start"));
+						Segment.endTime = FMath::Min(Piece.StartTime + (float)(*SegmentObject)->GetNumberField(TEXT("end")), Piece.EndTime);
+					}
+				}
+			}
+			if (Piece.Segments.Num() == 0 && !Text.TrimStartAndEnd().IsEmpty())
+			{
+				FTranscriptionSegment& Segment = Piece.Segments.AddDefaulted_GetRef();
+				Segment.text = Text.TrimStartAndEnd();
+				Segment.startTime = Piece.StartTime;
+				Segment.endTime = Piece.EndTime;
+			}
+
+			Piece.Wav.Empty();
+			NumPiecesDone++;
+
+			FTranscriptionSegment PieceSegment;
+			PieceSegment.text = Text.TrimStartAndEnd();
+			PieceSegment.startTime = Piece.StartTime;
+			PieceSegment.endTime = Piece.EndTime;
+			Progress.Broadcast(PieceSegment, NumPiecesDone, Pieces.Num());
+
+			Done();
+			OnPieceDone();
+			return;
+		}
+		Error = TEXT("Failed to parse JSON response");
+	}
+	else
+	{
+		Error = Response.IsValid() ? Response->GetContentAsString() : TEXT("Request failed");
+	}
+
+	// rate limits and server errors are worth another try, other client errors will fail the same way again
+	const bool bRetriable = ResponseCode == 0 || ResponseCode == 429 || ResponseCode >= 500;
+	if (bRetriable && Attempt + 1 < Settings.maxRetries && !bCancelled)
+	{
+		const float Delay = FMath::Pow(2.0f, (float)Attempt);
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAITranscribeLongAudio piece %d failed, retrying in %.0fs: %s"), PieceIndex, Delay, *Error);
+		TWeakObjectPtr<UOpenAITranscribeLongAudio> WeakThis(this);
+		FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis, PieceIndex, Attempt, Done](float)
+		{
+			if (!WeakThis.IsValid())
+			{
+				Done();
+			}
+			else if (WeakThis->bCancelled)
+			{
+				// Cancel counted this piece as active, it reports back without resending
+				WeakThis->NumPiecesDone++;
+				Done();
+				WeakThis->OnPieceDone();
+			}
+			else
+			{
+				WeakThis->SendPiece(PieceIndex, Attempt + 1, Done);
+			}
+			return false;
+		}), Delay);
+		return;
+	}
+
+	NumPiecesFailed++;
+	NumPiecesDone++;
+	LastError = Error;
+	Done();
+	OnPieceDone();
+}
+
+void UOpenAITranscribeLongAudio::OnPieceDone()
+{
+	if (NumPiecesDone >= NumPiecesExpected)
+	{
+		Finish();
+	}
+}
+
+void UOpenAITranscribeLongAudio::Cancel()
+{
+	bCancelled = true;
+	if (RequestQueue.IsValid())
+	{
+		// pieces that never started won't report back
+		NumPiecesExpected = NumPiecesDone + RequestQueue->NumActive();
+		RequestQueue->CancelPending();
+		OnPieceDone();
+	}
+}
+
+void UOpenAITranscribeLongAudio::Finish()
+{
+	if (bFinished)
+	{
+		return;
+	}
+	bFinished = true;
+
+	// stitched in recording order, whatever order the pieces came back in
+	TArray<FTranscriptionSegment> Segments;
+	TArray<FString> Texts;
+	for (const FPiece& Piece : Pieces)
+	{
+		for (const FTranscriptionSegment& Segment : Piece.Segments)
+		{
+			Segments.Add(Segment);
+			Texts.Add(Segment.text);
+		}
+	}
+	const FString Transcription = FString::Join(Texts, TEXT(" "));
+
+	if (bCancelled)
+	{
+		Finished.Broadcast(Transcription, Segments, TEXT("Transcription cancelled"), false);
+	}
+	else if (NumPiecesFailed > 0)
+	{
+		Finished.Broadcast(Transcription, Segments, FString::Printf(TEXT("%d pieces failed: %s"), NumPiecesFailed, *LastError), false);
+	}
+	else
+	{
+		Finished.Broadcast(Transcription, Segments, TEXT(""), true);
+	}
+
+	RequestQueue.Reset();
+	Pieces.Empty();
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
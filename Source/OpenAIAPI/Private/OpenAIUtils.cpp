@@ -3,36 +3,57 @@
 
 #include "OpenAIUtils.h"
 #include "OpenAIDefinitions.h"
+#include "OpenAIVectorMath.h"
+#include "OpenAIVectorQuantization.h"
 #include "OpenAIAPI.h"
 #include "Modules/ModuleManager.h"
 
+namespace
+{
+	// blueprint input, a mismatch is reported instead of asserted and the caller scores 0
+	bool HaveSameDimension(const FHighDimensionalVector& A, const FHighDimensionalVector& B, const TCHAR* Caller)
+	{
+		if (A.Components.Num() == B.Components.Num())
+		{
+			return true;
+		}
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAIUtils::%s vectors of %d and %d dimensions"), Caller, A.Components.Num(), B.Components.Num());
+		return false;
+	}
+}
+
 void UOpenAIUtils::SetOpenAIApiKey(FString apiKey)
 {
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FScopeLock Lock(&mod.SettingsLock);
 	mod._apiKey = apiKey;
 }
 
 void UOpenAIUtils::SetOpenAIAPIEndpoint(FString Url)
 {
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FScopeLock Lock(&mod.SettingsLock);
 	mod.ApiUrl = Url;
 }
 
 FString UOpenAIUtils::GetApiKey()
 {
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FScopeLock Lock(&mod.SettingsLock);
 	return mod._apiKey;
 }
 
 FString UOpenAIUtils::GetApiURL()
 {
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FScopeLock Lock(&mod.SettingsLock);
 	return mod.ApiUrl;
 }
 
 void UOpenAIUtils::	SetUseOpenAIApiKeyFromEnvironmentVars(bool bUseEnvVariable)
 {
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FScopeLock Lock(&mod.SettingsLock);
 	mod._useApiKeyFromEnvVariable = bUseEnvVariable;
 }
 
@@ -40,6 +61,7 @@ bool UOpenAIUtils::GetUseApiKeyFromEnvironmentVars()
 {
 
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FScopeLock Lock(&mod.SettingsLock);
 	return mod._useApiKeyFromEnvVariable;
 }
 
@@ -61,26 +83,16 @@ FString UOpenAIUtils::GetEnvironmentVariable(FString key)
 
 float UOpenAIUtils::HDVectorDotProductSIMD(const FHighDimensionalVector& A, const FHighDimensionalVector& B)
 {
-#if PLATFORM_WINDOWS
-	check(A.Components.Num() == B.Components.Num());
-	// To utilize SIMD acceleration, the dimensionality of high-dimensional vectors needs to be a multiple of 4.
-	check(A.Components.Num() % 4 == 0);
-
-	__m128 Sum = _mm_setzero_ps();
-	for (int32 i = 0; i < A.Components.Num(); i += 4)
+	if (!HaveSameDimension(A, B, TEXT("HDVectorDotProductSIMD")))
 	{
-		__m128 AVec = _mm_loadu_ps(&A.Components[i]);
-		__m128 BVec = _mm_loadu_ps(&B.Components[i]);
-		__m128 Mul = _mm_mul_ps(AVec, BVec);
-		Sum = _mm_add_ps(Sum, Mul);
+		return 0.0f;
 	}
+	return FOpenAIVectorMath::DotProduct(A.Components.GetData(), B.Components.GetData(), A.Components.Num());
+}
 
-	float Result[4];
-	_mm_storeu_ps(Result, Sum);
-	return Result[0] + Result[1] + Result[2] + Result[3];
-#else
-	return 0.f;
-#endif
+FString UOpenAIUtils::GetHDVectorSIMDKernelName()
+{
+	return FOpenAIVectorMath::GetKernelName();
 }
 
 float UOpenAIUtils::HDVectorLengthSIMD(const FHighDimensionalVector& Vector)
@@ -90,14 +102,19 @@ float UOpenAIUtils::HDVectorLengthSIMD(const FHighDimensionalVector& Vector)
 
 float UOpenAIUtils::HDVectorCosineSimilaritySIMD(const FHighDimensionalVector& A, const FHighDimensionalVector& B)
 {
-	float DotProductValue = HDVectorDotProductSIMD(A, B);
-	float LengthProduct = HDVectorLengthSIMD(A) * HDVectorLengthSIMD(B);
-	return DotProductValue / LengthProduct;
+	if (!HaveSameDimension(A, B, TEXT("HDVectorCosineSimilaritySIMD")))
+	{
+		return 0.0f;
+	}
+	return FOpenAIVectorMath::CosineSimilarity(A.Components.GetData(), B.Components.GetData(), A.Components.Num());
 }
 
 float UOpenAIUtils::HDVectorDotProduct(const FHighDimensionalVector& A, const FHighDimensionalVector& B)
 {
-	check(A.Components.Num() == B.Components.Num());
+	if (!HaveSameDimension(A, B, TEXT("HDVectorDotProduct")))
+	{
+		return 0.0f;
+	}
         
 	float Sum = 0.0f;
 	for (int32 i = 0; i < A.Components.Num(); i++)
@@ -114,7 +131,179 @@ float UOpenAIUtils::HDVectorLength(const FHighDimensionalVector& Vector)
 
 float UOpenAIUtils::HDVectorCosineSimilarity(const FHighDimensionalVector& A, const FHighDimensionalVector& B)
 {
-	float DotProductValue = HDVectorDotProduct(A, B);
-	float LengthProduct = HDVectorLength(A) * HDVectorLength(B);
+	if (!HaveSameDimension(A, B, TEXT("HDVectorCosineSimilarity")))
+	{
+		return 0.0f;
+	}
+
+	// single pass over both vectors instead of one per dot product
+	float DotProductValue = 0.0f;
+	float SquaredLengthA = 0.0f;
+	float SquaredLengthB = 0.0f;
+	for (int32 i = 0; i < A.Components.Num(); i++)
+	{
+		DotProductValue += A.Components[i] * B.Components[i];
+		SquaredLengthA += A.Components[i] * A.Components[i];
+		SquaredLengthB += B.Components[i] * B.Components[i];
+	}
+	float LengthProduct = FMath::Sqrt(SquaredLengthA * SquaredLengthB);
+	// a zero vector has no direction, 0 rather than NaN
+	return LengthProduct > 0.0f ? DotProductValue / LengthProduct : 0.0f;
+}
+
+FHighDimensionalVector UOpenAIUtils::HDVectorNormalize(const FHighDimensionalVector& Vector)
+{
+	FHighDimensionalVector Out(Vector.Components);
+	FOpenAIVectorMath::Normalize(Out.Components.GetData(), Out.Components.Num());
+	return Out;
+}
+
+float UOpenAIUtils::HDVectorCosineSimilarityNormalized(const FHighDimensionalVector& A, const FHighDimensionalVector& B)
+{
+	return HDVectorDotProductSIMD(A, B);
+}
+
+FHighDimensionalVectorMatrix UOpenAIUtils::MakeHDVectorMatrix(const TArray<FHighDimensionalVector>& Vectors)
+{
+	FHighDimensionalVectorMatrix Matrix;
+	if (Vectors.Num() > 0)
+	{
+		Matrix.Components.Reserve(Vectors.Num() * Vectors[0].Components.Num());
+	}
+	for (const FHighDimensionalVector& Vector : Vectors)
+	{
+		if (!Matrix.AddRow(Vector))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UOpenAIUtils::MakeHDVectorMatrix skipped a %d dimensional vector in a %d dimensional matrix"), Vector.Components.Num(), Matrix.Dimension);
+		}
+	}
+	return Matrix;
+}
+
+TArray<float> UOpenAIUtils::HDVectorCosineSimilarityBatch(const FHighDimensionalVector& Query, const TArray<FHighDimensionalVector>& Vectors, bool bNormalized)
+{
+	TArray<const float*> Rows;
+	TArray<int32> RowIndices;
+	Rows.Reserve(Vectors.Num());
+	RowIndices.Reserve(Vectors.Num());
+	for (int32 i = 0; i < Vectors.Num(); i++)
+	{
+		if (Vectors[i].Components.Num() == Query.Components.Num())
+		{
+			Rows.Add(Vectors[i].Components.GetData());
+			RowIndices.Add(i);
+		}
+	}
+	if (Rows.Num() < Vectors.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAIUtils::HDVectorCosineSimilarityBatch skipped %d vectors that don't match the %d dimensional query"), Vectors.Num() - Rows.Num(), Query.Components.Num());
+	}
+
+	TArray<float> RowScores;
+	RowScores.SetNumUninitialized(Rows.Num());
+	FOpenAIVectorMath::CosineSimilarityBatch(Query.Components.GetData(), Rows, Query.Components.Num(), bNormalized, RowScores.GetData());
+
+	// skipped vectors keep a score of 0 so the output still lines up with the input
+	TArray<float> Scores;
+	Scores.SetNumZeroed(Vectors.Num());
+	for (int32 Row = 0; Row < Rows.Num(); Row++)
+	{
+		Scores[RowIndices[Row]] = RowScores[Row];
+	}
+	return Scores;
+}
+
+TArray<float> UOpenAIUtils::HDVectorMatrixCosineSimilarityBatch(const FHighDimensionalVector& Query, const FHighDimensionalVectorMatrix& Matrix, bool bNormalized)
+{
+	TArray<float> Scores;
+	if (Matrix.NumRows() == 0)
+	{
+		return Scores;
+	}
+	if (Matrix.Dimension != Query.Components.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAIUtils::HDVectorMatrixCosineSimilarityBatch skipped a %d dimensional matrix for a %d dimensional query"), Matrix.Dimension, Query.Components.Num());
+		return Scores;
+	}
+
+	Scores.SetNumUninitialized(Matrix.NumRows());
+	FOpenAIVectorMath::CosineSimilarityBatch(Query.Components.GetData(), Matrix.Components.GetData(), Matrix.NumRows(), Matrix.Dimension, bNormalized, Scores.GetData());
+	return Scores;
+}
+
+TArray<FHDVectorSearchResult> UOpenAIUtils::HDVectorRankBySimilarity(const FHighDimensionalVector& Query, const TArray<FHighDimensionalVector>& Vectors, int32 TopK, bool bNormalized)
+{
+	TArray<float> Scores = HDVectorCosineSimilarityBatch(Query, Vectors, bNormalized);
+	for (int32 i = 0; i < Vectors.Num(); i++)
+	{
+		if (Vectors[i].Components.Num() != Query.Components.Num())
+		{
+			Scores[i] = -TNumericLimits<float>::Max();
+		}
+	}
+
+	// skipped vectors rank last, they only make it into the top K when there are too few others and are dropped there
+	TArray<FHDVectorSearchResult> Results = FOpenAIVectorMath::SelectTopK(Scores, TopK);
+	Results.RemoveAll([&Vectors, &Query](const FHDVectorSearchResult& Result)
+	{
+		return Vectors[Result.Index].Components.Num() != Query.Components.Num();
+	});
+	return Results;
+}
+
+TArray<FHDVectorSearchResult> UOpenAIUtils::HDVectorMatrixRankBySimilarity(const FHighDimensionalVector& Query, const FHighDimensionalVectorMatrix& Matrix, int32 TopK, bool bNormalized)
+{
+	return FOpenAIVectorMath::SelectTopK(HDVectorMatrixCosineSimilarityBatch(Query, Matrix, bNormalized), TopK);
+}
+
+FQuantizedHighDimensionalVector UOpenAIUtils::QuantizeHDVector(const FHighDimensionalVector& Vector, EOAVectorQuantization Format)
+{
+	switch (Format)
+	{
+	case EOAVectorQuantization::FP16:
+		return FOpenAIVectorQuantization::QuantizeFP16(Vector);
+	case EOAVectorQuantization::INT8:
+		return FOpenAIVectorQuantization::QuantizeInt8(Vector);
+	default:
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAIUtils::QuantizeHDVector product quantization needs a quantizer, use QuantizeHDVectorProduct"));
+		return {};
+	}
+}
+
+FQuantizedHighDimensionalVector UOpenAIUtils::QuantizeHDVectorProduct(const FHighDimensionalVector& Vector, const FProductQuantizer& Quantizer)
+{
+	return FOpenAIVectorQuantization::QuantizeProduct(Vector, Quantizer);
+}
+
+FHighDimensionalVector UOpenAIUtils::DequantizeHDVector(const FQuantizedHighDimensionalVector& Quantized, const FProductQuantizer& Quantizer)
+{
+	return FOpenAIVectorQuantization::Dequantize(Quantized, &Quantizer);
+}
+
+FProductQuantizer UOpenAIUtils::TrainProductQuantizer(const TArray<FHighDimensionalVector>& Samples, int32 NumSubspaces, int32 NumCentroids, int32 Iterations)
+{
+	return FOpenAIVectorQuantization::TrainProductQuantizer(Samples, NumSubspaces, NumCentroids, Iterations);
+}
+
+float UOpenAIUtils::HDVectorDotProductQuantized(const FHighDimensionalVector& Query, const FQuantizedHighDimensionalVector& Quantized)
+{
+	if (Query.Components.Num() != Quantized.Dimension)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAIUtils::HDVectorDotProductQuantized a %d dimensional query can't be scored against a %d dimensional vector"), Query.Components.Num(), Quantized.Dimension);
+		return 0.0f;
+	}
+	return FOpenAIVectorQuantization::DotProduct(Query.Components.GetData(), Quantized);
+}
+
+float UOpenAIUtils::HDVectorCosineSimilarityQuantized(const FHighDimensionalVector& Query, const FQuantizedHighDimensionalVector& Quantized)
+{
+	float DotProductValue = HDVectorDotProductQuantized(Query, Quantized);
+	float LengthProduct = HDVectorLength(Query) * Quantized.Length;
 	return DotProductValue / LengthProduct;
 }
+
+TArray<FHDVectorSearchResult> UOpenAIUtils::HDVectorSearchQuantized(const FHighDimensionalVector& Query, const TArray<FQuantizedHighDimensionalVector>& Candidates,
+	const TArray<FHighDimensionalVector>& FullVectors, const FProductQuantizer& Quantizer, int32 TopK, int32 ShortlistSize)
+{
+	return FOpenAIVectorQuantization::Search(Query, Candidates, FullVectors, &Quantizer, TopK, ShortlistSize);
+}
@@ -0,0 +1,178 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIVectorIndex.h"
+#include "OpenAIVectorMath.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+
+UOpenAIVectorIndex* UOpenAIVectorIndex::OpenVectorIndex(const FString& Path, int32 Dimension)
+{
+	const FString FullPath = FPaths::IsRelative(Path) ? FPaths::Combine(FPaths::ProjectSavedDir(), Path) : Path;
+
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store = FOpenAIVectorStore::Open(FullPath, Dimension);
+	if (!Store.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UOpenAIVectorIndex::OpenVectorIndex could not open %s"), *FullPath);
+		return nullptr;
+	}
+
+	UOpenAIVectorIndex* Index = NewObject<UOpenAIVectorIndex>();
+	Index->Store = Store;
+	Index->StartLexicalSync();
+	return Index;
+}
+
+UOpenAIVectorIndex* UOpenAIVectorIndex::CreateInMemoryVectorIndex(int32 Dimension)
+{
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store = FOpenAIVectorStore::CreateInMemory(Dimension);
+	if (!Store.IsValid())
+	{
+		return nullptr;
+	}
+
+	UOpenAIVectorIndex* Index = NewObject<UOpenAIVectorIndex>();
+	Index->Store = Store;
+	return Index;
+}
+
+bool UOpenAIVectorIndex::AddEntry(const FString& Id, const FString& Text, const FHighDimensionalVector& Vector)
+{
+	return Store.IsValid() && Store->Add(Id, Vector, Text);
+}
+
+bool UOpenAIVectorIndex::Contains(const FString& Id) const
+{
+	return Store.IsValid() && Store->Contains(Id);
+}
+
+int32 UOpenAIVectorIndex::Num() const
+{
+	return Store.IsValid() ? Store->Num() : 0;
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::Search(const FHighDimensionalVector& Query, int32 TopK) const
+{
+	return Store.IsValid() ? SearchStore(*Store, Query, TopK) : TArray<FVectorIndexMatch>();
+}
+
+void UOpenAIVectorIndex::Flush()
+{
+	if (Store.IsValid())
+	{
+		Store->Flush();
+		StartLexicalSync();
+	}
+}
+
+void UOpenAIVectorIndex::Compact()
+{
+	if (Store.IsValid())
+	{
+		Store->CompactAsync();
+	}
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::SearchTwoStage(const FHighDimensionalVector& Query, const FTwoStageSearchSettings& Settings) const
+{
+	return Store.IsValid() ? ResolveMatches(*Store, Store->SearchTwoStage(Query, Settings)) : TArray<FVectorIndexMatch>();
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::SearchLexical(const FString& QueryText, int32 TopK) const
+{
+	if (!Store.IsValid())
+	{
+		return {};
+	}
+	StartLexicalSync();
+	return ResolveMatches(*Store, LexicalIndex->Search(QueryText, TopK));
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::SearchHybrid(const FString& QueryText, const FHighDimensionalVector& QueryVector, const FHybridSearchSettings& Settings) const
+{
+	if (!Store.IsValid())
+	{
+		return {};
+	}
+	StartLexicalSync();
+	return SearchHybridIndexed(*Store, *LexicalIndex, QueryText, QueryVector, Settings);
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::SearchStore(const FOpenAIVectorStore& Store, const FHighDimensionalVector& Query, int32 TopK)
+{
+	return ResolveMatches(Store, Store.Search(Query, TopK));
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::SearchStoreHybrid(const FOpenAIVectorStore& Store, FOpenAIBM25Index& LexicalIndex, const FString& QueryText, const FHighDimensionalVector& QueryVector, const FHybridSearchSettings& Settings)
+{
+	SyncLexicalIndex(Store, LexicalIndex);
+	return SearchHybridIndexed(Store, LexicalIndex, QueryText, QueryVector, Settings);
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::SearchHybridIndexed(const FOpenAIVectorStore& Store, const FOpenAIBM25Index& LexicalIndex, const FString& QueryText, const FHighDimensionalVector& QueryVector, const FHybridSearchSettings& Settings)
+{
+	const int32 NumLexical = Settings.lexicalPrefilter ? FMath::Max(Settings.prefilterCandidates, Settings.candidatesPerRanking) : Settings.candidatesPerRanking;
+	TArray<FHDVectorSearchResult> LexicalResults = LexicalIndex.Search(QueryText, NumLexical);
+
+	TArray<FHDVectorSearchResult> VectorResults;
+	if (Settings.lexicalPrefilter && LexicalResults.Num() > 0)
+	{
+		// only the entries sharing a term with the query are scored against the query vector
+		TArray<int32> Candidates;
+		Candidates.Reserve(LexicalResults.Num());
+		for (const FHDVectorSearchResult& Result : LexicalResults)
+		{
+			Candidates.Add(Result.Index);
+		}
+		VectorResults = Store.Search(QueryVector, Candidates, Settings.candidatesPerRanking);
+	}
+	else
+	{
+		VectorResults = Store.Search(QueryVector, Settings.candidatesPerRanking);
+	}
+
+	if (LexicalResults.Num() > Settings.candidatesPerRanking)
+	{
+		LexicalResults.SetNum(Settings.candidatesPerRanking);
+	}
+
+	const TArray<FHDVectorSearchResult> Rankings[] = { LexicalResults, VectorResults };
+	const float Weights[] = { Settings.lexicalWeight, Settings.vectorWeight };
+	return ResolveMatches(Store, FOpenAIVectorMath::FuseReciprocalRank(Rankings, Weights, Settings.topK, Settings.rankConstant));
+}
+
+void UOpenAIVectorIndex::StartLexicalSync() const
+{
+	// tokenizing every entry of a large store takes a while, searches on the game thread use what is indexed so far
+	if (!Store.IsValid() || LexicalIndex->Num() >= Store->Num() || (LexicalSync.IsValid() && !LexicalSync.IsReady()))
+	{
+		return;
+	}
+
+	LexicalSync = Async(EAsyncExecution::ThreadPool, [StoreToMirror = Store, Index = LexicalIndex]()
+	{
+		SyncLexicalIndex(*StoreToMirror, *Index);
+	});
+}
+
+void UOpenAIVectorIndex::SyncLexicalIndex(const FOpenAIVectorStore& Store, FOpenAIBM25Index& LexicalIndex)
+{
+	// entries can come from AddEntry, an ingestion job or the log replayed on open, so mirror the store itself
+	const int32 NumEntries = Store.Num();
+	for (int32 Entry = LexicalIndex.Num(); Entry < NumEntries; Entry++)
+	{
+		LexicalIndex.AddDocument(Entry, Store.GetMetadata(Entry));
+	}
+}
+
+TArray<FVectorIndexMatch> UOpenAIVectorIndex::ResolveMatches(const FOpenAIVectorStore& Store, const TArray<FHDVectorSearchResult>& Results)
+{
+	TArray<FVectorIndexMatch> Matches;
+	for (const FHDVectorSearchResult& Result : Results)
+	{
+		FVectorIndexMatch& Match = Matches.AddDefaulted_GetRef();
+		Match.Id = Store.GetId(Result.Index);
+		Match.Text = Store.GetMetadata(Result.Index);
+		Match.Score = Result.Score;
+	}
+	return Matches;
+}
@@ -0,0 +1,705 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIVectorMath.h"
+#include "Math/RandomStream.h"
+#include "Async/ParallelFor.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+	#if defined(__clang__) || defined(__GNUC__)
+		#define OPENAI_TARGET(Features) __attribute__((target(Features)))
+	#else
+		#define OPENAI_TARGET(Features)
+	#endif
+	#define OPENAI_VECTOR_X86 1
+#elif PLATFORM_CPU_ARM_FAMILY && (defined(__aarch64__) || defined(_M_ARM64))
+	#include <arm_neon.h>
+	#define OPENAI_VECTOR_NEON 1
+#endif
+
+#ifndef OPENAI_VECTOR_X86
+	#define OPENAI_VECTOR_X86 0
+#endif
+#ifndef OPENAI_VECTOR_NEON
+	#define OPENAI_VECTOR_NEON 0
+#endif
+
+namespace
+{
+	typedef float (*FDotProductKernel)(const float*, const float*, int32);
+	typedef void (*FDotProductAndNormsKernel)(const float*, const float*, int32, float&, float&, float&);
+
+	struct FVectorKernel
+	{
+		const TCHAR* Name;
+		FDotProductKernel DotProduct;
+		FDotProductAndNormsKernel DotProductAndNorms;
+	};
+
+	// below this many floats a batch isn't worth handing to the task graph
+	constexpr int32 ParallelBatchThreshold = 1 << 16;
+
+	float DotProductScalarKernel(const float* A, const float* B, int32 Num)
+	{
+		float Sum = 0.0f;
+		for (int32 i = 0; i < Num; i++)
+		{
+			Sum += A[i] * B[i];
+		}
+		return Sum;
+	}
+
+	void DotProductAndNormsScalarKernel(const float* A, const float* B, int32 Num, float& OutAB, float& OutAA, float& OutBB)
+	{
+		float AB = 0.0f;
+		float AA = 0.0f;
+		float BB = 0.0f;
+		for (int32 i = 0; i < Num; i++)
+		{
+			AB += A[i] * B[i];
+			AA += A[i] * A[i];
+			BB += B[i] * B[i];
+		}
+		OutAB = AB;
+		OutAA = AA;
+		OutBB = BB;
+	}
+
+#if OPENAI_VECTOR_X86
+	float HorizontalSum(__m128 Sum)
+	{
+		Sum = _mm_add_ps(Sum, _mm_movehl_ps(Sum, Sum));
+		Sum = _mm_add_ss(Sum, _mm_shuffle_ps(Sum, Sum, 1));
+		return _mm_cvtss_f32(Sum);
+	}
+
+	OPENAI_TARGET("avx2,fma")
+	float HorizontalSum256(__m256 Sum)
+	{
+		return HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(Sum), _mm256_extractf128_ps(Sum, 1)));
+	}
+
+	// Four independent accumulators hide the add latency, loads are unaligned so any TArray works.
+	float DotProductSSE(const float* A, const float* B, int32 Num)
+	{
+		__m128 Sum0 = _mm_setzero_ps();
+		__m128 Sum1 = _mm_setzero_ps();
+		__m128 Sum2 = _mm_setzero_ps();
+		__m128 Sum3 = _mm_setzero_ps();
+
+		int32 i = 0;
+		for (; i + 16 <= Num; i += 16)
+		{
+			Sum0 = _mm_add_ps(Sum0, _mm_mul_ps(_mm_loadu_ps(A + i), _mm_loadu_ps(B + i)));
+			Sum1 = _mm_add_ps(Sum1, _mm_mul_ps(_mm_loadu_ps(A + i + 4), _mm_loadu_ps(B + i + 4)));
+			Sum2 = _mm_add_ps(Sum2, _mm_mul_ps(_mm_loadu_ps(A + i + 8), _mm_loadu_ps(B + i + 8)));
+			Sum3 = _mm_add_ps(Sum3, _mm_mul_ps(_mm_loadu_ps(A + i + 12), _mm_loadu_ps(B + i + 12)));
+		}
+		for (; i + 4 <= Num; i += 4)
+		{
+			Sum0 = _mm_add_ps(Sum0, _mm_mul_ps(_mm_loadu_ps(A + i), _mm_loadu_ps(B + i)));
+		}
+
+		float Result = HorizontalSum(_mm_add_ps(_mm_add_ps(Sum0, Sum1), _mm_add_ps(Sum2, Sum3)));
+
+		for (; i < Num; i++)
+		{
+			Result += A[i] * B[i];
+		}
+		return Result;
+	}
+
+	OPENAI_TARGET("avx2,fma")
+	float DotProductAVX2(const float* A, const float* B, int32 Num)
+	{
+		__m256 Sum0 = _mm256_setzero_ps();
+		__m256 Sum1 = _mm256_setzero_ps();
+		__m256 Sum2 = _mm256_setzero_ps();
+		__m256 Sum3 = _mm256_setzero_ps();
+
+		int32 i = 0;
+		for (; i + 32 <= Num; i += 32)
+		{
+			Sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i), Sum0);
+			Sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i + 8), _mm256_loadu_ps(B + i + 8), Sum1);
+			Sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i + 16), _mm256_loadu_ps(B + i + 16), Sum2);
+			Sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i + 24), _mm256_loadu_ps(B + i + 24), Sum3);
+		}
+		for (; i + 8 <= Num; i += 8)
+		{
+			Sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i), Sum0);
+		}
+
+		float Result = HorizontalSum256(_mm256_add_ps(_mm256_add_ps(Sum0, Sum1), _mm256_add_ps(Sum2, Sum3)));
+
+		for (; i < Num; i++)
+		{
+			Result += A[i] * B[i];
+		}
+		return Result;
+	}
+
+	OPENAI_TARGET("avx512f")
+	float DotProductAVX512(const float* A, const float* B, int32 Num)
+	{
+		__m512 Sum0 = _mm512_setzero_ps();
+		__m512 Sum1 = _mm512_setzero_ps();
+		__m512 Sum2 = _mm512_setzero_ps();
+		__m512 Sum3 = _mm512_setzero_ps();
+
+		int32 i = 0;
+		for (; i + 64 <= Num; i += 64)
+		{
+			Sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i), _mm512_loadu_ps(B + i), Sum0);
+			Sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i + 16), _mm512_loadu_ps(B + i + 16), Sum1);
+			Sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i + 32), _mm512_loadu_ps(B + i + 32), Sum2);
+			Sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i + 48), _mm512_loadu_ps(B + i + 48), Sum3);
+		}
+		for (; i + 16 <= Num; i += 16)
+		{
+			Sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(A + i), _mm512_loadu_ps(B + i), Sum0);
+		}
+
+		// masked loads cover the last 1-15 components without reading past the arrays
+		if (i < Num)
+		{
+			const __mmask16 Mask = (__mmask16)((1u << (Num - i)) - 1u);
+			Sum1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(Mask, A + i), _mm512_maskz_loadu_ps(Mask, B + i), Sum1);
+		}
+
+		return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(Sum0, Sum1), _mm512_add_ps(Sum2, Sum3)));
+	}
+
+	// Fused kernels: both arrays are streamed once and three accumulator sets are kept, two deep each.
+	void DotProductAndNormsSSE(const float* A, const float* B, int32 Num, float& OutAB, float& OutAA, float& OutBB)
+	{
+		__m128 AB0 = _mm_setzero_ps(), AB1 = _mm_setzero_ps();
+		__m128 AA0 = _mm_setzero_ps(), AA1 = _mm_setzero_ps();
+		__m128 BB0 = _mm_setzero_ps(), BB1 = _mm_setzero_ps();
+
+		int32 i = 0;
+		for (; i + 8 <= Num; i += 8)
+		{
+			const __m128 A0 = _mm_loadu_ps(A + i);
+			const __m128 B0 = _mm_loadu_ps(B + i);
+			const __m128 A1 = _mm_loadu_ps(A + i + 4);
+			const __m128 B1 = _mm_loadu_ps(B + i + 4);
+			AB0 = _mm_add_ps(AB0, _mm_mul_ps(A0, B0));
+			AA0 = _mm_add_ps(AA0, _mm_mul_ps(A0, A0));
+			BB0 = _mm_add_ps(BB0, _mm_mul_ps(B0, B0));
+			AB1 = _mm_add_ps(AB1, _mm_mul_ps(A1, B1));
+			AA1 = _mm_add_ps(AA1, _mm_mul_ps(A1, A1));
+			BB1 = _mm_add_ps(BB1, _mm_mul_ps(B1, B1));
+		}
+		for (; i + 4 <= Num; i += 4)
+		{
+			const __m128 A0 = _mm_loadu_ps(A + i);
+			const __m128 B0 = _mm_loadu_ps(B + i);
+			AB0 = _mm_add_ps(AB0, _mm_mul_ps(A0, B0));
+			AA0 = _mm_add_ps(AA0, _mm_mul_ps(A0, A0));
+			BB0 = _mm_add_ps(BB0, _mm_mul_ps(B0, B0));
+		}
+
+		float AB = HorizontalSum(_mm_add_ps(AB0, AB1));
+		float AA = HorizontalSum(_mm_add_ps(AA0, AA1));
+		float BB = HorizontalSum(_mm_add_ps(BB0, BB1));
+		for (; i < Num; i++)
+		{
+			AB += A[i] * B[i];
+			AA += A[i] * A[i];
+			BB += B[i] * B[i];
+		}
+		OutAB = AB;
+		OutAA = AA;
+		OutBB = BB;
+	}
+
+	OPENAI_TARGET("avx2,fma")
+	void DotProductAndNormsAVX2(const float* A, const float* B, int32 Num, float& OutAB, float& OutAA, float& OutBB)
+	{
+		__m256 AB0 = _mm256_setzero_ps(), AB1 = _mm256_setzero_ps();
+		__m256 AA0 = _mm256_setzero_ps(), AA1 = _mm256_setzero_ps();
+		__m256 BB0 = _mm256_setzero_ps(), BB1 = _mm256_setzero_ps();
+
+		int32 i = 0;
+		for (; i + 16 <= Num; i += 16)
+		{
+			const __m256 A0 = _mm256_loadu_ps(A + i);
+			const __m256 B0 = _mm256_loadu_ps(B + i);
+			const __m256 A1 = _mm256_loadu_ps(A + i + 8);
+			const __m256 B1 = _mm256_loadu_ps(B + i + 8);
+			AB0 = _mm256_fmadd_ps(A0, B0, AB0);
+			AA0 = _mm256_fmadd_ps(A0, A0, AA0);
+			BB0 = _mm256_fmadd_ps(B0, B0, BB0);
+			AB1 = _mm256_fmadd_ps(A1, B1, AB1);
+			AA1 = _mm256_fmadd_ps(A1, A1, AA1);
+			BB1 = _mm256_fmadd_ps(B1, B1, BB1);
+		}
+		for (; i + 8 <= Num; i += 8)
+		{
+			const __m256 A0 = _mm256_loadu_ps(A + i);
+			const __m256 B0 = _mm256_loadu_ps(B + i);
+			AB0 = _mm256_fmadd_ps(A0, B0, AB0);
+			AA0 = _mm256_fmadd_ps(A0, A0, AA0);
+			BB0 = _mm256_fmadd_ps(B0, B0, BB0);
+		}
+
+		float AB = HorizontalSum256(_mm256_add_ps(AB0, AB1));
+		float AA = HorizontalSum256(_mm256_add_ps(AA0, AA1));
+		float BB = HorizontalSum256(_mm256_add_ps(BB0, BB1));
+		for (; i < Num; i++)
+		{
+			AB += A[i] * B[i];
+			AA += A[i] * A[i];
+			BB += B[i] * B[i];
+		}
+		OutAB = AB;
+		OutAA = AA;
+		OutBB = BB;
+	}
+
+	OPENAI_TARGET("avx512f")
+	void DotProductAndNormsAVX512(const float* A, const float* B, int32 Num, float& OutAB, float& OutAA, float& OutBB)
+	{
+		__m512 AB0 = _mm512_setzero_ps(), AB1 = _mm512_setzero_ps();
+		__m512 AA0 = _mm512_setzero_ps(), AA1 = _mm512_setzero_ps();
+		__m512 BB0 = _mm512_setzero_ps(), BB1 = _mm512_setzero_ps();
+
+		int32 i = 0;
+		for (; i + 32 <= Num; i += 32)
+		{
+			const __m512 A0 = _mm512_loadu_ps(A + i);
+			const __m512 B0 = _mm512_loadu_ps(B + i);
+			const __m512 A1 = _mm512_loadu_ps(A + i + 16);
+			const __m512 B1 = _mm512_loadu_ps(B + i + 16);
+			AB0 = _mm512_fmadd_ps(A0, B0, AB0);
+			AA0 = _mm512_fmadd_ps(A0, A0, AA0);
+			BB0 = _mm512_fmadd_ps(B0, B0, BB0);
+			AB1 = _mm512_fmadd_ps(A1, B1, AB1);
+			AA1 = _mm512_fmadd_ps(A1, A1, AA1);
+			BB1 = _mm512_fmadd_ps(B1, B1, BB1);
+		}
+		for (; i < Num; i += 16)
+		{
+			const int32 Remaining = Num - i;
+			const __mmask16 Mask = Remaining >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << Remaining) - 1u);
+			const __m512 A0 = _mm512_maskz_loadu_ps(Mask, A + i);
+			const __m512 B0 = _mm512_maskz_loadu_ps(Mask, B + i);
+			AB0 = _mm512_fmadd_ps(A0, B0, AB0);
+			AA0 = _mm512_fmadd_ps(A0, A0, AA0);
+			BB0 = _mm512_fmadd_ps(B0, B0, BB0);
+		}
+
+		OutAB = _mm512_reduce_add_ps(_mm512_add_ps(AB0, AB1));
+		OutAA = _mm512_reduce_add_ps(_mm512_add_ps(AA0, AA1));
+		OutBB = _mm512_reduce_add_ps(_mm512_add_ps(BB0, BB1));
+	}
+
+	struct FCpuFeatures
+	{
+		bool bAVX2 = false;
+		bool bAVX512 = false;
+	};
+
+	OPENAI_TARGET("xsave")
+	FCpuFeatures DetectCpuFeatures()
+	{
+		FCpuFeatures Features;
+#if defined(_MSC_VER)
+		int Info[4];
+		__cpuid(Info, 0);
+		if (Info[0] < 7)
+		{
+			return Features;
+		}
+		__cpuid(Info, 1);
+		const bool bOSXSave = (Info[2] & (1 << 27)) != 0;
+		const bool bFMA = (Info[2] & (1 << 12)) != 0;
+		if (!bOSXSave)
+		{
+			return Features;
+		}
+
+		// the OS has to save the wider registers on context switches as well
+		const uint64 XCR0 = _xgetbv(0);
+		const bool bOSAVX = (XCR0 & 0x6) == 0x6;
+		const bool bOSAVX512 = (XCR0 & 0xE6) == 0xE6;
+
+		__cpuidex(Info, 7, 0);
+		Features.bAVX2 = bOSAVX && bFMA && (Info[1] & (1 << 5)) != 0;
+		Features.bAVX512 = bOSAVX512 && (Info[1] & (1 << 16)) != 0;
+#else
+		__builtin_cpu_init();
+		Features.bAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		Features.bAVX512 = __builtin_cpu_supports("avx512f");
+#endif
+		return Features;
+	}
+#endif
+
+#if OPENAI_VECTOR_NEON
+	float DotProductNEON(const float* A, const float* B, int32 Num)
+	{
+		float32x4_t Sum0 = vdupq_n_f32(0.0f);
+		float32x4_t Sum1 = vdupq_n_f32(0.0f);
+		float32x4_t Sum2 = vdupq_n_f32(0.0f);
+		float32x4_t Sum3 = vdupq_n_f32(0.0f);
+
+		int32 i = 0;
+		for (; i + 16 <= Num; i += 16)
+		{
+			Sum0 = vfmaq_f32(Sum0, vld1q_f32(A + i), vld1q_f32(B + i));
+			Sum1 = vfmaq_f32(Sum1, vld1q_f32(A + i + 4), vld1q_f32(B + i + 4));
+			Sum2 = vfmaq_f32(Sum2, vld1q_f32(A + i + 8), vld1q_f32(B + i + 8));
+			Sum3 = vfmaq_f32(Sum3, vld1q_f32(A + i + 12), vld1q_f32(B + i + 12));
+		}
+		for (; i + 4 <= Num; i += 4)
+		{
+			Sum0 = vfmaq_f32(Sum0, vld1q_f32(A + i), vld1q_f32(B + i));
+		}
+
+		float Result = vaddvq_f32(vaddq_f32(vaddq_f32(Sum0, Sum1), vaddq_f32(Sum2, Sum3)));
+		for (; i < Num; i++)
+		{
+			Result += A[i] * B[i];
+		}
+		return Result;
+	}
+
+	void DotProductAndNormsNEON(const float* A, const float* B, int32 Num, float& OutAB, float& OutAA, float& OutBB)
+	{
+		float32x4_t AB0 = vdupq_n_f32(0.0f), AB1 = vdupq_n_f32(0.0f);
+		float32x4_t AA0 = vdupq_n_f32(0.0f), AA1 = vdupq_n_f32(0.0f);
+		float32x4_t BB0 = vdupq_n_f32(0.0f), BB1 = vdupq_n_f32(0.0f);
+
+		int32 i = 0;
+		for (; i + 8 <= Num; i += 8)
+		{
+			const float32x4_t A0 = vld1q_f32(A + i);
+			const float32x4_t B0 = vld1q_f32(B + i);
+			const float32x4_t A1 = vld1q_f32(A + i + 4);
+			const float32x4_t B1 = vld1q_f32(B + i + 4);
+			AB0 = vfmaq_f32(AB0, A0, B0);
+			AA0 = vfmaq_f32(AA0, A0, A0);
+			BB0 = vfmaq_f32(BB0, B0, B0);
+			AB1 = vfmaq_f32(AB1, A1, B1);
+			AA1 = vfmaq_f32(AA1, A1, A1);
+			BB1 = vfmaq_f32(BB1, B1, B1);
+		}
+		for (; i + 4 <= Num; i += 4)
+		{
+			const float32x4_t A0 = vld1q_f32(A + i);
+			const float32x4_t B0 = vld1q_f32(B + i);
+			AB0 = vfmaq_f32(AB0, A0, B0);
+			AA0 = vfmaq_f32(AA0, A0, A0);
+			BB0 = vfmaq_f32(BB0, B0, B0);
+		}
+
+		float AB = vaddvq_f32(vaddq_f32(AB0, AB1));
+		float AA = vaddvq_f32(vaddq_f32(AA0, AA1));
+		float BB = vaddvq_f32(vaddq_f32(BB0, BB1));
+		for (; i < Num; i++)
+		{
+			AB += A[i] * B[i];
+			AA += A[i] * A[i];
+			BB += B[i] * B[i];
+		}
+		OutAB = AB;
+		OutAA = AA;
+		OutBB = BB;
+	}
+#endif
+
+	// widest first
+	TArray<FVectorKernel> GatherAvailableKernels()
+	{
+		TArray<FVectorKernel> Kernels;
+#if OPENAI_VECTOR_X86
+		const FCpuFeatures Features = DetectCpuFeatures();
+		if (Features.bAVX512)
+		{
+			Kernels.Add({ TEXT("AVX-512"), &DotProductAVX512, &DotProductAndNormsAVX512 });
+		}
+		if (Features.bAVX2)
+		{
+			Kernels.Add({ TEXT("AVX2"), &DotProductAVX2, &DotProductAndNormsAVX2 });
+		}
+		Kernels.Add({ TEXT("SSE"), &DotProductSSE, &DotProductAndNormsSSE });
+#endif
+#if OPENAI_VECTOR_NEON
+		Kernels.Add({ TEXT("NEON"), &DotProductNEON, &DotProductAndNormsNEON });
+#endif
+		Kernels.Add({ TEXT("Scalar"), &DotProductScalarKernel, &DotProductAndNormsScalarKernel });
+		return Kernels;
+	}
+
+	const TArray<FVectorKernel>& GetAvailableKernels()
+	{
+		static const TArray<FVectorKernel> Kernels = GatherAvailableKernels();
+		return Kernels;
+	}
+
+	const FVectorKernel& GetActiveKernel()
+	{
+		static const FVectorKernel Kernel = GetAvailableKernels()[0];
+		return Kernel;
+	}
+
+	float CosineFromParts(float AB, float AA, float BB)
+	{
+		const float LengthProduct = FMath::Sqrt(AA * BB);
+		return LengthProduct > 0.0f ? AB / LengthProduct : 0.0f;
+	}
+
+	template<typename RowAccessor>
+	void ScoreRows(const float* Query, int32 NumRows, int32 Num, bool bNormalized, float* OutScores, RowAccessor GetRow)
+	{
+		const FVectorKernel& Kernel = GetActiveKernel();
+
+		auto ScoreRange = [&](int32 Begin, int32 End)
+		{
+			for (int32 Row = Begin; Row < End; Row++)
+			{
+				if (bNormalized)
+				{
+					OutScores[Row] = Kernel.DotProduct(Query, GetRow(Row), Num);
+				}
+				else
+				{
+					float AB, AA, BB;
+					Kernel.DotProductAndNorms(Query, GetRow(Row), Num, AB, AA, BB);
+					OutScores[Row] = CosineFromParts(AB, AA, BB);
+				}
+			}
+		};
+
+		if ((int64)NumRows * Num < ParallelBatchThreshold)
+		{
+			ScoreRange(0, NumRows);
+			return;
+		}
+
+		// blocks of rows keep each task streaming through contiguous memory
+		const int32 RowsPerBlock = FMath::Max(1, ParallelBatchThreshold / FMath::Max(1, Num));
+		const int32 NumBlocks = FMath::DivideAndRoundUp(NumRows, RowsPerBlock);
+		ParallelFor(NumBlocks, [&](int32 Block)
+		{
+			const int32 Begin = Block * RowsPerBlock;
+			ScoreRange(Begin, FMath::Min(Begin + RowsPerBlock, NumRows));
+		});
+	}
+}
+
+float FOpenAIVectorMath::DotProduct(const float* A, const float* B, int32 Num)
+{
+	return GetActiveKernel().DotProduct(A, B, Num);
+}
+
+float FOpenAIVectorMath::DotProductScalar(const float* A, const float* B, int32 Num)
+{
+	return DotProductScalarKernel(A, B, Num);
+}
+
+void FOpenAIVectorMath::DotProductAndNorms(const float* A, const float* B, int32 Num, float& OutAB, float& OutAA, float& OutBB)
+{
+	GetActiveKernel().DotProductAndNorms(A, B, Num, OutAB, OutAA, OutBB);
+}
+
+float FOpenAIVectorMath::CosineSimilarity(const float* A, const float* B, int32 Num)
+{
+	float AB, AA, BB;
+	GetActiveKernel().DotProductAndNorms(A, B, Num, AB, AA, BB);
+	return CosineFromParts(AB, AA, BB);
+}
+
+void FOpenAIVectorMath::Normalize(float* Data, int32 Num)
+{
+	const float Length = FMath::Sqrt(DotProduct(Data, Data, Num));
+	if (Length <= 0.0f)
+	{
+		return;
+	}
+
+	const float InvLength = 1.0f / Length;
+	for (int32 i = 0; i < Num; i++)
+	{
+		Data[i] *= InvLength;
+	}
+}
+
+void FOpenAIVectorMath::CosineSimilarityBatch(const float* Query, const float* Rows, int32 NumRows, int32 Num, bool bNormalized, float* OutScores)
+{
+	ScoreRows(Query, NumRows, Num, bNormalized, OutScores, [Rows, Num](int32 Row) { return Rows + (int64)Row * Num; });
+}
+
+void FOpenAIVectorMath::CosineSimilarityBatch(const float* Query, TArrayView<const float* const> Rows, int32 Num, bool bNormalized, float* OutScores)
+{
+	ScoreRows(Query, Rows.Num(), Num, bNormalized, OutScores, [Rows](int32 Row) { return Rows[Row]; });
+}
+
+int32 FOpenAIVectorMath::DotProductInt8(const int8* A, const int8* B, int32 Num)
+{
+	// plain widening loop, compilers turn this into pmaddwd / sdot style code
+	int32 Sum = 0;
+	for (int32 i = 0; i < Num; i++)
+	{
+		Sum += (int32)A[i] * (int32)B[i];
+	}
+	return Sum;
+}
+
+float FOpenAIVectorMath::QuantizeInt8(const float* Data, int32 Num, int8* OutCodes)
+{
+	float MaxAbs = 0.0f;
+	for (int32 i = 0; i < Num; i++)
+	{
+		MaxAbs = FMath::Max(MaxAbs, FMath::Abs(Data[i]));
+	}
+
+	const float Scale = MaxAbs > 0.0f ? MaxAbs / 127.0f : 1.0f;
+	const float InvScale = 1.0f / Scale;
+	for (int32 i = 0; i < Num; i++)
+	{
+		OutCodes[i] = (int8)FMath::Clamp(FMath::RoundToInt(Data[i] * InvScale), -127, 127);
+	}
+	return Scale;
+}
+
+void FOpenAIVectorMath::DotProductInt8Batch(const int8* Query, const int8* Rows, const float* RowWeights, int32 NumRows, int32 Num, float* OutScores)
+{
+	auto ScoreRange = [&](int32 Begin, int32 End)
+	{
+		for (int32 Row = Begin; Row < End; Row++)
+		{
+			OutScores[Row] = (float)DotProductInt8(Query, Rows + (int64)Row * Num, Num) * RowWeights[Row];
+		}
+	};
+
+	// int8 rows are a quarter of the bytes, so a block covers four times the rows of a float block
+	const int32 RowsPerBlock = FMath::Max(1, 4 * ParallelBatchThreshold / FMath::Max(1, Num));
+	if (NumRows <= RowsPerBlock)
+	{
+		ScoreRange(0, NumRows);
+		return;
+	}
+
+	const int32 NumBlocks = FMath::DivideAndRoundUp(NumRows, RowsPerBlock);
+	ParallelFor(NumBlocks, [&](int32 Block)
+	{
+		const int32 Begin = Block * RowsPerBlock;
+		ScoreRange(Begin, FMath::Min(Begin + RowsPerBlock, NumRows));
+	});
+}
+
+TArray<FHDVectorSearchResult> FOpenAIVectorMath::SelectTopK(TArrayView<const float> Scores, int32 K)
+{
+	TArray<FHDVectorSearchResult> Heap;
+	if (K <= 0)
+	{
+		return Heap;
+	}
+
+	Heap.Reserve(FMath::Min(K, Scores.Num()));
+	for (int32 Index = 0; Index < Scores.Num(); Index++)
+	{
+		FHDVectorSearchResult Result;
+		Result.Index = Index;
+		Result.Score = Scores[Index];
+		PushTopResult(Heap, K, Result);
+	}
+
+	Heap.Sort([](const FHDVectorSearchResult& A, const FHDVectorSearchResult& B) { return A.Score > B.Score; });
+	return Heap;
+}
+
+void FOpenAIVectorMath::PushTopResult(TArray<FHDVectorSearchResult>& Heap, int32 K, const FHDVectorSearchResult& Result)
+{
+	auto MinScore = [](const FHDVectorSearchResult& A, const FHDVectorSearchResult& B) { return A.Score < B.Score; };
+	if (Heap.Num() < K)
+	{
+		Heap.HeapPush(Result, MinScore);
+	}
+	else if (Result.Score > Heap.HeapTop().Score)
+	{
+		Heap.HeapPopDiscard(MinScore, false);
+		Heap.HeapPush(Result, MinScore);
+	}
+}
+
+TArray<FHDVectorSearchResult> FOpenAIVectorMath::FuseReciprocalRank(TArrayView<const TArray<FHDVectorSearchResult>> Rankings, TArrayView<const float> Weights, int32 K, float RankConstant)
+{
+	TMap<int32, float> Fused;
+	for (int32 RankingIndex = 0; RankingIndex < Rankings.Num(); RankingIndex++)
+	{
+		const float Weight = Weights.IsValidIndex(RankingIndex) ? Weights[RankingIndex] : 1.0f;
+		const TArray<FHDVectorSearchResult>& Ranking = Rankings[RankingIndex];
+		for (int32 Rank = 0; Rank < Ranking.Num(); Rank++)
+		{
+			Fused.FindOrAdd(Ranking[Rank].Index) += Weight / (RankConstant + Rank + 1);
+		}
+	}
+
+	TArray<FHDVectorSearchResult> Heap;
+	if (K <= 0)
+	{
+		return Heap;
+	}
+	for (const TPair<int32, float>& Entry : Fused)
+	{
+		FHDVectorSearchResult Result;
+		Result.Index = Entry.Key;
+		Result.Score = Entry.Value;
+		PushTopResult(Heap, K, Result);
+	}
+
+	Heap.Sort([](const FHDVectorSearchResult& A, const FHDVectorSearchResult& B) { return A.Score > B.Score; });
+	return Heap;
+}
+
+const TCHAR* FOpenAIVectorMath::GetKernelName()
+{
+	return GetActiveKernel().Name;
+}
+
+bool FOpenAIVectorMath::VerifyKernels(int32 MaxDimension)
+{
+	FRandomStream Random(0x0A1);
+	TArray<float> A;
+	TArray<float> B;
+	A.SetNumUninitialized(MaxDimension);
+	B.SetNumUninitialized(MaxDimension);
+	for (int32 i = 0; i < MaxDimension; i++)
+	{
+		A[i] = Random.FRandRange(-1.0f, 1.0f);
+		B[i] = Random.FRandRange(-1.0f, 1.0f);
+	}
+
+	bool bAllMatch = true;
+	for (const FVectorKernel& Kernel : GetAvailableKernels())
+	{
+		for (int32 Num = 0; Num <= MaxDimension; Num++)
+		{
+			const float Expected = DotProductScalarKernel(A.GetData(), B.GetData(), Num);
+			const float Actual = Kernel.DotProduct(A.GetData(), B.GetData(), Num);
+
+			float ExpectedAB, ExpectedAA, ExpectedBB;
+			float ActualAB, ActualAA, ActualBB;
+			DotProductAndNormsScalarKernel(A.GetData(), B.GetData(), Num, ExpectedAB, ExpectedAA, ExpectedBB);
+			Kernel.DotProductAndNorms(A.GetData(), B.GetData(), Num, ActualAB, ActualAA, ActualBB);
+
+			// SIMD kernels sum in a different order, allow for the rounding that causes
+			const float Tolerance = 1e-4f * FMath::Max(1.0f, (float)Num);
+			if (!FMath::IsNearlyEqual(Expected, Actual, Tolerance) || !FMath::IsNearlyEqual(ExpectedAB, ActualAB, Tolerance) ||
+				!FMath::IsNearlyEqual(ExpectedAA, ActualAA, Tolerance) || !FMath::IsNearlyEqual(ExpectedBB, ActualBB, Tolerance))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorMath %s kernel mismatch at dimension %d: %f != %f"), Kernel.Name, Num, Actual, Expected);
+				bAllMatch = false;
+				break;
+			}
+		}
+	}
+	return bAllMatch;
+}
@@ -0,0 +1,432 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIVectorQuantization.h"
+#include "OpenAIVectorMath.h"
+#include "Math/Float16.h"
+#include "Math/RandomStream.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	float DecodeHalf(const uint8* Bytes)
+	{
+		FFloat16 Half;
+		FMemory::Memcpy(&Half.Encoded, Bytes, sizeof(uint16));
+		return Half.GetFloat();
+	}
+
+	/** Codes come from blueprints and saved data, they index straight into the codebook so every one has to be in range. */
+	bool HasValidProductCodes(const FQuantizedHighDimensionalVector& Quantized, int32 NumSubspaces, int32 NumCentroids)
+	{
+		if (Quantized.Codes.Num() != NumSubspaces)
+		{
+			return false;
+		}
+		for (uint8 Code : Quantized.Codes)
+		{
+			if (Code >= NumCentroids)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** FP16 and INT8 vectors hold one code per component. */
+	bool HasValidScalarCodes(const FQuantizedHighDimensionalVector& Quantized)
+	{
+		const int32 CodeSize = Quantized.Format == EOAVectorQuantization::FP16 ? sizeof(uint16) : 1;
+		return Quantized.Dimension >= 0 && Quantized.Codes.Num() == Quantized.Dimension * CodeSize;
+	}
+}
+
+FQuantizedHighDimensionalVector FOpenAIVectorQuantization::QuantizeFP16(const FHighDimensionalVector& Vector)
+{
+	const int32 Dimension = Vector.Components.Num();
+
+	FQuantizedHighDimensionalVector Out;
+	Out.Format = EOAVectorQuantization::FP16;
+	Out.Dimension = Dimension;
+	Out.Codes.SetNumUninitialized(Dimension * sizeof(uint16));
+
+	float SquaredLength = 0.0f;
+	for (int32 i = 0; i < Dimension; i++)
+	{
+		FFloat16 Half(Vector.Components[i]);
+		FMemory::Memcpy(&Out.Codes[i * sizeof(uint16)], &Half.Encoded, sizeof(uint16));
+
+		const float Decoded = Half.GetFloat();
+		SquaredLength += Decoded * Decoded;
+	}
+	Out.Length = FMath::Sqrt(SquaredLength);
+	return Out;
+}
+
+FQuantizedHighDimensionalVector FOpenAIVectorQuantization::QuantizeInt8(const FHighDimensionalVector& Vector)
+{
+	const int32 Dimension = Vector.Components.Num();
+
+	FQuantizedHighDimensionalVector Out;
+	Out.Format = EOAVectorQuantization::INT8;
+	Out.Dimension = Dimension;
+	Out.Codes.SetNumUninitialized(Dimension);
+
+	float MaxAbs = 0.0f;
+	for (float Component : Vector.Components)
+	{
+		MaxAbs = FMath::Max(MaxAbs, FMath::Abs(Component));
+	}
+	Out.Scale = MaxAbs > 0.0f ? MaxAbs / 127.0f : 1.0f;
+
+	const float InvScale = 1.0f / Out.Scale;
+	int64 SquaredLength = 0;
+	for (int32 i = 0; i < Dimension; i++)
+	{
+		const int8 Code = (int8)FMath::Clamp(FMath::RoundToInt(Vector.Components[i] * InvScale), -127, 127);
+		Out.Codes[i] = (uint8)Code;
+		SquaredLength += (int64)Code * Code;
+	}
+	Out.Length = FMath::Sqrt((float)SquaredLength) * Out.Scale;
+	return Out;
+}
+
+FQuantizedHighDimensionalVector FOpenAIVectorQuantization::QuantizeProduct(const FHighDimensionalVector& Vector, const FProductQuantizer& Quantizer)
+{
+	FQuantizedHighDimensionalVector Out;
+	Out.Format = EOAVectorQuantization::PRODUCT;
+
+	if (!Quantizer.IsValid() || Vector.Components.Num() != Quantizer.Dimension)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::QuantizeProduct quantizer doesn't match a %d dimensional vector"), Vector.Components.Num());
+		return Out;
+	}
+
+	const int32 SubDimension = Quantizer.GetSubDimension();
+	Out.Dimension = Quantizer.Dimension;
+	Out.Codes.SetNumUninitialized(Quantizer.NumSubspaces);
+
+	float SquaredLength = 0.0f;
+	for (int32 Subspace = 0; Subspace < Quantizer.NumSubspaces; Subspace++)
+	{
+		const float* Sub = Vector.Components.GetData() + Subspace * SubDimension;
+		const float* Codebook = Quantizer.Centroids.GetData() + Subspace * Quantizer.NumCentroids * SubDimension;
+
+		int32 BestCentroid = 0;
+		float BestDistance = TNumericLimits<float>::Max();
+		for (int32 Centroid = 0; Centroid < Quantizer.NumCentroids; Centroid++)
+		{
+			const float* C = Codebook + Centroid * SubDimension;
+			float Distance = 0.0f;
+			for (int32 i = 0; i < SubDimension; i++)
+			{
+				const float Delta = Sub[i] - C[i];
+				Distance += Delta * Delta;
+			}
+			if (Distance < BestDistance)
+			{
+				BestDistance = Distance;
+				BestCentroid = Centroid;
+			}
+		}
+
+		Out.Codes[Subspace] = (uint8)BestCentroid;
+		const float* Chosen = Codebook + BestCentroid * SubDimension;
+		for (int32 i = 0; i < SubDimension; i++)
+		{
+			SquaredLength += Chosen[i] * Chosen[i];
+		}
+	}
+	Out.Length = FMath::Sqrt(SquaredLength);
+	return Out;
+}
+
+FHighDimensionalVector FOpenAIVectorQuantization::Dequantize(const FQuantizedHighDimensionalVector& Quantized, const FProductQuantizer* Quantizer)
+{
+	if (Quantized.Format != EOAVectorQuantization::PRODUCT && !HasValidScalarCodes(Quantized))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::Dequantize %d codes don't match a %d dimensional vector"), Quantized.Codes.Num(), Quantized.Dimension);
+		return {};
+	}
+
+	FHighDimensionalVector Out(FMath::Max(Quantized.Dimension, 0));
+
+	switch (Quantized.Format)
+	{
+	case EOAVectorQuantization::FP16:
+		for (int32 i = 0; i < Quantized.Dimension; i++)
+		{
+			Out.Components[i] = DecodeHalf(&Quantized.Codes[i * sizeof(uint16)]);
+		}
+		break;
+	case EOAVectorQuantization::INT8:
+		for (int32 i = 0; i < Quantized.Dimension; i++)
+		{
+			Out.Components[i] = (int8)Quantized.Codes[i] * Quantized.Scale;
+		}
+		break;
+	case EOAVectorQuantization::PRODUCT:
+		if (Quantizer && Quantizer->IsValid() && Quantizer->Dimension == Quantized.Dimension && HasValidProductCodes(Quantized, Quantizer->NumSubspaces, Quantizer->NumCentroids))
+		{
+			const int32 SubDimension = Quantizer->GetSubDimension();
+			for (int32 Subspace = 0; Subspace < Quantizer->NumSubspaces; Subspace++)
+			{
+				const float* Centroid = Quantizer->Centroids.GetData() + (Subspace * Quantizer->NumCentroids + Quantized.Codes[Subspace]) * SubDimension;
+				FMemory::Memcpy(Out.Components.GetData() + Subspace * SubDimension, Centroid, SubDimension * sizeof(float));
+			}
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::Dequantize product quantized vector needs a matching quantizer"));
+		}
+		break;
+	}
+	return Out;
+}
+
+FProductQuantizer FOpenAIVectorQuantization::TrainProductQuantizer(const TArray<FHighDimensionalVector>& Samples, int32 NumSubspaces, int32 NumCentroids, int32 Iterations)
+{
+	FProductQuantizer Quantizer;
+
+	if (Samples.Num() == 0 || NumSubspaces <= 0)
+	{
+		return Quantizer;
+	}
+
+	const int32 Dimension = Samples[0].Components.Num();
+	if (Dimension % NumSubspaces != 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::TrainProductQuantizer dimension %d is not divisible by %d subspaces"), Dimension, NumSubspaces);
+		return Quantizer;
+	}
+	for (const FHighDimensionalVector& Sample : Samples)
+	{
+		if (Sample.Components.Num() != Dimension)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::TrainProductQuantizer samples have mixed dimensions"));
+			return Quantizer;
+		}
+	}
+
+	const int32 SubDimension = Dimension / NumSubspaces;
+	Quantizer.Dimension = Dimension;
+	Quantizer.NumSubspaces = NumSubspaces;
+	Quantizer.NumCentroids = FMath::Clamp(NumCentroids, 1, FMath::Min(256, Samples.Num()));
+	Quantizer.Centroids.SetNumZeroed(NumSubspaces * Quantizer.NumCentroids * SubDimension);
+
+	// seed every subspace with the same deterministic pick of distinct samples
+	TArray<int32> SeedOrder;
+	SeedOrder.SetNumUninitialized(Samples.Num());
+	for (int32 i = 0; i < Samples.Num(); i++)
+	{
+		SeedOrder[i] = i;
+	}
+	FRandomStream Random(Samples.Num());
+	for (int32 i = SeedOrder.Num() - 1; i > 0; i--)
+	{
+		SeedOrder.Swap(i, Random.RandRange(0, i));
+	}
+
+	const int32 K = Quantizer.NumCentroids;
+	ParallelFor(NumSubspaces, [&](int32 Subspace)
+	{
+		float* Codebook = Quantizer.Centroids.GetData() + Subspace * K * SubDimension;
+		const int32 Offset = Subspace * SubDimension;
+
+		for (int32 Centroid = 0; Centroid < K; Centroid++)
+		{
+			FMemory::Memcpy(Codebook + Centroid * SubDimension, Samples[SeedOrder[Centroid]].Components.GetData() + Offset, SubDimension * sizeof(float));
+		}
+
+		TArray<double> Sums;
+		TArray<int32> Counts;
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Sums.SetNumZeroed(K * SubDimension);
+			Counts.SetNumZeroed(K);
+
+			for (const FHighDimensionalVector& Sample : Samples)
+			{
+				const float* Sub = Sample.Components.GetData() + Offset;
+
+				int32 BestCentroid = 0;
+				float BestDistance = TNumericLimits<float>::Max();
+				for (int32 Centroid = 0; Centroid < K; Centroid++)
+				{
+					const float* C = Codebook + Centroid * SubDimension;
+					float Distance = 0.0f;
+					for (int32 i = 0; i < SubDimension; i++)
+					{
+						const float Delta = Sub[i] - C[i];
+						Distance += Delta * Delta;
+					}
+					if (Distance < BestDistance)
+					{
+						BestDistance = Distance;
+						BestCentroid = Centroid;
+					}
+				}
+
+				Counts[BestCentroid]++;
+				double* Sum = Sums.GetData() + BestCentroid * SubDimension;
+				for (int32 i = 0; i < SubDimension; i++)
+				{
+					Sum[i] += Sub[i];
+				}
+			}
+
+			// empty clusters keep their previous centroid
+			for (int32 Centroid = 0; Centroid < K; Centroid++)
+			{
+				if (Counts[Centroid] == 0)
+				{
+					continue;
+				}
+				for (int32 i = 0; i < SubDimension; i++)
+				{
+					Codebook[Centroid * SubDimension + i] = (float)(Sums[Centroid * SubDimension + i] / Counts[Centroid]);
+				}
+			}
+		}
+	});
+
+	return Quantizer;
+}
+
+void FOpenAIVectorQuantization::BuildDistanceTable(const float* Query, const FProductQuantizer& Quantizer, TArray<float>& OutTable)
+{
+	const int32 SubDimension = Quantizer.GetSubDimension();
+	OutTable.SetNumUninitialized(Quantizer.NumSubspaces * Quantizer.NumCentroids);
+
+	for (int32 Subspace = 0; Subspace < Quantizer.NumSubspaces; Subspace++)
+	{
+		const float* Sub = Query + Subspace * SubDimension;
+		for (int32 Centroid = 0; Centroid < Quantizer.NumCentroids; Centroid++)
+		{
+			const float* C = Quantizer.Centroids.GetData() + (Subspace * Quantizer.NumCentroids + Centroid) * SubDimension;
+			float Dot = 0.0f;
+			for (int32 i = 0; i < SubDimension; i++)
+			{
+				Dot += Sub[i] * C[i];
+			}
+			OutTable[Subspace * Quantizer.NumCentroids + Centroid] = Dot;
+		}
+	}
+}
+
+float FOpenAIVectorQuantization::DotProduct(const float* Query, const FQuantizedHighDimensionalVector& Quantized)
+{
+	float Sum = 0.0f;
+	if (Quantized.Format != EOAVectorQuantization::PRODUCT && !HasValidScalarCodes(Quantized))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::DotProduct %d codes don't match a %d dimensional vector"), Quantized.Codes.Num(), Quantized.Dimension);
+		return Sum;
+	}
+
+	switch (Quantized.Format)
+	{
+	case EOAVectorQuantization::FP16:
+		for (int32 i = 0; i < Quantized.Dimension; i++)
+		{
+			Sum += Query[i] * DecodeHalf(&Quantized.Codes[i * sizeof(uint16)]);
+		}
+		break;
+	case EOAVectorQuantization::INT8:
+		for (int32 i = 0; i < Quantized.Dimension; i++)
+		{
+			Sum += Query[i] * (int8)Quantized.Codes[i];
+		}
+		Sum *= Quantized.Scale;
+		break;
+	case EOAVectorQuantization::PRODUCT:
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::DotProduct product quantized vectors are scored through a distance table"));
+		break;
+	}
+	return Sum;
+}
+
+float FOpenAIVectorQuantization::DotProduct(const TArray<float>& DistanceTable, const FQuantizedHighDimensionalVector& Quantized, int32 NumCentroids)
+{
+	float Sum = 0.0f;
+	if (NumCentroids <= 0 || !HasValidProductCodes(Quantized, DistanceTable.Num() / NumCentroids, NumCentroids))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorQuantization::DotProduct product codes don't match the distance table"));
+		return Sum;
+	}
+	for (int32 Subspace = 0; Subspace < Quantized.Codes.Num(); Subspace++)
+	{
+		Sum += DistanceTable[Subspace * NumCentroids + Quantized.Codes[Subspace]];
+	}
+	return Sum;
+}
+
+TArray<FHDVectorSearchResult> FOpenAIVectorQuantization::Search(const FHighDimensionalVector& Query, const TArray<FQuantizedHighDimensionalVector>& Candidates,
+	const TArray<FHighDimensionalVector>& FullVectors, const FProductQuantizer* Quantizer, int32 TopK, int32 ShortlistSize)
+{
+	TArray<FHDVectorSearchResult> Results;
+	if (TopK <= 0 || Candidates.Num() == 0)
+	{
+		return Results;
+	}
+
+	const bool bRescore = FullVectors.Num() == Candidates.Num();
+	const int32 NumShortlisted = bRescore ? FMath::Max(ShortlistSize, TopK) : TopK;
+	const float QueryLength = FMath::Sqrt(FOpenAIVectorMath::DotProduct(Query.Components.GetData(), Query.Components.GetData(), Query.Components.Num()));
+
+	TArray<float> DistanceTable;
+	if (Quantizer && Quantizer->IsValid() && Quantizer->Dimension == Query.Components.Num())
+	{
+		BuildDistanceTable(Query.Components.GetData(), *Quantizer, DistanceTable);
+	}
+
+	// marks candidates that can't be scored, they are dropped from the results
+	const float InvalidScore = -TNumericLimits<float>::Max();
+
+	TArray<float> Scores;
+	Scores.SetNumUninitialized(Candidates.Num());
+	ParallelFor(Candidates.Num(), [&](int32 Index)
+	{
+		const FQuantizedHighDimensionalVector& Candidate = Candidates[Index];
+		float Dot = 0.0f;
+		if (Candidate.Dimension != Query.Components.Num() || (Candidate.Format != EOAVectorQuantization::PRODUCT && !HasValidScalarCodes(Candidate)))
+		{
+			Scores[Index] = InvalidScore;
+			return;
+		}
+		if (Candidate.Format == EOAVectorQuantization::PRODUCT)
+		{
+			if (DistanceTable.Num() == 0 || !HasValidProductCodes(Candidate, Quantizer->NumSubspaces, Quantizer->NumCentroids))
+			{
+				Scores[Index] = InvalidScore;
+				return;
+			}
+			Dot = DotProduct(DistanceTable, Candidate, Quantizer->NumCentroids);
+		}
+		else
+		{
+			Dot = DotProduct(Query.Components.GetData(), Candidate);
+		}
+		const float LengthProduct = QueryLength * Candidate.Length;
+		Scores[Index] = LengthProduct > 0.0f ? Dot / LengthProduct : 0.0f;
+	}, Candidates.Num() < 1024 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	TArray<FHDVectorSearchResult> Shortlist = FOpenAIVectorMath::SelectTopK(Scores, NumShortlisted);
+	Shortlist.RemoveAll([InvalidScore](const FHDVectorSearchResult& Result) { return Result.Score == InvalidScore; });
+
+	if (bRescore)
+	{
+		for (FHDVectorSearchResult& Result : Shortlist)
+		{
+			if (FullVectors[Result.Index].Components.Num() == Query.Components.Num())
+			{
+				Result.Score = FOpenAIVectorMath::CosineSimilarity(Query.Components.GetData(), FullVectors[Result.Index].Components.GetData(), Query.Components.Num());
+			}
+		}
+	}
+
+	Shortlist.Sort([](const FHDVectorSearchResult& A, const FHDVectorSearchResult& B) { return A.Score > B.Score; });
+	if (Shortlist.Num() > TopK)
+	{
+		Shortlist.SetNum(TopK);
+	}
+	return Shortlist;
+}
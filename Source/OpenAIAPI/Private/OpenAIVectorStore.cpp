@@ -0,0 +1,1149 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIVectorStore.h"
+#include "OpenAIVectorMath.h"
+#include "Algo/UpperBound.h"
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Crc.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+	constexpr uint32 LogMagic = 0x4C56414F;		// "OAVL"
+	constexpr uint32 RecordMagic = 0x5256414F;	// "OAVR"
+	constexpr uint32 NormalizedFlag = 1 << 0;
+	constexpr uint64 VectorAlignment = 64;
+
+	struct FStoreHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 Dimension;
+		uint32 Flags;
+		uint64 Count;
+		uint64 EntriesOffset;
+		uint64 IdBlobOffset;
+		uint64 IdBlobSize;
+		uint64 VectorsOffset;
+		uint64 MetadataOffset;
+		uint64 MetadataSize;
+		uint64 Generation;
+
+		// records at the start of the previous generation's log that are already in this file
+		uint64 FoldedLogRecords;
+		uint8 Reserved[40];
+	};
+	static_assert(sizeof(FStoreHeader) == 128, "Store header layout is part of the file format");
+
+	struct FEntryRecord
+	{
+		uint64 IdOffset;
+		uint64 MetadataOffset;
+		uint32 IdLength;
+		uint32 MetadataLength;
+	};
+
+	struct FLogHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 Generation;
+	};
+
+	struct FLogRecordHeader
+	{
+		uint32 Magic;
+		uint32 Dimension;
+		uint32 IdLength;
+		uint32 MetadataLength;
+	};
+
+	FString GetLogPath(const FString& StorePath)
+	{
+		return StorePath + TEXT(".log");
+	}
+
+	FString GetAlternatePath(const FString& StorePath)
+	{
+		return StorePath + TEXT(".b");
+	}
+
+	TArray<uint8> EncodeUTF8(const FString& String)
+	{
+		FTCHARToUTF8 Converted(*String);
+		return TArray<uint8>((const uint8*)Converted.Get(), Converted.Length());
+	}
+
+	void WriteBytes(FArchive& Writer, const void* Data, int64 Size)
+	{
+		if (Size > 0)
+		{
+			Writer.Serialize(const_cast<void*>(Data), Size);
+		}
+	}
+}
+
+struct FOpenAIVectorStore::FSegment
+{
+	virtual ~FSegment() {}
+
+	virtual int32 Num() const = 0;
+	virtual bool IsMapped() const = 0;
+
+	/** Num() vectors back to back. */
+	virtual const float* GetVectors() const = 0;
+
+	/** UTF-8 bytes of the id, Scratch is used when the segment doesn't hold them encoded. */
+	virtual TArrayView<const uint8> GetIdUTF8(int32 Index, TArray<uint8>& Scratch) const = 0;
+	virtual TArrayView<const uint8> GetMetadataUTF8(int32 Index, TArray<uint8>& Scratch) const = 0;
+
+	virtual FString GetId(int32 Index) const = 0;
+	virtual FString GetMetadata(int32 Index) const = 0;
+
+	/** Int8 codes of the leading components of every row, used by the coarse pass of SearchTwoStage. */
+	struct FCoarseCodes
+	{
+		int32 Dimensions = 0;
+		TArray<int8> Codes;
+
+		// code scale over the length of the truncated row, so code dot products rank like cosine similarity
+		TArray<float> Weights;
+	};
+
+	/** Built on first use and kept, segments never change once published. */
+	TSharedPtr<const FCoarseCodes, ESPMode::ThreadSafe> GetCoarseCodes(int32 CoarseDimensions, int32 Dimension) const
+	{
+		{
+			FScopeLock CoarseLock(&CoarseMutex);
+			if (Coarse.IsValid() && Coarse->Dimensions == CoarseDimensions)
+			{
+				return Coarse;
+			}
+		}
+
+		// built without the lock so a search that already has codes never waits behind a build,
+		// two searches racing on a new segment may both build and the first one to finish wins
+		TSharedRef<FCoarseCodes, ESPMode::ThreadSafe> Built = MakeShared<FCoarseCodes, ESPMode::ThreadSafe>();
+		Built->Dimensions = CoarseDimensions;
+		Built->Codes.SetNumUninitialized(Num() * CoarseDimensions);
+		Built->Weights.SetNumUninitialized(Num());
+
+		const float* Rows = GetVectors();
+		ParallelFor(Num(), [&](int32 Row)
+		{
+			const float* Vector = Rows + (int64)Row * Dimension;
+			const float Scale = FOpenAIVectorMath::QuantizeInt8(Vector, CoarseDimensions, Built->Codes.GetData() + (int64)Row * CoarseDimensions);
+			const float Length = FMath::Sqrt(FOpenAIVectorMath::DotProduct(Vector, Vector, CoarseDimensions));
+			Built->Weights[Row] = Length > 0.0f ? Scale / Length : 0.0f;
+		}, Num() < 1024);
+
+		FScopeLock CoarseLock(&CoarseMutex);
+		if (!Coarse.IsValid() || Coarse->Dimensions != CoarseDimensions)
+		{
+			Coarse = Built;
+		}
+		return Coarse;
+	}
+
+private:
+	mutable FCriticalSection CoarseMutex;
+	mutable TSharedPtr<const FCoarseCodes, ESPMode::ThreadSafe> Coarse;
+};
+
+/** A store file, unmapped when the last snapshot using it is released. */
+struct FOpenAIVectorStore::FMappedSegment : public FOpenAIVectorStore::FSegment
+{
+	IMappedFileHandle* Handle = nullptr;
+	IMappedFileRegion* Region = nullptr;
+	TArray64<uint8> LoadedFallback;
+	const uint8* Data = nullptr;
+	int32 Count = 0;
+	uint64 FoldedLogRecords = 0;
+	const FEntryRecord* Entries = nullptr;
+	const float* Vectors = nullptr;
+
+	virtual ~FMappedSegment()
+	{
+		delete Region;
+		delete Handle;
+	}
+
+	virtual int32 Num() const override { return Count; }
+	virtual bool IsMapped() const override { return true; }
+	virtual const float* GetVectors() const override { return Vectors; }
+
+	virtual TArrayView<const uint8> GetIdUTF8(int32 Index, TArray<uint8>& Scratch) const override
+	{
+		return TArrayView<const uint8>(Data + Entries[Index].IdOffset, Entries[Index].IdLength);
+	}
+
+	virtual TArrayView<const uint8> GetMetadataUTF8(int32 Index, TArray<uint8>& Scratch) const override
+	{
+		return TArrayView<const uint8>(Data + Entries[Index].MetadataOffset, Entries[Index].MetadataLength);
+	}
+
+	virtual FString GetId(int32 Index) const override
+	{
+		return DecodeUTF8(Data + Entries[Index].IdOffset, Entries[Index].IdLength);
+	}
+
+	virtual FString GetMetadata(int32 Index) const override
+	{
+		return DecodeUTF8(Data + Entries[Index].MetadataOffset, Entries[Index].MetadataLength);
+	}
+};
+
+/** Entries published since the store file was written. */
+struct FOpenAIVectorStore::FMemorySegment : public FOpenAIVectorStore::FSegment
+{
+	TArray<FString> Ids;
+	TArray<FString> Metadata;
+	TArray<float> Vectors;
+
+	virtual int32 Num() const override { return Ids.Num(); }
+	virtual bool IsMapped() const override { return false; }
+	virtual const float* GetVectors() const override { return Vectors.GetData(); }
+
+	virtual TArrayView<const uint8> GetIdUTF8(int32 Index, TArray<uint8>& Scratch) const override
+	{
+		Scratch = EncodeUTF8(Ids[Index]);
+		return Scratch;
+	}
+
+	virtual TArrayView<const uint8> GetMetadataUTF8(int32 Index, TArray<uint8>& Scratch) const override
+	{
+		Scratch = EncodeUTF8(Metadata[Index]);
+		return Scratch;
+	}
+
+	virtual FString GetId(int32 Index) const override { return Ids[Index]; }
+	virtual FString GetMetadata(int32 Index) const override { return Metadata[Index]; }
+};
+
+/** Immutable view of the store, replaced as a whole on every publish. */
+struct FOpenAIVectorStore::FSnapshot
+{
+	TArray<FSegmentPtr> Segments;
+	TArray<int32> Starts;
+	int32 Count = 0;
+
+	void AddSegment(FSegmentPtr Segment)
+	{
+		Starts.Add(Count);
+		Count += Segment->Num();
+		Segments.Add(MoveTemp(Segment));
+	}
+
+	/** Segment holding Index and the index within it, nullptr when out of range. */
+	const FSegment* Find(int32 Index, int32& OutLocal) const
+	{
+		if (Index < 0 || Index >= Count)
+		{
+			return nullptr;
+		}
+		const int32 SegmentIndex = Algo::UpperBound(Starts, Index) - 1;
+		OutLocal = Index - Starts[SegmentIndex];
+		return Segments[SegmentIndex].Get();
+	}
+};
+
+FOpenAIVectorStore::FOpenAIVectorStore(const FString& InPath, int32 InDimension, bool bInNormalize)
+	: Path(InPath)
+	, Dimension(InDimension)
+	, bNormalized(bInNormalize)
+	, Current(MakeShared<FSnapshot, ESPMode::ThreadSafe>())
+{
+}
+
+FOpenAIVectorStore::~FOpenAIVectorStore()
+{
+	// an in-flight CompactAsync holds a reference, so nothing else can be using the store here
+	if (LogHandle)
+	{
+		LogHandle->Flush();
+		delete LogHandle;
+		LogHandle = nullptr;
+	}
+}
+
+TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> FOpenAIVectorStore::Open(const FString& Path, int32 Dimension, bool bNormalize)
+{
+	if (Dimension <= 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::Open invalid dimension %d for %s"), Dimension, *Path);
+		return nullptr;
+	}
+
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store = MakeShareable(new FOpenAIVectorStore(Path, Dimension, bNormalize));
+	if (!Store->OpenStoreFile())
+	{
+		return nullptr;
+	}
+
+	Store->ReplayLog();
+	return Store;
+}
+
+TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> FOpenAIVectorStore::CreateInMemory(int32 Dimension, bool bNormalize)
+{
+	if (Dimension <= 0)
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store = MakeShareable(new FOpenAIVectorStore(FString(), Dimension, bNormalize));
+	Store->bInMemory = true;
+	return Store;
+}
+
+FOpenAIVectorStore::FSnapshotPtr FOpenAIVectorStore::GetSnapshot() const
+{
+	FReadScopeLock ReadLock(SnapshotLock);
+	return Current;
+}
+
+void FOpenAIVectorStore::Publish(FSnapshotPtr Snapshot)
+{
+	// the previous snapshot lives on until its last reader lets go of it
+	FWriteScopeLock WriteLock(SnapshotLock);
+	Current = MoveTemp(Snapshot);
+}
+
+void FOpenAIVectorStore::PublishPending()
+{
+	if (PendingIds.Num() == 0)
+	{
+		return;
+	}
+
+	const FSnapshotPtr Previous = GetSnapshot();
+
+	// every publish adds its own segment, an entry is only copied again when its segment is merged with one of similar size
+	TArray<FSegmentPtr> Segments = Previous->Segments;
+	TSharedRef<FMemorySegment, ESPMode::ThreadSafe> Segment = MakeShared<FMemorySegment, ESPMode::ThreadSafe>();
+	Segment->Ids = MoveTemp(PendingIds);
+	Segment->Metadata = MoveTemp(PendingMetadata);
+	Segment->Vectors = MoveTemp(PendingVectors);
+	Segments.Add(Segment);
+
+	// size tiered merging: the last segment is folded into the one before it until that one is more than twice its size,
+	// so sizes at least double towards the base and the tail stays at O(log n) segments without copying it on every publish
+	while (Segments.Num() > 1)
+	{
+		const FSegment& Last = *Segments.Last();
+		const FSegment& BeforeLast = *Segments[Segments.Num() - 2];
+		if (BeforeLast.IsMapped() || BeforeLast.Num() > 2 * Last.Num())
+		{
+			break;
+		}
+
+		const FMemorySegment& Older = static_cast<const FMemorySegment&>(BeforeLast);
+		const FMemorySegment& Newer = static_cast<const FMemorySegment&>(Last);
+		TSharedRef<FMemorySegment, ESPMode::ThreadSafe> Merged = MakeShared<FMemorySegment, ESPMode::ThreadSafe>();
+		Merged->Ids.Reserve(Older.Num() + Newer.Num());
+		Merged->Ids.Append(Older.Ids);
+		Merged->Ids.Append(Newer.Ids);
+		Merged->Metadata.Reserve(Older.Num() + Newer.Num());
+		Merged->Metadata.Append(Older.Metadata);
+		Merged->Metadata.Append(Newer.Metadata);
+		Merged->Vectors.Reserve(Older.Vectors.Num() + Newer.Vectors.Num());
+		Merged->Vectors.Append(Older.Vectors);
+		Merged->Vectors.Append(Newer.Vectors);
+
+		Segments.Pop();
+		Segments.Last() = Merged;
+	}
+
+	TSharedRef<FSnapshot, ESPMode::ThreadSafe> Next = MakeShared<FSnapshot, ESPMode::ThreadSafe>();
+	for (FSegmentPtr& Kept : Segments)
+	{
+		Next->AddSegment(MoveTemp(Kept));
+	}
+
+	PendingIds.Reset();
+	PendingMetadata.Reset();
+	PendingVectors.Reset();
+
+	Publish(Next);
+}
+
+bool FOpenAIVectorStore::OpenStoreFile()
+{
+	const FString Candidates[] = { Path, GetAlternatePath(Path) };
+
+	FSegmentPtr Best;
+	uint64 BestGeneration = 0;
+	bool bBestNormalized = bNormalized;
+	int32 BestCandidate = INDEX_NONE;
+	bool bAnyExists = false;
+
+	for (int32 i = 0; i < UE_ARRAY_COUNT(Candidates); i++)
+	{
+		if (!IFileManager::Get().FileExists(*Candidates[i]))
+		{
+			continue;
+		}
+		bAnyExists = true;
+
+		uint64 CandidateGeneration = 0;
+		bool bCandidateNormalized = false;
+		FSegmentPtr Segment = MapStoreFile(Candidates[i], CandidateGeneration, bCandidateNormalized);
+		if (Segment.IsValid() && (!Best.IsValid() || CandidateGeneration > BestGeneration))
+		{
+			Best = Segment;
+			BestGeneration = CandidateGeneration;
+			bBestNormalized = bCandidateNormalized;
+			BestCandidate = i;
+		}
+	}
+
+	if (!Best.IsValid())
+	{
+		if (bAnyExists)
+		{
+			return false;
+		}
+
+		if (!WriteStoreFile(Path, 1, FSnapshot()))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::Open could not create %s"), *Path);
+			return false;
+		}
+		Best = MapStoreFile(Path, BestGeneration, bBestNormalized);
+		BestCandidate = 0;
+		if (!Best.IsValid())
+		{
+			return false;
+		}
+	}
+
+	// the other file is from before the last compaction, nothing maps it yet
+	const FString& Stale = Candidates[1 - BestCandidate];
+	if (IFileManager::Get().FileExists(*Stale))
+	{
+		IFileManager::Get().Delete(*Stale);
+	}
+
+	ActiveFilePath = Candidates[BestCandidate];
+	Generation = BestGeneration;
+	bNormalized = bBestNormalized;
+
+	TSharedRef<FSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FSnapshot, ESPMode::ThreadSafe>();
+	Snapshot->AddSegment(Best);
+	Publish(Snapshot);
+	return true;
+}
+
+FOpenAIVectorStore::FSegmentPtr FOpenAIVectorStore::MapStoreFile(const FString& FilePath, uint64& OutGeneration, bool& bOutNormalized) const
+{
+	TSharedRef<FMappedSegment, ESPMode::ThreadSafe> Segment = MakeShared<FMappedSegment, ESPMode::ThreadSafe>();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	Segment->Handle = PlatformFile.OpenMapped(*FilePath);
+	if (Segment->Handle && Segment->Handle->GetFileSize() > 0)
+	{
+		Segment->Region = Segment->Handle->MapRegion(0, Segment->Handle->GetFileSize());
+		if (Segment->Region)
+		{
+			Segment->Data = Segment->Region->GetMappedPtr();
+		}
+	}
+
+	// platforms without memory mapping read the file once instead
+	uint64 FileSize = Segment->Region ? Segment->Region->GetMappedSize() : 0;
+	if (!Segment->Data)
+	{
+		if (!FFileHelper::LoadFileToArray(Segment->LoadedFallback, *FilePath))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore could not read %s"), *FilePath);
+			return nullptr;
+		}
+		Segment->Data = Segment->LoadedFallback.GetData();
+		FileSize = Segment->LoadedFallback.Num();
+	}
+
+	if (FileSize < sizeof(FStoreHeader))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore %s is too small to be a vector store"), *FilePath);
+		return nullptr;
+	}
+
+	FStoreHeader Header;
+	FMemory::Memcpy(&Header, Segment->Data, sizeof(FStoreHeader));
+
+	if (Header.Magic != FileMagic || Header.Version != FileVersion)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore %s has an unsupported or corrupt header"), *FilePath);
+		return nullptr;
+	}
+	if (Header.Dimension != (uint32)Dimension)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore %s holds %u dimensional vectors, %d were requested"), *FilePath, Header.Dimension, Dimension);
+		return nullptr;
+	}
+
+	// a range is checked as offset then length against what is left, so huge values cannot wrap past the file size
+	auto FitsInFile = [FileSize](uint64 Offset, uint64 Length)
+	{
+		return Offset <= FileSize && Length <= FileSize - Offset;
+	};
+
+	const bool bValid = Header.Count <= (uint64)MAX_int32 &&
+		Header.EntriesOffset % alignof(FEntryRecord) == 0 && FitsInFile(Header.EntriesOffset, Header.Count * sizeof(FEntryRecord)) &&
+		FitsInFile(Header.IdBlobOffset, Header.IdBlobSize) &&
+		Header.VectorsOffset % VectorAlignment == 0 && FitsInFile(Header.VectorsOffset, Header.Count * Header.Dimension * sizeof(float)) &&
+		FitsInFile(Header.MetadataOffset, Header.MetadataSize);
+
+	if (!bValid)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore %s has an unsupported or corrupt header"), *FilePath);
+		return nullptr;
+	}
+
+	// ids and metadata are read straight from the mapping, every entry has to point inside the file
+	const FEntryRecord* Entries = (const FEntryRecord*)(Segment->Data + Header.EntriesOffset);
+	for (uint64 i = 0; i < Header.Count; ++i)
+	{
+		if (!FitsInFile(Entries[i].IdOffset, Entries[i].IdLength) || !FitsInFile(Entries[i].MetadataOffset, Entries[i].MetadataLength))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore %s has an entry outside the file, entry %llu"), *FilePath, i);
+			return nullptr;
+		}
+	}
+
+	Segment->Count = (int32)Header.Count;
+	Segment->FoldedLogRecords = Header.FoldedLogRecords;
+	Segment->Entries = Entries;
+	Segment->Vectors = (const float*)(Segment->Data + Header.VectorsOffset);
+
+	OutGeneration = Header.Generation;
+	bOutNormalized = (Header.Flags & NormalizedFlag) != 0;
+	return Segment;
+}
+
+bool FOpenAIVectorStore::ReplayLog()
+{
+	FScopeLock WriteLock(&WriteMutex);
+
+	const FString LogPath = GetLogPath(Path);
+
+	TArray64<uint8> LogData;
+	if (!IFileManager::Get().FileExists(*LogPath) || !FFileHelper::LoadFileToArray(LogData, *LogPath) || LogData.Num() < (int64)sizeof(FLogHeader))
+	{
+		return OpenLogForAppend(true);
+	}
+
+	FLogHeader LogHeader;
+	FMemory::Memcpy(&LogHeader, LogData.GetData(), sizeof(FLogHeader));
+
+	// compaction writes the new file before it replaces the log, a crash in between leaves the previous generation's log
+	// behind, its leading records are in the file and the rest were added while the file was written
+	const FSnapshotPtr Base = GetSnapshot();
+	const int32 BaseCount = Base->Count;
+	const bool bPreviousGeneration = LogHeader.Magic == LogMagic && LogHeader.Generation + 1 == Generation &&
+		Base->Segments.Num() > 0 && Base->Segments[0]->IsMapped();
+	uint64 NumToSkip = 0;
+	if (bPreviousGeneration)
+	{
+		NumToSkip = static_cast<const FMappedSegment&>(*Base->Segments[0]).FoldedLogRecords;
+	}
+	else if (LogHeader.Magic != LogMagic || LogHeader.Generation != Generation)
+	{
+		// left over from before an earlier compaction, its records are already part of the store file
+		return OpenLogForAppend(true);
+	}
+
+	int64 Offset = sizeof(FLogHeader);
+	while (Offset + (int64)sizeof(FLogRecordHeader) <= LogData.Num())
+	{
+		FLogRecordHeader Record;
+		FMemory::Memcpy(&Record, LogData.GetData() + Offset, sizeof(FLogRecordHeader));
+		if (Record.Magic != RecordMagic || (int32)Record.Dimension != Dimension)
+		{
+			break;
+		}
+
+		const int64 PayloadSize = sizeof(FLogRecordHeader) + (int64)Record.Dimension * sizeof(float) + Record.IdLength + Record.MetadataLength;
+		if (Offset + PayloadSize + (int64)sizeof(uint32) > LogData.Num())
+		{
+			break;
+		}
+
+		uint32 StoredCrc;
+		FMemory::Memcpy(&StoredCrc, LogData.GetData() + Offset + PayloadSize, sizeof(uint32));
+		if (FCrc::MemCrc32(LogData.GetData() + Offset, (int32)PayloadSize) != StoredCrc)
+		{
+			break;
+		}
+
+		if (NumToSkip > 0)
+		{
+			NumToSkip--;
+			Offset += PayloadSize + sizeof(uint32);
+			continue;
+		}
+
+		const uint8* Cursor = LogData.GetData() + Offset + sizeof(FLogRecordHeader);
+		const int32 VectorStart = PendingVectors.AddUninitialized(Dimension);
+		FMemory::Memcpy(PendingVectors.GetData() + VectorStart, Cursor, Dimension * sizeof(float));
+		Cursor += Dimension * sizeof(float);
+		PendingIds.Add(DecodeUTF8(Cursor, Record.IdLength));
+		Cursor += Record.IdLength;
+		PendingMetadata.Add(DecodeUTF8(Cursor, Record.MetadataLength));
+
+		Offset += PayloadSize + sizeof(uint32);
+	}
+
+	PublishPending();
+
+	if (bPreviousGeneration)
+	{
+		UE_LOG(LogTemp, Log, TEXT("FOpenAIVectorStore recovered %d entries from the log of an interrupted compaction of %s"), GetSnapshot()->Count - BaseCount, *Path);
+		return RewriteLog(*GetSnapshot(), BaseCount);
+	}
+
+	if (Offset < LogData.Num())
+	{
+		// a torn write from a crash, drop it so new records don't land behind garbage
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore dropping %lld unreadable bytes from %s"), LogData.Num() - Offset, *LogPath);
+		LogData.SetNum(Offset);
+		FFileHelper::SaveArrayToFile(LogData, *LogPath);
+	}
+	return OpenLogForAppend(false);
+}
+
+bool FOpenAIVectorStore::OpenLogForAppend(bool bTruncate)
+{
+	if (bInMemory)
+	{
+		return true;
+	}
+	return OpenLogFile(GetLogPath(Path), bTruncate);
+}
+
+bool FOpenAIVectorStore::OpenLogFile(const FString& LogPath, bool bTruncate)
+{
+	if (LogHandle)
+	{
+		delete LogHandle;
+		LogHandle = nullptr;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	LogHandle = PlatformFile.OpenWrite(*LogPath, !bTruncate);
+	if (!LogHandle)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore could not open %s, new vectors will not persist"), *LogPath);
+		return false;
+	}
+
+	if (bTruncate)
+	{
+		FLogHeader LogHeader;
+		LogHeader.Magic = LogMagic;
+		LogHeader.Version = FileVersion;
+		LogHeader.Generation = Generation;
+		LogHandle->Write((const uint8*)&LogHeader, sizeof(FLogHeader));
+		LogHandle->Flush();
+	}
+	return true;
+}
+
+bool FOpenAIVectorStore::RewriteLog(const FSnapshot& Snapshot, int32 FirstIndex)
+{
+	// the records go to a side file that replaces the log in one move, so the old log stays readable until the new one is complete
+	const FString LogPath = GetLogPath(Path);
+	const FString TempPath = LogPath + TEXT(".tmp");
+	if (!OpenLogFile(TempPath, true))
+	{
+		return OpenLogForAppend(false);
+	}
+
+	for (int32 Index = FirstIndex; Index < Snapshot.Count; Index++)
+	{
+		int32 Local = 0;
+		const FSegment* Segment = Snapshot.Find(Index, Local);
+		WriteLogRecord(Segment->GetId(Local), Segment->GetVectors() + (int64)Local * Dimension, Segment->GetMetadata(Local));
+	}
+	for (int32 i = 0; i < PendingIds.Num(); i++)
+	{
+		WriteLogRecord(PendingIds[i], PendingVectors.GetData() + (int64)i * Dimension, PendingMetadata[i]);
+	}
+	LogHandle->Flush();
+	delete LogHandle;
+	LogHandle = nullptr;
+
+	if (!IFileManager::Get().Move(*LogPath, *TempPath, true))
+	{
+		// the old log is still in place and replays against the new file on the next open
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore could not replace %s"), *LogPath);
+		IFileManager::Get().Delete(*TempPath);
+	}
+	return OpenLogForAppend(false);
+}
+
+bool FOpenAIVectorStore::WriteLogRecord(const FString& Id, const float* Vector, const FString& Metadata)
+{
+	if (!LogHandle)
+	{
+		return bInMemory;
+	}
+
+	const TArray<uint8> IdBytes = EncodeUTF8(Id);
+	const TArray<uint8> MetadataBytes = EncodeUTF8(Metadata);
+
+	FLogRecordHeader Record;
+	Record.Magic = RecordMagic;
+	Record.Dimension = Dimension;
+	Record.IdLength = IdBytes.Num();
+	Record.MetadataLength = MetadataBytes.Num();
+
+	TArray<uint8> Buffer;
+	Buffer.Reserve(sizeof(FLogRecordHeader) + Dimension * sizeof(float) + IdBytes.Num() + MetadataBytes.Num() + sizeof(uint32));
+	Buffer.Append((const uint8*)&Record, sizeof(FLogRecordHeader));
+	Buffer.Append((const uint8*)Vector, Dimension * sizeof(float));
+	Buffer.Append(IdBytes);
+	Buffer.Append(MetadataBytes);
+
+	const uint32 Crc = FCrc::MemCrc32(Buffer.GetData(), Buffer.Num());
+	Buffer.Append((const uint8*)&Crc, sizeof(uint32));
+
+	return LogHandle->Write(Buffer.GetData(), Buffer.Num());
+}
+
+bool FOpenAIVectorStore::WriteStoreFile(const FString& TargetPath, uint64 FileGeneration, const FSnapshot& Snapshot) const
+{
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TargetPath));
+	if (!Writer)
+	{
+		return false;
+	}
+
+	const uint64 Count = Snapshot.Count;
+	TArray<uint8> Scratch;
+
+	FStoreHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = FileMagic;
+	Header.Version = FileVersion;
+	Header.Dimension = Dimension;
+	Header.Flags = bNormalized ? NormalizedFlag : 0;
+	Header.Count = Count;
+	Header.Generation = FileGeneration;
+	Header.FoldedLogRecords = Snapshot.Segments.Num() > 0 && Snapshot.Segments[0]->IsMapped() ? Count - Snapshot.Segments[0]->Num() : Count;
+	Header.EntriesOffset = sizeof(FStoreHeader);
+	Header.IdBlobOffset = Header.EntriesOffset + Count * sizeof(FEntryRecord);
+
+	// lay out both blobs first so the entry table can be written in one go
+	TArray<FEntryRecord> Entries;
+	Entries.SetNumUninitialized(Count);
+	uint64 IdCursor = Header.IdBlobOffset;
+	uint64 MetadataCursor = 0;
+	int32 EntryIndex = 0;
+	for (const FSegmentPtr& Segment : Snapshot.Segments)
+	{
+		for (int32 i = 0; i < Segment->Num(); i++)
+		{
+			FEntryRecord& Entry = Entries[EntryIndex++];
+			Entry.IdLength = Segment->GetIdUTF8(i, Scratch).Num();
+			Entry.MetadataLength = Segment->GetMetadataUTF8(i, Scratch).Num();
+			Entry.IdOffset = IdCursor;
+			Entry.MetadataOffset = MetadataCursor;
+			IdCursor += Entry.IdLength;
+			MetadataCursor += Entry.MetadataLength;
+		}
+	}
+
+	Header.IdBlobSize = IdCursor - Header.IdBlobOffset;
+	Header.VectorsOffset = Align(IdCursor, VectorAlignment);
+	Header.MetadataOffset = Header.VectorsOffset + Count * Dimension * sizeof(float);
+	Header.MetadataSize = MetadataCursor;
+	for (FEntryRecord& Entry : Entries)
+	{
+		Entry.MetadataOffset += Header.MetadataOffset;
+	}
+
+	WriteBytes(*Writer, &Header, sizeof(FStoreHeader));
+	WriteBytes(*Writer, Entries.GetData(), Entries.Num() * sizeof(FEntryRecord));
+
+	for (const FSegmentPtr& Segment : Snapshot.Segments)
+	{
+		for (int32 i = 0; i < Segment->Num(); i++)
+		{
+			const TArrayView<const uint8> Bytes = Segment->GetIdUTF8(i, Scratch);
+			WriteBytes(*Writer, Bytes.GetData(), Bytes.Num());
+		}
+	}
+
+	const uint8 Padding[VectorAlignment] = {};
+	WriteBytes(*Writer, Padding, Header.VectorsOffset - IdCursor);
+
+	for (const FSegmentPtr& Segment : Snapshot.Segments)
+	{
+		WriteBytes(*Writer, Segment->GetVectors(), (int64)Segment->Num() * Dimension * sizeof(float));
+	}
+
+	for (const FSegmentPtr& Segment : Snapshot.Segments)
+	{
+		for (int32 i = 0; i < Segment->Num(); i++)
+		{
+			const TArrayView<const uint8> Bytes = Segment->GetMetadataUTF8(i, Scratch);
+			WriteBytes(*Writer, Bytes.GetData(), Bytes.Num());
+		}
+	}
+
+	const bool bSucceeded = !Writer->IsError();
+	return Writer->Close() && bSucceeded;
+}
+
+bool FOpenAIVectorStore::AddPending(const FString& Id, const FHighDimensionalVector& Vector, const FString& Metadata)
+{
+	const int32 VectorStart = PendingVectors.Num();
+	PendingVectors.Append(Vector.Components);
+	if (bNormalized)
+	{
+		FOpenAIVectorMath::Normalize(PendingVectors.GetData() + VectorStart, Dimension);
+	}
+	PendingIds.Add(Id);
+	PendingMetadata.Add(Metadata);
+
+	return WriteLogRecord(Id, PendingVectors.GetData() + VectorStart, Metadata);
+}
+
+bool FOpenAIVectorStore::Add(const FString& Id, const FHighDimensionalVector& Vector, const FString& Metadata)
+{
+	if (Vector.Components.Num() != Dimension)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::Add expected %d components, got %d"), Dimension, Vector.Components.Num());
+		return false;
+	}
+
+	FScopeLock WriteLock(&WriteMutex);
+
+	const bool bLogged = AddPending(Id, Vector, Metadata);
+	if (PendingIds.Num() >= SegmentSize)
+	{
+		PublishPending();
+	}
+	return bLogged;
+}
+
+bool FOpenAIVectorStore::AddBatch(const TArray<FString>& Ids, const TArray<FHighDimensionalVector>& Vectors, const TArray<FString>& Metadata)
+{
+	if (Ids.Num() != Vectors.Num() || (Metadata.Num() != 0 && Metadata.Num() != Ids.Num()))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::AddBatch needs one vector and at most one metadata entry per id"));
+		return false;
+	}
+	for (const FHighDimensionalVector& Vector : Vectors)
+	{
+		if (Vector.Components.Num() != Dimension)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::AddBatch expected %d components, got %d"), Dimension, Vector.Components.Num());
+			return false;
+		}
+	}
+
+	FScopeLock WriteLock(&WriteMutex);
+
+	bool bLogged = true;
+	for (int32 i = 0; i < Ids.Num(); i++)
+	{
+		bLogged &= AddPending(Ids[i], Vectors[i], Metadata.Num() > 0 ? Metadata[i] : FString());
+	}
+	PublishPending();
+	return bLogged;
+}
+
+void FOpenAIVectorStore::Flush()
+{
+	FScopeLock WriteLock(&WriteMutex);
+	PublishPending();
+	if (LogHandle)
+	{
+		LogHandle->Flush();
+	}
+}
+
+int32 FOpenAIVectorStore::Num() const
+{
+	return GetSnapshot()->Count;
+}
+
+int32 FOpenAIVectorStore::NumPending() const
+{
+	FScopeLock WriteLock(&WriteMutex);
+	return PendingIds.Num();
+}
+
+bool FOpenAIVectorStore::Contains(const FString& Id) const
+{
+	return FindIndex(Id) != INDEX_NONE;
+}
+
+int32 FOpenAIVectorStore::FindIndex(const FString& Id) const
+{
+	const FSnapshotPtr Snapshot = GetSnapshot();
+
+	{
+		FReadScopeLock ReadLock(IdLookupLock);
+		if (NumIdsIndexed >= Snapshot->Count)
+		{
+			const int32* Found = IdLookup.Find(Id);
+			return Found ? *Found : INDEX_NONE;
+		}
+	}
+
+	FWriteScopeLock WriteLock(IdLookupLock);
+	IdLookup.Reserve(Snapshot->Count);
+	for (int32 Index = NumIdsIndexed; Index < Snapshot->Count; Index++)
+	{
+		int32 Local = 0;
+		const FSegment* Segment = Snapshot->Find(Index, Local);
+		IdLookup.Add(Segment->GetId(Local), Index);
+	}
+	NumIdsIndexed = FMath::Max(NumIdsIndexed, Snapshot->Count);
+
+	const int32* Found = IdLookup.Find(Id);
+	return Found ? *Found : INDEX_NONE;
+}
+
+FString FOpenAIVectorStore::GetId(int32 Index) const
+{
+	const FSnapshotPtr Snapshot = GetSnapshot();
+	int32 Local = 0;
+	const FSegment* Segment = Snapshot->Find(Index, Local);
+	return Segment ? Segment->GetId(Local) : FString();
+}
+
+FString FOpenAIVectorStore::GetMetadata(int32 Index) const
+{
+	const FSnapshotPtr Snapshot = GetSnapshot();
+	int32 Local = 0;
+	const FSegment* Segment = Snapshot->Find(Index, Local);
+	return Segment ? Segment->GetMetadata(Local) : FString();
+}
+
+FHighDimensionalVector FOpenAIVectorStore::GetVector(int32 Index) const
+{
+	const FSnapshotPtr Snapshot = GetSnapshot();
+	int32 Local = 0;
+	const FSegment* Segment = Snapshot->Find(Index, Local);
+
+	FHighDimensionalVector Out;
+	if (Segment)
+	{
+		Out.Components = TArray<float>(Segment->GetVectors() + (int64)Local * Dimension, Dimension);
+	}
+	return Out;
+}
+
+TArray<FHDVectorSearchResult> FOpenAIVectorStore::Search(const FHighDimensionalVector& Query, int32 TopK) const
+{
+	if (Query.Components.Num() != Dimension)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::Search expected a %d dimensional query, got %d"), Dimension, Query.Components.Num());
+		return {};
+	}
+
+	FHighDimensionalVector NormalizedQuery(Query.Components);
+	if (bNormalized)
+	{
+		FOpenAIVectorMath::Normalize(NormalizedQuery.Components.GetData(), Dimension);
+	}
+
+	const FSnapshotPtr Snapshot = GetSnapshot();
+
+	TArray<float> Scores;
+	Scores.SetNumUninitialized(Snapshot->Count);
+
+	// every segment is contiguous, mapped ones are scored in place without copying the vectors
+	for (int32 i = 0; i < Snapshot->Segments.Num(); i++)
+	{
+		const FSegment& Segment = *Snapshot->Segments[i];
+		FOpenAIVectorMath::CosineSimilarityBatch(NormalizedQuery.Components.GetData(), Segment.GetVectors(), Segment.Num(), Dimension, bNormalized, Scores.GetData() + Snapshot->Starts[i]);
+	}
+
+	return FOpenAIVectorMath::SelectTopK(Scores, TopK);
+}
+
+TArray<FHDVectorSearchResult> FOpenAIVectorStore::Search(const FHighDimensionalVector& Query, TArrayView<const int32> Indices, int32 TopK) const
+{
+	if (Query.Components.Num() != Dimension)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::Search expected a %d dimensional query, got %d"), Dimension, Query.Components.Num());
+		return {};
+	}
+
+	FHighDimensionalVector NormalizedQuery(Query.Components);
+	if (bNormalized)
+	{
+		FOpenAIVectorMath::Normalize(NormalizedQuery.Components.GetData(), Dimension);
+	}
+
+	const FSnapshotPtr Snapshot = GetSnapshot();
+
+	TArray<int32> Candidates;
+	TArray<const float*> Rows;
+	Candidates.Reserve(Indices.Num());
+	Rows.Reserve(Indices.Num());
+	for (const int32 Index : Indices)
+	{
+		int32 Local = 0;
+		if (const FSegment* Segment = Snapshot->Find(Index, Local))
+		{
+			Candidates.Add(Index);
+			Rows.Add(Segment->GetVectors() + (int64)Local * Dimension);
+		}
+	}
+
+	TArray<float> Scores;
+	Scores.SetNumUninitialized(Rows.Num());
+	FOpenAIVectorMath::CosineSimilarityBatch(NormalizedQuery.Components.GetData(), Rows, Dimension, bNormalized, Scores.GetData());
+
+	TArray<FHDVectorSearchResult> Results = FOpenAIVectorMath::SelectTopK(Scores, TopK);
+	for (FHDVectorSearchResult& Result : Results)
+	{
+		Result.Index = Candidates[Result.Index];
+	}
+	return Results;
+}
+
+TArray<FHDVectorSearchResult> FOpenAIVectorStore::SearchTwoStage(const FHighDimensionalVector& Query, const FTwoStageSearchSettings& Settings) const
+{
+	if (Query.Components.Num() != Dimension)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::SearchTwoStage expected a %d dimensional query, got %d"), Dimension, Query.Components.Num());
+		return {};
+	}
+
+	const int32 CoarseDimensions = FMath::Clamp(Settings.coarseDimensions, 1, Dimension);
+	const int32 ShortlistSize = FMath::Max(Settings.shortlistSize, Settings.topK);
+
+	// the query's own scale and length are the same for every row, so they don't change the ranking
+	TArray<int8> QueryCodes;
+	QueryCodes.SetNumUninitialized(CoarseDimensions);
+	FOpenAIVectorMath::QuantizeInt8(Query.Components.GetData(), CoarseDimensions, QueryCodes.GetData());
+
+	const FSnapshotPtr Snapshot = GetSnapshot();
+	if (Snapshot->Count <= ShortlistSize)
+	{
+		return Search(Query, Settings.topK);
+	}
+
+	TArray<float> Scores;
+	Scores.SetNumUninitialized(Snapshot->Count);
+	for (int32 i = 0; i < Snapshot->Segments.Num(); i++)
+	{
+		const FSegment& Segment = *Snapshot->Segments[i];
+		const TSharedPtr<const FSegment::FCoarseCodes, ESPMode::ThreadSafe> Codes = Segment.GetCoarseCodes(CoarseDimensions, Dimension);
+		FOpenAIVectorMath::DotProductInt8Batch(QueryCodes.GetData(), Codes->Codes.GetData(), Codes->Weights.GetData(), Segment.Num(), CoarseDimensions, Scores.GetData() + Snapshot->Starts[i]);
+	}
+
+	TArray<int32> Shortlist;
+	Shortlist.Reserve(ShortlistSize);
+	for (const FHDVectorSearchResult& Candidate : FOpenAIVectorMath::SelectTopK(Scores, ShortlistSize))
+	{
+		Shortlist.Add(Candidate.Index);
+	}
+
+	// entries keep their index across publishes and compaction, so the shortlist is valid against any later snapshot
+	return Search(Query, Shortlist, Settings.topK);
+}
+
+bool FOpenAIVectorStore::Compact()
+{
+	if (bInMemory)
+	{
+		return true;
+	}
+
+	FScopeLock CompactionLock(&CompactionMutex);
+
+	{
+		FScopeLock WriteLock(&WriteMutex);
+		PublishPending();
+	}
+	const FSnapshotPtr Snapshot = GetSnapshot();
+
+	// the target is the file the previous compaction moved away from, a reader may still hold a snapshot mapping it.
+	// waiting here would hold CompactionMutex for as long as that reader runs, the caller retries instead
+	if (RetiredBase.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::Compact a snapshot from before the last compaction is still in use, try again later"));
+		return false;
+	}
+
+	const FString TargetPath = ActiveFilePath == Path ? GetAlternatePath(Path) : Path;
+	const uint64 NewGeneration = Generation + 1;
+	if (!WriteStoreFile(TargetPath, NewGeneration, *Snapshot))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FOpenAIVectorStore::Compact could not write %s"), *TargetPath);
+		IFileManager::Get().Delete(*TargetPath);
+		return false;
+	}
+
+	uint64 MappedGeneration = 0;
+	bool bMappedNormalized = false;
+	FSegmentPtr NewBase = MapStoreFile(TargetPath, MappedGeneration, bMappedNormalized);
+	if (!NewBase.IsValid())
+	{
+		IFileManager::Get().Delete(*TargetPath);
+		return false;
+	}
+
+	FScopeLock WriteLock(&WriteMutex);
+
+	// entries published while the file was written go into a fresh segment after the new base
+	const FSnapshotPtr Latest = GetSnapshot();
+	TSharedRef<FSnapshot, ESPMode::ThreadSafe> Compacted = MakeShared<FSnapshot, ESPMode::ThreadSafe>();
+	Compacted->AddSegment(NewBase);
+	if (Latest->Count > Snapshot->Count)
+	{
+		TSharedRef<FMemorySegment, ESPMode::ThreadSafe> Tail = MakeShared<FMemorySegment, ESPMode::ThreadSafe>();
+		for (int32 Index = Snapshot->Count; Index < Latest->Count; Index++)
+		{
+			int32 Local = 0;
+			const FSegment* Segment = Latest->Find(Index, Local);
+			Tail->Ids.Add(Segment->GetId(Local));
+			Tail->Metadata.Add(Segment->GetMetadata(Local));
+			Tail->Vectors.Append(Segment->GetVectors() + (int64)Local * Dimension, Dimension);
+		}
+		Compacted->AddSegment(Tail);
+	}
+
+	RetiredBase = Snapshot->Segments.Num() > 0 ? Snapshot->Segments[0] : nullptr;
+	ActiveFilePath = TargetPath;
+	Generation = NewGeneration;
+
+	// the new log holds everything the new file doesn't, until it replaces the old one ReplayLog skips the folded records
+	RewriteLog(*Latest, Snapshot->Count);
+
+	Publish(Compacted);
+	return true;
+}
+
+TFuture<bool> FOpenAIVectorStore::CompactAsync()
+{
+	// the shared pointer keeps the store alive until the background compaction is done
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> KeepAlive = AsShared();
+	return Async(EAsyncExecution::ThreadPool, [KeepAlive]()
+	{
+		return KeepAlive->Compact();
+	});
+}
+
+FString FOpenAIVectorStore::DecodeUTF8(const uint8* Bytes, uint32 Length)
+{
+	if (Length == 0)
+	{
+		return FString();
+	}
+	FUTF8ToTCHAR Converted((const ANSICHAR*)Bytes, Length);
+	return FString(Converted.Length(), Converted.Get());
+}
@@ -4,10 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeLock.h"
 
 class FOpenAIAPIModule : public IModuleInterface
 {
 	friend class UOpenAIUtils;
+	friend class FOpenAIClient;
 public:
 	/** IModuleInterface implementation */
 	virtual void StartupModule() override;
@@ -17,4 +20,7 @@ private:
 	FString _apiKey = "";
 	FString ApiUrl = TEXT("https://api.openai.com/v1/chat/completions");	//default openai endpoint
 	bool _useApiKeyFromEnvVariable = false;
+
+	// FOpenAIClient reads the settings from worker threads
+	mutable FCriticalSection SettingsLock;
 };
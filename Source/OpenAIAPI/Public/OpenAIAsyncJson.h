@@ -0,0 +1,70 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+/**
+ * Runs request building and response parsing on task graph workers, long chat histories and embedding responses
+ * take milliseconds to (de)serialize and used to do so on the game thread.
+ */
+class FOpenAIAsyncJson
+{
+public:
+	/** Calls Build and serializes its result on a worker, OnReady gets the body on the game thread. */
+	static void BuildPayload(TFunction<TSharedPtr<FJsonObject>()> Build, TFunction<void(FString&& Payload)> OnReady)
+	{
+		Async(EAsyncExecution::TaskGraph, [Build = MoveTemp(Build), OnReady = MoveTemp(OnReady)]() mutable
+		{
+			FString Payload;
+			if (TSharedPtr<FJsonObject> PayloadObject = Build())
+			{
+				TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Payload);
+				FJsonSerializer::Serialize(PayloadObject.ToSharedRef(), Writer);
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [Payload = MoveTemp(Payload), OnReady = MoveTemp(OnReady)]() mutable
+			{
+				OnReady(MoveTemp(Payload));
+			});
+		});
+	}
+
+	/**
+	 * Deserializes the response body on a worker and hands it to Parse there, the object is null when the body is not JSON.
+	 * Deliver gets the parsed result on the game thread, or directly on the worker with bDeliverOnWorker.
+	 */
+	template<typename ResultType>
+	static void ParseResponse(FHttpResponsePtr Response, TFunction<ResultType(const TSharedPtr<FJsonObject>& Json)> Parse, TFunction<void(ResultType&& Result)> Deliver, bool bDeliverOnWorker = false)
+	{
+		Async(EAsyncExecution::TaskGraph, [Response, Parse = MoveTemp(Parse), Deliver = MoveTemp(Deliver), bDeliverOnWorker]() mutable
+		{
+			TSharedPtr<FJsonObject> Json;
+			if (Response.IsValid())
+			{
+				TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
+				if (!FJsonSerializer::Deserialize(Reader, Json))
+				{
+					Json.Reset();
+				}
+			}
+
+			ResultType Result = Parse(Json);
+			if (bDeliverOnWorker)
+			{
+				Deliver(MoveTemp(Result));
+				return;
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [Result = MoveTemp(Result), Deliver = MoveTemp(Deliver)]() mutable
+			{
+				Deliver(MoveTemp(Result));
+			});
+		});
+	}
+};
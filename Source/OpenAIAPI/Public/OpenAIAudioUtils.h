@@ -0,0 +1,55 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+
+class USoundWave;
+
+/**
+ * PCM helpers for the audio endpoints. Samples are interleaved floats in [-1, 1].
+ * Everything except GetSoundWaveSamples is safe to call from worker threads.
+ */
+class OPENAIAPI_API FOpenAIAudioUtils
+{
+public:
+	/** 16 bit PCM WAV file in memory. */
+	static TArray<uint8> EncodeWav(TArrayView<const float> Samples, int32 NumChannels, int32 SampleRate);
+
+	/** WAV file around raw little endian 16 bit PCM. */
+	static TArray<uint8> WrapPCM16AsWav(TArrayView<const uint8> PCM, int32 NumChannels, int32 SampleRate);
+
+	/** Reads 8/16/24/32 bit integer or 32 bit float PCM WAV data. Fails for other encodings, OutSamples is empty then. */
+	static bool DecodeWav(TArrayView<const uint8> Wav, TArray<float>& OutSamples, int32& OutSampleRate, int32& OutNumChannels);
+
+	/** Averages the channels of interleaved samples. */
+	static TArray<float> DownmixToMono(TArrayView<const float> Samples, int32 NumChannels);
+
+	/** Band limited (windowed sinc) resampling of mono samples. */
+	static TArray<float> Resample(TArrayView<const float> Samples, int32 FromRate, int32 ToRate);
+
+	/**
+	 * Speech spans found by comparing the energy of 20 ms frames against the noise floor of the clip.
+	 * Quieter frames with a high zero crossing rate count as speech too, so unvoiced consonants are not dropped.
+	 */
+	static TArray<FAudioSpeechSpan> DetectSpeech(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, const FVoiceActivitySettings& Settings);
+
+	/** The audio inside Spans, with the pauses between them shortened to MaxPauseSeconds unless that is 0. */
+	static TArray<float> KeepSpans(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, TArrayView<const FAudioSpeechSpan> Spans, float MaxPauseSeconds);
+
+	/**
+	 * Downmixes, resamples and trims silence in place as configured, returns false when there is nothing to do.
+	 * OutSpans receives the detected speech in seconds of the input audio when silence trimming is on.
+	 */
+	static bool Preprocess(TArray<float>& Samples, int32& SampleRate, int32& NumChannels, const FAudioPreprocessSettings& Settings, TArray<FAudioSpeechSpan>* OutSpans = nullptr);
+
+	/** Interleaved 16 bit PCM to floats. */
+	static void PCM16ToFloat(const int16* PCM, int32 NumSamples, TArray<float>& OutSamples);
+
+	/**
+	 * Copies the decompressed PCM of a sound wave, e.g. one created from a capture or imported at runtime.
+	 * Fails for compressed assets that have not been decoded. Game thread only.
+	 */
+	static bool GetSoundWaveSamples(const USoundWave* SoundWave, TArray<float>& OutSamples, int32& OutSampleRate, int32& OutNumChannels);
+};
@@ -0,0 +1,49 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+#include "Misc/ScopeRWLock.h"
+
+/**
+ * In-memory inverted index scored with Okapi BM25.
+ * Documents are numbered in the order they are added, which lets the index mirror the entries of a vector store.
+ * Terms are lowercased runs of letters, digits, '_' and '-', so names and item ids like "sword_042" stay one term.
+ * Safe to search from any thread while documents are added.
+ */
+class OPENAIAPI_API FOpenAIBM25Index
+{
+public:
+	FOpenAIBM25Index(float InK1 = 1.2f, float InB = 0.75f);
+
+	/**
+	 * Indexes Text as document number Document, which has to be the next one (Num()).
+	 * Anything else is ignored and returns false, so two threads mirroring the same source can't index an entry twice.
+	 */
+	bool AddDocument(int32 Document, const FString& Text);
+
+	int32 Num() const;
+
+	/** Best BM25 matches first, Index is the document number. */
+	TArray<FHDVectorSearchResult> Search(const FString& Query, int32 TopK) const;
+
+	static TArray<FString> Tokenize(const FString& Text);
+
+private:
+	struct FPosting
+	{
+		int32 Document;
+		int32 Frequency;
+	};
+
+	float K1;
+	float B;
+
+	TMap<FString, int32> TermIds;
+	TArray<TArray<FPosting>> Postings;
+	TArray<int32> DocumentLengths;
+	int64 TotalLength = 0;
+
+	mutable FRWLock Lock;
+};
@@ -35,13 +35,19 @@ public:
 	FOnResponseRecievedPin Streaming;
 
 private:
-	int32 LastEmittedIndex = 0;
+	// streamed bytes up to the end of the last complete line, and the message assembled from them
+	int32 StreamBytesParsed = 0;
+	FString StreamedMessage;
+	bool bFinished = false;
 
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
 	static UOpenAICallChat* OpenAICallChat(FChatSettings ChatSettings);
 
 	virtual void Activate() override;
+	void SendRequest(const FString& ApiKey, const FString& Payload);
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	void ProcessStreamBytes(const TArray<uint8>& Content, bool bComplete);
+	void Finish(const FChatCompletion& Completion, const FString& ErrorMessage, bool Success);
 
 	TArray<TSharedPtr<FJsonObject>> ProcessStreamChunkString(const FString& Chunk);
 	TSharedPtr<FJsonObject> ProcessLastChunkStringFromStream(const FString& Chunk);
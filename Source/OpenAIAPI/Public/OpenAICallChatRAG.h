@@ -0,0 +1,69 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAICallChat.h"
+#include "OpenAICallChatRAG.generated.h"
+
+class UOpenAIVectorIndex;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnContextRetrievedPin, const TArray<FVectorIndexMatch>&, Matches);
+
+/**
+ * Retrieval-augmented chat in one node.
+ * Embeds the query, searches the index on a worker thread, adds the best chunks that fit the token budget
+ * as a system message and streams the answer. The connection to the chat endpoint is opened while the query is embedded.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallChatRAG : public UBlueprintAsyncActionBase
+{
+public:
+	GENERATED_BODY()
+
+public:
+	UOpenAICallChatRAG();
+	~UOpenAICallChatRAG();
+
+	FChatSettings ChatSettings;
+	FRetrievalSettings RetrievalSettings;
+	FString Query;
+
+	UPROPERTY()
+	UOpenAIVectorIndex* Index = nullptr;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnContextRetrievedPin ContextRetrieved;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnResponseRecievedPin Streaming;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnResponseRecievedPin Finished;
+
+	/** Builds the system message from Matches, best first, stopping once the token budget would be exceeded. */
+	static FString BuildContext(const TArray<FVectorIndexMatch>& Matches, const FRetrievalSettings& Settings);
+
+private:
+	UPROPERTY()
+	UOpenAICallChat* ChatNode = nullptr;
+
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAICallChatRAG* OpenAICallChatRAG(UOpenAIVectorIndex* Index, FString Query, FChatSettings ChatSettings, FRetrievalSettings RetrievalSettings);
+
+	virtual void Activate() override;
+
+	void PrewarmConnection(const FString& ApiKey) const;
+	void OnQueryEmbedded(const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success);
+	void OnContextRetrieved(const TArray<FVectorIndexMatch>& Matches);
+
+	UFUNCTION()
+	void HandleChatStreaming(const FChatCompletion Message, const FString& ErrorMessage, bool Success);
+
+	UFUNCTION()
+	void HandleChatFinished(const FChatCompletion Message, const FString& ErrorMessage, bool Success);
+
+	void Finish(const FChatCompletion& Message, const FString& ErrorMessage, bool Success);
+};
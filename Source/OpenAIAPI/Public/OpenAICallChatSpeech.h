@@ -0,0 +1,114 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAICallChat.h"
+#include "OpenAICallSpeech.h"
+#include "OpenAICallChatSpeech.generated.h"
+
+class FOpenAIRequestQueue;
+class FOpenAISpeechRequest;
+class USoundWaveProcedural;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnChatSpeechSentencePin, const FString&, Sentence, int32, SentenceIndex);
+
+/**
+ * Streams a chat answer and speaks it while it is still being written.
+ * Deltas are cut into sentences and each finished sentence is sent to the speech endpoint right away,
+ * so synthesis overlaps generation. The pcm audio is queued on one procedural sound in sentence order,
+ * a sentence that arrives early waits in memory until the ones before it are queued.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallChatSpeech : public UBlueprintAsyncActionBase
+{
+public:
+	GENERATED_BODY()
+
+public:
+	UOpenAICallChatSpeech();
+	~UOpenAICallChatSpeech();
+
+	FChatSettings ChatSettings;
+
+	/** input is ignored and the response format is always pcm. */
+	FSpeechSettings VoiceSettings;
+
+	int32 MaxConcurrentSpeech = 2;
+	bool bUseCache = false;
+
+	/** Sentences shorter than this are joined with the next one, fewer requests at the cost of a later first sentence. */
+	int32 MinSentenceChars = 20;
+
+	/** Longer sentences are cut at the last comma, semicolon or colon. */
+	int32 MaxSentenceChars = 300;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnSpeechAudioStartedPin AudioStarted;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnResponseRecievedPin Streaming;
+
+	/** Fires when a sentence is sent to the speech endpoint. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnChatSpeechSentencePin SentenceQueued;
+
+	/** Fires once the answer is complete and all of its audio is queued on the sound. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnResponseRecievedPin Finished;
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Cancel();
+
+	/** Length of the first complete sentence in Text, or INDEX_NONE when Text does not hold one yet. */
+	static int32 FindSentenceEnd(const FString& Text, int32 MinChars, int32 MaxChars);
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAICallChatSpeech* OpenAICallChatSpeech(FChatSettings ChatSettings, FSpeechSettings VoiceSettings, int32 maxConcurrentSpeech = 2, bool useCache = false);
+
+	virtual void Activate() override;
+
+	UFUNCTION()
+	void HandleChatStreaming(const FChatCompletion Message, const FString& ErrorMessage, bool Success);
+
+	UFUNCTION()
+	void HandleChatFinished(const FChatCompletion Message, const FString& ErrorMessage, bool Success);
+
+	void ConsumeText(bool bFlush);
+	void QueueSentence(const FString& Text);
+	void SynthesizeSentence(int32 SentenceIndex, TFunction<void()> Done);
+	void OnSentenceAudio(int32 SentenceIndex, TArrayView<const uint8> Audio);
+	void OnSentenceDone(int32 SentenceIndex, const FString& ErrorMessage, bool Success);
+	void QueueOnSound(TArrayView<const uint8> Audio);
+	void TryFinish();
+	void Finish(const FString& ErrorMessage, bool Success);
+
+	UPROPERTY()
+	UOpenAICallChat* ChatNode = nullptr;
+
+	UPROPERTY()
+	USoundWaveProcedural* Sound = nullptr;
+
+	struct FSentence
+	{
+		FString Text;
+		TArray<uint8> Buffered;
+		bool bDone = false;
+	};
+	TArray<FSentence> Sentences;
+	int32 NextToPlay = 0;
+
+	TSharedPtr<FOpenAIRequestQueue> SpeechQueue;
+	TMap<int32, TSharedPtr<FOpenAISpeechRequest>> ActiveRequests;
+
+	FString StreamedText;
+	FString PendingText;
+	FChatCompletion FinalMessage;
+	FString ChatError;
+	FString LastError;
+	bool bChatDone = false;
+	bool bFinished = false;
+};
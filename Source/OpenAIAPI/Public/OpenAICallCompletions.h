@@ -9,6 +9,7 @@
 #include "OpenAICallCompletions.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnGptResponseRecievedPin, const TArray<FCompletion>&, completions, const FString&, errorMessage, const FCompletionInfo&, completionInfo, bool, Success);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnGptChoicePin, const FCompletion&, completion);
 
 /**
  * 
@@ -29,12 +30,26 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
 		FOnGptResponseRecievedPin Finished;
 
+	/** With settings.stream, the text a choice gained since its last update. index tells the choices apart. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+		FOnGptChoicePin Streaming;
+
+	/** With settings.stream, the full text of a choice as soon as that choice is done, other choices may still be generating. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+		FOnGptChoicePin ChoiceFinished;
+
 private:
 	OpenAIValueMapping mapping;
 
+	// streaming state, the body is parsed up to the last complete line on every progress update
+	TArray<FCompletion> StreamedChoices;
+	FCompletionInfo StreamedInfo;
+	int32 ParsedBytes = 0;
+
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI", meta=(DeprecatedFunction, DeprecationMessage="Function has been deprecated, Please use OpenAICallChat instead"))
 	static UOpenAICallCompletions* OpenAICallCompletions(EOACompletionsEngineType engine, FString prompt, FCompletionSettings settings);
 
 	virtual void Activate() override;
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	void ProcessStream(const TArray<uint8>& Content, bool bComplete);
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAICallCompletionsBatch.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnGptBatchResponseRecievedPin, const TArray<FBatchedCompletion>&, results, const FString&, errorMessage, const FCompletionInfo&, completionInfo, bool, Success);
+
+/**
+ * Completions for a list of prompts in as few requests as the endpoint allows, results are in prompt order.
+ * OpenAICallCompletionsAutoBatched takes a single prompt and lets FOpenAICompletionBatcher pack it with other prompts issued at the same time.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallCompletionsBatch : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAICallCompletionsBatch();
+	~UOpenAICallCompletionsBatch();
+
+	EOACompletionsEngineType engine = EOACompletionsEngineType::TEXT_DAVINCI_003;
+	TArray<FString> prompts;
+	FCompletionSettings settings;
+	bool autoBatch = false;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnGptBatchResponseRecievedPin Finished;
+
+	/** Sends the prompts the auto batcher is still collecting. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static void FlushCompletionsBatcher();
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAICallCompletionsBatch* OpenAICallCompletionsBatch(EOACompletionsEngineType engine, const TArray<FString>& prompts, FCompletionSettings settings);
+
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAICallCompletionsBatch* OpenAICallCompletionsAutoBatched(EOACompletionsEngineType engine, FString prompt, FCompletionSettings settings);
+
+	virtual void Activate() override;
+	void Finish(const TArray<FBatchedCompletion>& Results, const FString& ErrorMessage, const FCompletionInfo& Info, bool Success);
+};
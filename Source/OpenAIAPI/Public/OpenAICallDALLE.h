@@ -8,7 +8,10 @@
 #include "HttpModule.h"
 #include "OpenAICallDALLE.generated.h"
 
+class UTexture2D;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnDalleResponseRecievedPin, const TArray<FString>&, generatedImageUrls, const FString&, errorMessage, bool, Success);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnDalleTexturesReadyPin, const TArray<UTexture2D*>&, textures);
 
 /**
  * 
@@ -27,15 +30,38 @@ public:
 	int32 numImages = 1;
 	FCompletionSettings settings;
 
+	// request b64_json and decode the images on worker threads instead of returning urls
+	bool returnTextures = false;
+	bool generateMips = false;
+
+	// look the prompt up in Saved/ImageCache before sending a request, generated images are stored there
+	bool useCache = false;
+
 	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
 	FOnDalleResponseRecievedPin Finished;
 
+	/** Fires before Finished when returnTextures is set, Finished then has no urls. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnDalleTexturesReadyPin TexturesReady;
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static void SetImageCacheLimit(int32 maxDiskMegabytes = 512);
+
 private:
 	OpenAIValueMapping mapping;
 
+	/** With useCache and without returnTextures the urls are paths of the cached png files, UOpenAIFetchImages loads either. */
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
-	static UOpenAICallDALLE* OpenAICallDALLE(EOAImageSize imageSize, FString prompt, int32 numImages);
+	static UOpenAICallDALLE* OpenAICallDALLE(EOAImageSize imageSize, FString prompt, int32 numImages, bool returnTextures = false, bool generateMips = false, bool useCache = false);
+
+	struct FDecodedImages;
 
 	virtual void Activate() override;
+	void SendRequest(const FString& ApiKey);
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	void DecodeResponse(const FString& Content);
+	void OnCacheHit(TArray<TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>>&& Files);
+	void OnImagesDecoded(FDecodedImages& Result, bool bFromCache);
+	void StoreImages(const FDecodedImages& Result, bool bOnlyMissing, const FString& ErrorMessage, bool Success);
+	void Finish(const TArray<FString>& Urls, const FString& ErrorMessage, bool Success);
 };
@@ -0,0 +1,69 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAICallDALLE.h"
+#include "Interfaces/IHttpRequest.h"
+#include "OpenAICallDALLEEdit.generated.h"
+
+class UTexture;
+
+/**
+ * Image edits and variations of a texture or render target.
+ * The pixels are read back on the render thread and encoded to PNG on workers, the upload is streamed from memory,
+ * so nothing is staged on disk and the game thread never waits on the gpu or the encoder.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallDALLEEdit : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAICallDALLEEdit();
+	~UOpenAICallDALLEEdit();
+
+	UPROPERTY()
+	UTexture* image = nullptr;
+
+	// transparent pixels mark the area to edit, without a mask the image's own alpha is used
+	UPROPERTY()
+	UTexture* mask = nullptr;
+
+	// unused for a variation
+	FString prompt = "";
+	// set by OpenAICallDALLEVariation, sends the image to the variations endpoint without a prompt or mask
+	bool variation = false;
+	EOAImageSize imageSize = EOAImageSize::LARGE;
+	int32 numImages = 1;
+	bool returnTextures = false;
+	bool generateMips = false;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnDalleResponseRecievedPin Finished;
+
+	/** Fires before Finished when returnTextures is set, Finished then has no urls. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnDalleTexturesReadyPin TexturesReady;
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAICallDALLEEdit* OpenAICallDALLEEdit(UTexture* image, UTexture* mask, FString prompt, EOAImageSize imageSize, int32 numImages = 1, bool returnTextures = false, bool generateMips = false);
+
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAICallDALLEEdit* OpenAICallDALLEVariation(UTexture* image, EOAImageSize imageSize, int32 numImages = 1, bool returnTextures = false, bool generateMips = false);
+
+	virtual void Activate() override;
+
+	void OnEncoded();
+	void SendRequest();
+	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	void Finish(const TArray<FString>& Urls, const FString& ErrorMessage, bool Success);
+
+	FString ApiKey;
+	TArray<uint8> ImagePng;
+	TArray<uint8> MaskPng;
+	int32 NumEncoding = 0;
+};
@@ -0,0 +1,75 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAICallSpeech.generated.h"
+
+class FOpenAISpeechRequest;
+class USoundWaveProcedural;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSpeechAudioStartedPin, USoundWaveProcedural*, Sound);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnSpeechResponseRecievedPin, const FSpeechCompletion&, Speech, const FString&, ErrorMessage, bool, Success);
+
+/**
+ * Text to speech. With the pcm response format the audio is queued on a procedural sound wave as it downloads,
+ * AudioStarted hands that sound out with the first samples so playback starts before the request finishes.
+ * Other formats are written to Saved/SpeechAudio once complete.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallSpeech : public UBlueprintAsyncActionBase
+{
+public:
+	GENERATED_BODY()
+
+public:
+	UOpenAICallSpeech();
+	~UOpenAICallSpeech();
+
+	FSpeechSettings SpeechSettings;
+
+	/** Only fires for the pcm response format. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnSpeechAudioStartedPin AudioStarted;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnSpeechResponseRecievedPin Finished;
+
+	/** Stops the download, the sound keeps playing what it already has. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Cancel();
+
+	/** Procedural sound that 24 kHz 16 bit mono pcm is queued on, usable by anything that streams pcm. */
+	static USoundWaveProcedural* CreateStreamingSound();
+
+	/** Synthesizes the lines that are not in the speech cache yet and loads the pcm ones into memory, e.g. at level load. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static void PrewarmSpeechCache(const TArray<FSpeechSettings>& lines, int32 maxConcurrentRequests = 4);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static void SetSpeechCacheLimits(int32 maxDiskMegabytes = 256, int32 maxMemoryMegabytes = 32);
+
+	bool bUseCache = false;
+
+private:
+	/** With useCache, lines that were synthesized before play from Saved/SpeechCache or memory without a request. */
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAICallSpeech* OpenAICallSpeech(FSpeechSettings SpeechSettings, bool useCache = false);
+
+	virtual void Activate() override;
+
+	void StartRequest();
+	void PlayCached(const TArray<uint8>& Audio);
+
+	void OnAudio(TArrayView<const uint8> Audio);
+	void OnDone(const TArray<uint8>& Audio, const FString& ErrorMessage, bool Success);
+	void Finish(const FSpeechCompletion& Speech, const FString& ErrorMessage, bool Success);
+
+	UPROPERTY()
+	USoundWaveProcedural* Sound = nullptr;
+
+	TSharedPtr<FOpenAISpeechRequest> Request;
+	bool bFinished = false;
+};
@@ -5,10 +5,15 @@
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
 #include "HttpModule.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIMultipartForm.h"
 #include "OpenAICallTranscriptions.generated.h"
 
 
+class USoundWave;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnTranscriptionResponseRecievedPin, const FString, Transcription, const FString&, errorMessage, bool, Success);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSpeechDetectedPin, const TArray<FAudioSpeechSpan>&, SpeechSpans);
 /**
  * 
  */
@@ -23,16 +28,36 @@ public:
 	~UOpenAICallTranscriptions();
 
 	FString fileName;
+
+	// in-memory input, used instead of fileName when Samples is not empty
+	TArray<float> Samples;
+	int32 SampleRate = 16000;
+	int32 NumChannels = 1;
+
+	FAudioPreprocessSettings preprocess;
 	
 	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
 	FOnTranscriptionResponseRecievedPin Finished;
 
+	/** Fires before the upload when silence trimming is on. Finished follows with an empty transcription when no speech was found. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnSpeechDetectedPin SpeechDetected;
+
 private:
 	
-	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
-	static UOpenAICallTranscriptions* OpenAICallTranscriptions(FString fileName);
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", AutoCreateRefTerm = "preprocess"), Category = "OpenAI")
+	static UOpenAICallTranscriptions* OpenAICallTranscriptions(FString fileName, const FAudioPreprocessSettings& preprocess);
+
+	/** Transcribes interleaved float samples in [-1, 1] without writing them to disk. */
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", AutoCreateRefTerm = "preprocess"), Category = "OpenAI")
+	static UOpenAICallTranscriptions* OpenAICallTranscriptionsFromSamples(const TArray<float>& samples, const FAudioPreprocessSettings& preprocess, int32 sampleRate = 48000, int32 numChannels = 1);
+
+	/** Transcribes the decompressed PCM of a sound wave, e.g. a capture or a runtime import. */
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", AutoCreateRefTerm = "preprocess"), Category = "OpenAI")
+	static UOpenAICallTranscriptions* OpenAICallTranscriptionsFromSoundWave(USoundWave* soundWave, const FAudioPreprocessSettings& preprocess);
 
 	virtual void Activate() override;
+	void SendRequest(const FString& ApiKey, const FOpenAIMultipartForm& Form);
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
 	
 };
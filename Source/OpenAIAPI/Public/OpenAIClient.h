@@ -0,0 +1,136 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+#include "Async/Future.h"
+#include "Tasks/Task.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define OPENAI_WITH_COROUTINES 1
+#else
+#define OPENAI_WITH_COROUTINES 0
+#endif
+
+class FJsonObject;
+
+/** Outcome of one FOpenAIClient call, Value is only meaningful when bSuccess is set. */
+template<typename ValueType>
+struct TOpenAIResult
+{
+	ValueType Value;
+	FString ErrorMessage;
+	bool bSuccess = false;
+
+	static TOpenAIResult Error(const FString& InErrorMessage)
+	{
+		TOpenAIResult Result;
+		Result.ErrorMessage = InErrorMessage;
+		return Result;
+	}
+};
+
+/**
+ * C++ access to the endpoints without a UObject, dynamic delegate or root per request. Callable from any thread.
+ * Every call returns a future that is fulfilled on a worker once the response is parsed, so calls can be chained with Next/Then,
+ * fanned out and joined, turned into a UE::Tasks task with AsTask, or awaited in a C++20 coroutine with Await.
+ */
+class OPENAIAPI_API FOpenAIClient
+{
+public:
+	/** stream is ignored, the future holds the whole message. */
+	static TFuture<TOpenAIResult<FChatCompletion>> Chat(const FChatSettings& Settings);
+
+	/** Choices for a single prompt. stream is ignored. */
+	static TFuture<TOpenAIResult<TArray<FCompletion>>> Completions(EOACompletionsEngineType Engine, const FString& Prompt, const FCompletionSettings& Settings);
+
+	static TFuture<TOpenAIResult<FEmbeddingResult>> Embeddings(const FEmbeddingSettings& Settings);
+
+	/** Urls of the generated images. */
+	static TFuture<TOpenAIResult<TArray<FString>>> Images(const FString& Prompt, EOAImageSize Size, int32 NumImages = 1);
+
+	/** Encoded audio in Settings.responseFormat. The request is started on the game thread. */
+	static TFuture<TOpenAIResult<TArray<uint8>>> Speech(const FSpeechSettings& Settings);
+
+	/** Transcribes wav file bytes held in memory. */
+	static TFuture<TOpenAIResult<FString>> Transcription(TArray<uint8>&& Wav, const FString& FileName = TEXT("audio.wav"));
+
+	/** Transcribes an audio file, streamed from disk while the request uploads. */
+	static TFuture<TOpenAIResult<FString>> TranscriptionFromFile(const FString& FilePath);
+
+	/** Request bodies and response parsing shared with the blueprint nodes. */
+	static TSharedPtr<FJsonObject> MakeChatPayload(const FChatSettings& Settings);
+	static TSharedPtr<FJsonObject> MakeEmbeddingPayload(const FEmbeddingSettings& Settings);
+	static TOpenAIResult<FChatCompletion> ParseChat(const TSharedPtr<FJsonObject>& Json, const FChatSettings& Settings);
+	static TOpenAIResult<FEmbeddingResult> ParseEmbeddings(const TSharedPtr<FJsonObject>& Json);
+
+	/** Task that completes with the future's result. No worker blocks while the request is in flight, the task is only scheduled once it is fulfilled. */
+	template<typename ResultType>
+	static UE::Tasks::TTask<ResultType> AsTask(TFuture<ResultType>&& Future)
+	{
+		TSharedRef<TOptional<ResultType>, ESPMode::ThreadSafe> Value = MakeShared<TOptional<ResultType>, ESPMode::ThreadSafe>();
+		UE::Tasks::FTaskEvent Ready(TEXT("FOpenAIClient::AsTask"));
+		UE::Tasks::TTask<ResultType> Task = UE::Tasks::Launch(TEXT("FOpenAIClient::AsTask"), [Value]()
+		{
+			return MoveTemp(Value->GetValue());
+		}, UE::Tasks::Prerequisites(Ready));
+
+		Future.Next([Value, Ready](ResultType Result) mutable
+		{
+			Value->Emplace(MoveTemp(Result));
+			Ready.Trigger();
+		});
+		return Task;
+	}
+
+#if OPENAI_WITH_COROUTINES
+	/** co_await FOpenAIClient::Await(FOpenAIClient::Chat(Settings)). The coroutine resumes on the thread that fulfilled the future. */
+	template<typename ResultType>
+	struct TAwaitable
+	{
+		explicit TAwaitable(TFuture<ResultType>&& InFuture)
+			: Future(MoveTemp(InFuture))
+		{
+		}
+
+		bool await_ready() const
+		{
+			return Future.IsReady();
+		}
+
+		void await_suspend(std::coroutine_handle<> Handle)
+		{
+			// the awaitable lives in the suspended coroutine's frame until it resumes,
+			// the future is moved out first since the continuation may run and resume before Next returns
+			TFuture<ResultType> Local = MoveTemp(Future);
+			Local.Next([this, Handle](ResultType Value)
+			{
+				Result.Emplace(MoveTemp(Value));
+				Handle.resume();
+			});
+		}
+
+		ResultType await_resume()
+		{
+			return Result.IsSet() ? MoveTemp(Result.GetValue()) : Future.Consume();
+		}
+
+	private:
+		TFuture<ResultType> Future;
+		TOptional<ResultType> Result;
+	};
+
+	template<typename ResultType>
+	static TAwaitable<ResultType> Await(TFuture<ResultType>&& Future)
+	{
+		return TAwaitable<ResultType>(MoveTemp(Future));
+	}
+#endif
+
+private:
+	/** Copies taken under the module's settings lock, UOpenAIUtils may change them on the game thread at any time. */
+	static FString GetApiKey();
+	static FString GetApiUrl();
+};
@@ -0,0 +1,72 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+#include "Containers/Ticker.h"
+
+class FJsonObject;
+
+/**
+ * Completions for many prompts sharing one FCompletionSettings, sent as prompt arrays instead of one request per prompt.
+ * The endpoint returns numCompletions choices per prompt, choice index / numCompletions is the prompt they belong to.
+ */
+class OPENAIAPI_API FOpenAICompletionBatch
+{
+public:
+	/** Longer prompt lists are split into several requests that run concurrently. */
+	static constexpr int32 MaxPromptsPerRequest = 20;
+
+	/** Completions[i] holds the choices for Prompts[i], prompts of a failed request are left empty. Runs on the game thread. */
+	using FOnDone = TFunction<void(TArray<TArray<FCompletion>>&& Completions, const FCompletionInfo& Info, const FString& ErrorMessage, bool Success)>;
+
+	static void Send(EOACompletionsEngineType Engine, const TArray<FString>& Prompts, const FCompletionSettings& Settings, FOnDone OnDone);
+
+	/** Empty when the settings can be sent. */
+	static FString Validate(EOACompletionsEngineType Engine, const FCompletionSettings& Settings);
+
+	static FString GetEngineName(EOACompletionsEngineType Engine);
+
+	/** Request body without the prompt. */
+	static TSharedRef<FJsonObject> MakePayload(const FCompletionSettings& Settings);
+};
+
+/**
+ * Collects single prompts issued around the same time and sends them as batches.
+ * Prompts with the same engine and settings are grouped, a group is sent after Window seconds or once it is full. Game thread only.
+ */
+class OPENAIAPI_API FOpenAICompletionBatcher
+{
+public:
+	using FOnCompletions = TFunction<void(const TArray<FCompletion>& Completions, const FCompletionInfo& Info, const FString& ErrorMessage, bool Success)>;
+
+	static FOpenAICompletionBatcher& Get();
+	~FOpenAICompletionBatcher();
+
+	void Enqueue(EOACompletionsEngineType Engine, const FString& Prompt, const FCompletionSettings& Settings, FOnCompletions OnDone);
+
+	/** Sends every waiting group now. */
+	void Flush();
+
+	/** Seconds a group waits for more prompts. */
+	float Window = 0.05f;
+
+private:
+	FOpenAICompletionBatcher() = default;
+
+	struct FGroup
+	{
+		EOACompletionsEngineType Engine;
+		FCompletionSettings Settings;
+		TArray<FString> Prompts;
+		TArray<FOnCompletions> Callbacks;
+		double FirstQueued = 0.0;
+	};
+
+	static void SendGroup(FGroup&& Group);
+	bool Tick(float DeltaTime);
+
+	TMap<FString, FGroup> Groups;
+	FTSTicker::FDelegateHandle TickHandle;
+};
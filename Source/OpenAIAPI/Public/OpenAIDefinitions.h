@@ -81,6 +81,17 @@ enum class EOASpeechVoice : uint8
 	SHIMMER = 5 UMETA(ToolTip = "Generates 1024x1024 images. This setting takes the longest amount of time to generate images.")
 };
 
+UENUM(BlueprintType)
+enum class EOASpeechResponseFormat : uint8
+{
+	MP3 = 0,
+	OPUS = 1,
+	AAC = 2,
+	FLAC = 3,
+	WAV = 4,
+	PCM = 5 UMETA(ToolTip = "Raw 24 kHz 16 bit mono samples. Can be played while it downloads."),
+};
+
 // Structs for GPT
 
 USTRUCT(BlueprintType)
@@ -217,6 +228,10 @@ struct FCompletionSettings
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	int32 bestOf = 1;
 
+	/** Sends each choice's text as it is generated instead of waiting for the whole response. Ignored when bestOf is above 1. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	bool stream = false;
+
 };
 
 USTRUCT(BlueprintType)
@@ -297,6 +312,9 @@ struct FSpeechSettings
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	float speed = 1.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	EOASpeechResponseFormat responseFormat = EOASpeechResponseFormat::MP3;
 };
 
 /*
@@ -375,6 +393,10 @@ struct FEmbeddingSettings
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	FString input = "";
+
+	// when set, every entry is embedded in a single request and input is ignored
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	TArray<FString> inputs;
 };
 
 USTRUCT(BlueprintType)
@@ -399,6 +421,43 @@ struct FHighDimensionalVector
 	}
 };
 
+/** Vectors of equal dimension stored row after row, so batches can be scored in one sweep over memory. */
+USTRUCT(BlueprintType)
+struct FHighDimensionalVectorMatrix
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 Dimension = 0;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	TArray<float> Components;
+
+	int32 NumRows() const
+	{
+		return Dimension > 0 ? Components.Num() / Dimension : 0;
+	}
+
+	const float* GetRow(int32 Row) const
+	{
+		return Components.GetData() + (int64)Row * Dimension;
+	}
+
+	bool AddRow(const FHighDimensionalVector& Vector)
+	{
+		if (Dimension == 0)
+		{
+			Dimension = Vector.Components.Num();
+		}
+		if (Vector.Components.Num() != Dimension)
+		{
+			return false;
+		}
+		Components.Append(Vector.Components);
+		return true;
+	}
+};
+
 USTRUCT(BlueprintType)
 struct FEmbeddingResult
 {
@@ -407,6 +466,10 @@ struct FEmbeddingResult
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	FHighDimensionalVector embeddingVector;
 
+	// one vector per entry of FEmbeddingSettings::inputs, in the same order
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	TArray<FHighDimensionalVector> embeddingVectors;
+
 	FEmbeddingResult(const TArray<float>& VectorArray)
 	{
 		embeddingVector = FHighDimensionalVector(VectorArray);
@@ -415,4 +478,331 @@ struct FEmbeddingResult
 	{
 		embeddingVector = FHighDimensionalVector();
 	}
-};
\ No newline at end of file
+};
+
+UENUM(BlueprintType)
+enum class EOAVectorQuantization : uint8
+{
+	FP16 = 0 UMETA(ToolTip = "Half precision components. 2 bytes per component, close to lossless."),
+	INT8 = 1 UMETA(ToolTip = "Symmetric 8-bit components with a per-vector scale. 1 byte per component."),
+	PRODUCT = 2 UMETA(ToolTip = "Product quantization. 1 byte per subspace, requires a trained FProductQuantizer."),
+};
+
+USTRUCT(BlueprintType)
+struct FQuantizedHighDimensionalVector
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	EOAVectorQuantization Format = EOAVectorQuantization::INT8;
+
+	/** Number of float components of the source vector. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 Dimension = 0;
+
+	/** Packed halves (FP16), signed bytes (INT8) or one centroid index per subspace (PRODUCT). */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	TArray<uint8> Codes;
+
+	/** Per-vector scale for INT8, a code of c decodes to c * Scale. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float Scale = 1.0f;
+
+	/** Length of the reconstructed vector, cached so cosine similarity doesn't need a second pass. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float Length = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct FProductQuantizer
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 Dimension = 0;
+
+	/** Dimension must be divisible by the number of subspaces. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 NumSubspaces = 0;
+
+	/** Centroids per subspace, at most 256 so a code fits in a byte. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 NumCentroids = 0;
+
+	/** NumSubspaces x NumCentroids x SubDimension floats, subspace major. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	TArray<float> Centroids;
+
+	int32 GetSubDimension() const
+	{
+		return NumSubspaces > 0 ? Dimension / NumSubspaces : 0;
+	}
+
+	bool IsValid() const
+	{
+		return NumSubspaces > 0 && NumCentroids > 0 && NumCentroids <= 256 && Dimension % NumSubspaces == 0 &&
+			Centroids.Num() == NumSubspaces * NumCentroids * GetSubDimension();
+	}
+};
+
+USTRUCT(BlueprintType)
+struct FHDVectorSearchResult
+{
+	GENERATED_USTRUCT_BODY();
+
+	/** Index into the searched candidate array. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 Index = -1;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float Score = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct FVectorIndexMatch
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString Id;
+
+	/** Text stored alongside the vector, the chunk that was embedded. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString Text;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float Score = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct FRetrievalSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	/** Must be the model the index was built with. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	EEmbeddingEngineType embeddingModel = EEmbeddingEngineType::TEXT_EMBEDDING_3_SMALL;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 topK = 5;
+
+	/** Chunks with a cosine similarity below this are not added to the context, ignored for hybrid search. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float minScore = 0.0f;
+
+	/** Upper bound for the retrieved context, estimated at four characters per token. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 contextTokenBudget = 1500;
+
+	/** Put in front of the retrieved chunks in the system message. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString contextPreamble = TEXT("Answer using the following context where it is relevant.");
+
+	/** Fuse BM25 keyword matches with the vector search, so exact names and ids in the query are found. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	bool hybridSearch = false;
+};
+
+USTRUCT(BlueprintType)
+struct FIngestionSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	/** Must match the model used to query the index. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	EEmbeddingEngineType embeddingModel = EEmbeddingEngineType::TEXT_EMBEDDING_3_SMALL;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 chunkTokens = 400;
+
+	/** Tokens repeated from the end of the previous chunk, so text cut at a boundary is still found. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 overlapTokens = 50;
+
+	/** Chunks sent in one embedding request. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 batchSize = 64;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 maxConcurrentRequests = 4;
+
+	/** 0 for no limit. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 requestsPerMinute = 500;
+
+	/** Attempts per batch before it is given up on, with an exponential backoff in between. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 maxRetries = 3;
+};
+
+USTRUCT(BlueprintType)
+struct FHybridSearchSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 topK = 5;
+
+	/** Results taken from each of the lexical and vector rankings before they are fused. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 candidatesPerRanking = 50;
+
+	/** Reciprocal rank fusion constant, higher values flatten the difference between top and lower ranks. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float rankConstant = 60.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float lexicalWeight = 1.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float vectorWeight = 1.0f;
+
+	/** Only score vectors of entries that matched a query term, falls back to a full scan when nothing matched. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	bool lexicalPrefilter = false;
+
+	/** Lexical candidates kept by the prefilter. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 prefilterCandidates = 500;
+};
+
+USTRUCT(BlueprintType)
+struct FTwoStageSearchSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 topK = 5;
+
+	/**
+	 * Leading components used by the coarse scan, stored as int8.
+	 * The text-embedding-3 models are trained so a prefix of the vector is still a usable embedding.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 coarseDimensions = 256;
+
+	/** Best coarse candidates rescored with the full vectors. Larger is closer to an exact search. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 shortlistSize = 100;
+};
+
+USTRUCT(BlueprintType)
+struct FAudioSpeechSpan
+{
+	GENERATED_USTRUCT_BODY();
+
+	/** Seconds from the start of the input audio. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float startTime = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float endTime = 0.0f;
+};
+
+/** Energy and zero crossing voice activity detection, tuned for close talking microphones. */
+USTRUCT(BlueprintType)
+struct FVoiceActivitySettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	/** Frames louder than the estimated noise floor by this much are speech. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float thresholdDb = 12.0f;
+
+	/** Pauses shorter than this do not end a speech span. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float minSilenceSeconds = 0.3f;
+
+	/** Shorter bursts are treated as noise. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float minSpeechSeconds = 0.1f;
+
+	/** Kept around every span so soft onsets and word endings are not cut. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float paddingSeconds = 0.2f;
+};
+
+USTRUCT(BlueprintType)
+struct FAudioPreprocessSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	/** Decode, downmix and resample the audio on a worker thread before it is uploaded. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	bool enabled = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	bool downmixToMono = true;
+
+	/** Whisper works at 16 kHz internally, higher rates only add upload bytes. 0 keeps the source rate. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 sampleRate = 16000;
+
+	/** Cut leading and trailing silence. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	bool trimSilence = false;
+
+	/** Pauses between speech spans are shortened to this, 0 keeps them. Only used with trimSilence. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float maxPauseSeconds = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FVoiceActivitySettings voiceActivity;
+};
+
+USTRUCT(BlueprintType)
+struct FTranscriptionSegment
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString text = "";
+
+	/** Seconds from the start of the input audio. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float startTime = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float endTime = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct FLongTranscriptionSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	/** Longest piece sent in one request. Pieces end in pauses, speech longer than this is cut hard. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float maxSegmentSeconds = 120.0f;
+
+	/** The audio is downmixed to mono and resampled to this before it is split. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 sampleRate = 16000;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 maxConcurrentRequests = 4;
+
+	/** 0 leaves the start rate unlimited. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 requestsPerMinute = 50;
+
+	/** Attempts per piece, failed attempts back off exponentially. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 maxRetries = 3;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FVoiceActivitySettings voiceActivity;
+};
+
+USTRUCT(BlueprintType)
+struct FBatchedCompletion
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString prompt = "";
+
+	/** numCompletions choices for the prompt, index is the choice within the prompt. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	TArray<FCompletion> completions;
+};
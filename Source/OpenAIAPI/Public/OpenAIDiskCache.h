@@ -0,0 +1,62 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Directory of cached response files with a size budget, least recently used files are deleted first.
+ * File modification times double as access times, so the order survives restarts.
+ * The index lives on the game thread, files are read and written on the thread pool.
+ * A file is written under a temporary name and moved into place, reads of a key that is still being written get the bytes in memory.
+ */
+class OPENAIAPI_API FOpenAIDiskCache : public TSharedFromThis<FOpenAIDiskCache>
+{
+public:
+	using FData = TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>;
+
+	/** Directory relative paths are under Saved/. */
+	static TSharedRef<FOpenAIDiskCache> Create(const FString& Directory, int64 MaxBytes);
+
+	/** Keys are file names, e.g. a hash and an extension. */
+	bool Contains(const FString& Key);
+	FString GetFilePath(const FString& Key) const;
+
+	/** Calls OnRead on the game thread with the file contents, or null when the key is unknown or the read failed. */
+	void Read(const FString& Key, TFunction<void(FData Data)> OnRead);
+
+	/** Stores Data under Key and evicts down to the budget. OnWritten runs on the game thread. */
+	void Write(const FString& Key, FData Data, TFunction<void(bool Success)> OnWritten = nullptr);
+
+	void SetMaxBytes(int64 InMaxBytes);
+	int64 GetTotalBytes() const { return TotalBytes; }
+
+private:
+	FOpenAIDiskCache(const FString& InDirectory, int64 InMaxBytes);
+
+	void BuildIndex();
+	void Touch(const FString& Key, int64 Size);
+	void Evict(const FString& Keep = FString());
+
+	struct FEntry
+	{
+		int64 Size = 0;
+		FDateTime LastAccess;
+	};
+
+	struct FPendingWrite
+	{
+		FData Data;
+		uint32 Serial = 0;
+	};
+
+	FString Directory;
+	int64 MaxBytes = 0;
+	int64 TotalBytes = 0;
+	bool bIndexed = false;
+	TMap<FString, FEntry> Entries;
+
+	// keys whose file is not in place yet, Serial tells the latest of several writes to the same key apart
+	TMap<FString, FPendingWrite> Writing;
+	uint32 NextWriteSerial = 0;
+};
@@ -44,10 +44,15 @@ public:
 private:
 	FEmbeddingSettings EmbeddingSettings;
 
+	void SendRequest(const FString& ApiKey, const FString& Payload);
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
 
+	// OnResponseReceivedF runs on the worker that parsed the response instead of the game thread
+	bool bDeliverOnWorker = false;
+
 public:
-	static UOpenAIEmbedding* Embedding(const FEmbeddingSettings& EmbeddingSettings, TFunction<void(const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)> Callback);
+	/** With bCallbackOnWorker the callback runs on the task graph worker that parsed the response, e.g. to feed a vector store without a game thread hop. */
+	static UOpenAIEmbedding* Embedding(const FEmbeddingSettings& EmbeddingSettings, TFunction<void(const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)> Callback, bool bCallbackOnWorker = false);
 
 private:
 	void HandleRequestProgress(FHttpRequestPtr Request, uint64 BytesSent, uint64 BytesReceived);
@@ -0,0 +1,72 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "Interfaces/IHttpRequest.h"
+#include "OpenAIFetchImages.generated.h"
+
+class FOpenAIRequestQueue;
+class UTexture2D;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnFetchImageReadyPin, UTexture2D*, texture, int32, index);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnFetchImagesFinishedPin, const TArray<UTexture2D*>&, textures, const FString&, errorMessage, bool, Success);
+
+/**
+ * Downloads image urls, e.g. the results of OpenAICallDALLE, and turns them into textures. Local file paths are loaded from disk.
+ * Downloads run concurrently under a limit shared by every fetch, each image is decoded on the task graph
+ * as soon as its download completes and handed out through ImageReady, so a gallery fills in progressively.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAIFetchImages : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAIFetchImages();
+	~UOpenAIFetchImages();
+
+	/** Downloads in flight across all fetches. */
+	static constexpr int32 MaxConcurrentDownloads = 6;
+
+	TArray<FString> urls;
+	bool generateMips = false;
+
+	/** Fires for every decoded image in completion order, index is the position of its url. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnFetchImageReadyPin ImageReady;
+
+	/** Textures in url order, failed downloads are left null. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnFetchImagesFinishedPin Finished;
+
+	/** Drops the downloads that have not started, Finished fires once the ones in flight are back. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Cancel();
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAIFetchImages* OpenAIFetchImages(const TArray<FString>& urls, bool generateMips = false);
+
+	virtual void Activate() override;
+
+	static FOpenAIRequestQueue& GetDownloadQueue();
+
+	void Download(int32 Index, TFunction<void()> Done);
+	void OnDownloaded(int32 Index, FHttpResponsePtr Response, bool WasSuccessful);
+	void Decode(int32 Index, FHttpResponsePtr Response);
+	void OnImageDone(int32 Index, UTexture2D* Texture, const FString& Error);
+	void Finish();
+
+	UPROPERTY()
+	TArray<UTexture2D*> Textures;
+
+	int32 NumExpected = 0;
+	int32 NumStarted = 0;
+	int32 NumDone = 0;
+	int32 NumFailed = 0;
+	FString LastError;
+	bool bCancelled = false;
+	bool bFinished = false;
+};
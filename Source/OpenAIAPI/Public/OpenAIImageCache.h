@@ -0,0 +1,36 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIDiskCache.h"
+
+/**
+ * Cache in front of the image generation endpoint, keyed by prompt, image size and the index of the image in the response.
+ * The png files live under Saved/ImageCache with an LRU size budget. Game thread only.
+ */
+class OPENAIAPI_API FOpenAIImageCache
+{
+public:
+	using FImage = FOpenAIDiskCache::FData;
+
+	static FOpenAIImageCache& Get();
+
+	void SetMaxBytes(int64 MaxDiskBytes);
+
+	/** File name the image is cached under. */
+	static FString MakeKey(const FString& Prompt, EOAImageSize Size, int32 Index);
+	FString GetFilePath(const FString& Prompt, EOAImageSize Size, int32 Index) const;
+
+	/** Calls OnFound with the first NumImages images for the prompt, or an empty array unless every one of them is cached. */
+	void Find(const FString& Prompt, EOAImageSize Size, int32 NumImages, TFunction<void(TArray<FImage> Images)> OnFound);
+
+	/** Stores the png bytes of one generated image. OnWritten runs once the file is on disk. */
+	void Store(const FString& Prompt, EOAImageSize Size, int32 Index, FImage Image, TFunction<void(bool Success)> OnWritten = nullptr);
+
+private:
+	FOpenAIImageCache();
+
+	TSharedRef<FOpenAIDiskCache> Disk;
+};
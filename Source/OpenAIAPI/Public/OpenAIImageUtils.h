@@ -0,0 +1,47 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IImageWrapperModule;
+class UTexture;
+class UTexture2D;
+
+/**
+ * Image decoding for the image endpoints. Decoding and mip generation run anywhere,
+ * only creating the texture needs the game thread.
+ */
+class OPENAIAPI_API FOpenAIImageUtils
+{
+public:
+	/** BGRA8 pixels, mip 0 first. */
+	struct FDecodedImage
+	{
+		int32 Width = 0;
+		int32 Height = 0;
+		TArray<TArray<uint8>> Mips;
+	};
+
+	/** Loads the module, call on the game thread before handing it to workers. */
+	static IImageWrapperModule& GetImageWrapperModule();
+
+	/** Decodes PNG, JPEG or any other format the image wrapper detects. With bGenerateMips the full chain is box filtered down to 1x1. */
+	static bool DecodeImage(IImageWrapperModule& ImageWrapperModule, TArrayView<const uint8> Compressed, bool bGenerateMips, FDecodedImage& OutImage);
+
+	/** Base64 text, e.g. a b64_json field, decoded to pixels. */
+	static bool DecodeBase64Image(IImageWrapperModule& ImageWrapperModule, const FString& Base64, bool bGenerateMips, FDecodedImage& OutImage);
+
+	/** Transient texture holding every decoded mip. Game thread only. */
+	static UTexture2D* CreateTexture(FDecodedImage&& Image);
+
+	/** BGRA8 pixels, Pixels.Num() must be Width * Height. */
+	static TArray<uint8> EncodePNG(IImageWrapperModule& ImageWrapperModule, TArrayView<const FColor> Pixels, int32 Width, int32 Height);
+
+	/**
+	 * Reads mip 0 of a texture or render target back from the gpu on the render thread and encodes it as PNG on the thread pool,
+	 * the game thread neither waits for the gpu nor for the encoder. OnEncoded runs on the game thread, with an empty array on failure.
+	 * Block compressed textures can't be read back, render them to a render target first.
+	 */
+	static void EncodeTexturePNG(UTexture* Texture, TFunction<void(TArray<uint8>&& Png)> OnEncoded);
+};
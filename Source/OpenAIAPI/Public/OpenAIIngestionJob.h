@@ -0,0 +1,75 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIIngestionJob.generated.h"
+
+class UOpenAIVectorIndex;
+class FOpenAIRequestQueue;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnIngestionProgressPin, int32, ChunksDone, int32, ChunksTotal);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnIngestionFinishedPin, int32, ChunksAdded, const FString&, ErrorMessage, bool, Success);
+
+/**
+ * Background ingestion of text documents into a vector index.
+ * Documents are loaded and chunked on worker threads, chunks are identified by their hash so duplicates
+ * and chunks already in the index are skipped, and the rest is embedded in batches under the request limits.
+ * Every finished batch is flushed to the index log, so running the job again after a crash resumes where it stopped.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAIIngestionJob : public UBlueprintAsyncActionBase
+{
+public:
+	GENERATED_BODY()
+
+public:
+	UOpenAIIngestionJob();
+	~UOpenAIIngestionJob();
+
+	UPROPERTY()
+	UOpenAIVectorIndex* Index = nullptr;
+
+	TArray<FString> FilePaths;
+
+	/** Text ingested alongside FilePaths, for C++ callers that already have the documents in memory. */
+	TArray<FString> Documents;
+
+	FIngestionSettings Settings;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnIngestionProgressPin Progress;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnIngestionFinishedPin Finished;
+
+	/** Stops queuing batches, batches already sent are still written to the index. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Cancel();
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAIIngestionJob* OpenAIIngestDocuments(UOpenAIVectorIndex* Index, TArray<FString> FilePaths, FIngestionSettings Settings);
+
+	virtual void Activate() override;
+
+	void OnChunked(TArray<FString>&& Ids, TArray<FString>&& Texts);
+	void SendBatch(int32 BatchStart, int32 Attempt, TFunction<void()> Done);
+	void OnBatchDone();
+	void Finish();
+
+	TArray<FString> ChunkIds;
+	TArray<FString> ChunkTexts;
+	TSharedPtr<FOpenAIRequestQueue> RequestQueue;
+
+	int32 NumBatches = 0;
+	int32 NumBatchesDone = 0;
+	int32 NumChunksDone = 0;
+	int32 NumChunksAdded = 0;
+	int32 NumBatchesFailed = 0;
+	FString LastError;
+	bool bCancelled = false;
+	bool bFinished = false;
+};
@@ -0,0 +1,57 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/Archive.h"
+
+class IHttpRequest;
+
+/**
+ * multipart/form-data body that is streamed into the request instead of being built in one buffer.
+ * Fields and part headers are kept as UTF-8 bytes, files are read from disk in place while the request uploads,
+ * so uploading a recording never holds more than the file reader's buffer of it in memory.
+ */
+class OPENAIAPI_API FOpenAIMultipartForm
+{
+public:
+	FOpenAIMultipartForm();
+
+	void AddField(const FString& Name, const FString& Value);
+
+	/** File part read from FilePath when the request streams its body. Fails when the file does not exist. */
+	bool AddFile(const FString& Name, const FString& FileName, const FString& ContentType, const FString& FilePath);
+
+	/** File part uploaded from memory. */
+	void AddFileData(const FString& Name, const FString& FileName, const FString& ContentType, TArray<uint8>&& Data);
+
+	/** Value for the Content-Type header, includes the boundary. */
+	FString GetContentType() const;
+
+	/** Size of the whole body in bytes. */
+	int64 GetContentLength() const;
+
+	/** Sets the Content-Type header and the streamed body on Request, the form can be discarded afterwards. */
+	bool ApplyTo(IHttpRequest& Request) const;
+
+	/** Reader over the whole body, can be created any number of times once every part is added. */
+	TSharedRef<FArchive, ESPMode::ThreadSafe> CreateReader() const;
+
+	struct FPart
+	{
+		// either in-memory bytes or a file read on demand
+		TArray<uint8> Bytes;
+		FString FilePath;
+		int64 Size = 0;
+		bool bText = false;
+	};
+	using FPartRef = TSharedRef<FPart, ESPMode::ThreadSafe>;
+
+private:
+	void AppendText(const FString& Text);
+	void AppendPartHeader(const FString& Name, const FString* FileName, const FString* ContentType);
+	FPartRef MakeTrailer() const;
+
+	FString Boundary;
+	TArray<FPartRef> Parts;
+};
@@ -29,7 +29,7 @@ public:
 	FCompletion ParseCompletionsResponse(const FJsonObject&);
 	FCompletionInfo ParseGPTCompletionInfo(const FJsonObject&);
 	FChatCompletion ParseChatCompletion(const FJsonObject&);
-	FSpeechCompletion ParseSpeechCompletion (const FJsonObject&);
+	FSpeechCompletion ParseSpeechCompletion(const TArray<uint8>& audio);
 	FString ParseTranscriptionCompletion(const FJsonObject&);
 	FString ParseGeneratedImage(FJsonObject&);
 };
@@ -0,0 +1,48 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+/**
+ * Limits how many requests are in flight and how many are started per minute.
+ * Requests are started in the order they were queued. Game thread only.
+ */
+class OPENAIAPI_API FOpenAIRequestQueue : public TSharedFromThis<FOpenAIRequestQueue>
+{
+public:
+	/** Must be called exactly once when the request is done, successful or not. */
+	using FOnRequestDone = TFunction<void()>;
+	using FRequest = TFunction<void(FOnRequestDone Done)>;
+
+	/** RequestsPerMinute of 0 leaves the start rate unlimited. */
+	static TSharedRef<FOpenAIRequestQueue> Create(int32 MaxConcurrent, int32 RequestsPerMinute = 0);
+	~FOpenAIRequestQueue();
+
+	void Enqueue(FRequest Request);
+
+	/** Drops every request that has not started yet. */
+	void CancelPending();
+
+	int32 NumPending() const { return Pending.Num() - NextPending; }
+	int32 NumActive() const { return NumInFlight; }
+
+private:
+	FOpenAIRequestQueue(int32 InMaxConcurrent, int32 InRequestsPerMinute);
+
+	void Pump();
+	bool CanStartRequest(double Now);
+	void OnRequestDone();
+	bool Tick(float DeltaTime);
+
+	int32 MaxConcurrent = 1;
+	int32 RequestsPerMinute = 0;
+	int32 NumInFlight = 0;
+
+	TArray<FRequest> Pending;
+	int32 NextPending = 0;
+	TArray<double> RecentStarts;
+
+	FTSTicker::FDelegateHandle TickHandle;
+};
@@ -0,0 +1,48 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+#include "Interfaces/IHttpRequest.h"
+
+/**
+ * One request to the audio/speech endpoint that hands the audio over while it downloads.
+ * Callbacks run on the game thread. The request keeps itself alive until it completes or is cancelled.
+ */
+class OPENAIAPI_API FOpenAISpeechRequest : public TSharedFromThis<FOpenAISpeechRequest>
+{
+public:
+	/** Bytes received since the last call. For pcm the view always holds whole samples. */
+	using FOnAudio = TFunction<void(TArrayView<const uint8> Audio)>;
+	using FOnDone = TFunction<void(const TArray<uint8>& Audio, const FString& ErrorMessage, bool Success)>;
+
+	/** pcm output of the speech endpoint. */
+	static constexpr int32 PCMSampleRate = 24000;
+
+	static TSharedRef<FOpenAISpeechRequest> Start(const FSpeechSettings& Settings, FOnAudio OnAudio, FOnDone OnDone);
+
+	/** OnDone is not called for a cancelled request. */
+	void Cancel();
+
+	static FString GetModelName(EOASpeechEngineType Model);
+	static FString GetVoiceName(EOASpeechVoice Voice);
+	static FString GetFormatName(EOASpeechResponseFormat Format);
+	static FString GetFileExtension(EOASpeechResponseFormat Format);
+
+private:
+	FOpenAISpeechRequest(const FSpeechSettings& InSettings, FOnAudio InOnAudio, FOnDone InOnDone);
+
+	void Send();
+	void OnProgress(FHttpRequestPtr Request);
+	void OnComplete(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	void DeliverAudio(const TArray<uint8>& Content);
+
+	FSpeechSettings Settings;
+	FOnAudio OnAudio;
+	FOnDone OnDone;
+
+	TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> HttpRequest;
+	TSharedPtr<FOpenAISpeechRequest> Self;
+	int64 NumDelivered = 0;
+};
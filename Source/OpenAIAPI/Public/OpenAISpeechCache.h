@@ -0,0 +1,77 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIDiskCache.h"
+
+class FOpenAIRequestQueue;
+
+/**
+ * Cache in front of the speech endpoint, keyed by model, voice, speed, response format and input text.
+ * Audio is kept on disk under Saved/SpeechCache with an LRU size budget. Recently used pcm lines also stay in memory
+ * as raw samples ready to queue on a sound, other formats are only useful as files and are always read from disk.
+ * The memory and disk budgets are separate, a line in memory may no longer have a file. Game thread only.
+ */
+class OPENAIAPI_API FOpenAISpeechCache
+{
+public:
+	using FAudio = FOpenAIDiskCache::FData;
+
+	static FOpenAISpeechCache& Get();
+
+	void SetLimits(int64 MaxDiskBytes, int64 MaxMemoryBytes);
+
+	/** File name the line is cached under. */
+	static FString MakeKey(const FSpeechSettings& Settings);
+	FString GetFilePath(const FSpeechSettings& Settings) const;
+
+	/** pcm samples already in memory, without touching the disk. */
+	FAudio FindInMemory(const FSpeechSettings& Settings);
+
+	/** Calls OnFound with the cached audio, or null when the line has not been synthesized yet. */
+	void Find(const FSpeechSettings& Settings, TFunction<void(FAudio Audio)> OnFound);
+
+	/** Stores the audio returned by the endpoint. OnWritten runs once the file is on disk. */
+	void Store(const FSpeechSettings& Settings, const TArray<uint8>& Audio, TFunction<void(bool Success)> OnWritten = nullptr);
+
+	/**
+	 * Saves audio that was requested without the cache to a new file under Saved/SpeechAudio.
+	 * That directory has its own LRU size budget, so files of old lines are deleted. OnSaved gets the path, empty when the write failed.
+	 */
+	void SaveUncached(const FSpeechSettings& Settings, const TArray<uint8>& Audio, TFunction<void(const FString& FilePath)> OnSaved);
+
+	/** Directory SaveUncached writes to, and a new file name in it for the response format. Callable from any thread. */
+	static FString GetUncachedDirectory();
+	static FString MakeUncachedFileName(const FSpeechSettings& Settings);
+
+	/** Bytes of the file written for the audio returned by the endpoint, pcm gets a wav header. Callable from any thread. */
+	static FAudio MakeFileData(const FSpeechSettings& Settings, const TArray<uint8>& Audio);
+
+	/**
+	 * Synthesizes the lines that are not cached yet with at most MaxConcurrent requests and loads pcm lines into memory.
+	 * Meant for level load, OnDone gets the number of lines that are ready.
+	 */
+	void Prewarm(const TArray<FSpeechSettings>& Lines, int32 MaxConcurrent = 4, TFunction<void(int32 NumReady, int32 NumFailed)> OnDone = nullptr);
+
+private:
+	FOpenAISpeechCache();
+
+	void AddToMemory(const FString& Key, FAudio Audio);
+
+	TSharedRef<FOpenAIDiskCache> Disk;
+	TSharedRef<FOpenAIDiskCache> UncachedDisk;
+
+	struct FHotEntry
+	{
+		FAudio Audio;
+		uint64 LastUse = 0;
+	};
+	TMap<FString, FHotEntry> Hot;
+	int64 HotBytes = 0;
+	int64 MaxHotBytes = 0;
+	uint64 UseCounter = 0;
+
+	TSharedPtr<FOpenAIRequestQueue> PrewarmQueue;
+};
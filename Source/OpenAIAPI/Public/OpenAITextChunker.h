@@ -0,0 +1,26 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Splits text into overlapping chunks sized in tokens for embedding.
+ * Token counts are estimated per word (about four characters per token, at least one per word and per punctuation mark),
+ * which tracks the OpenAI tokenizers closely enough for sizing and needs no vocabulary.
+ * Chunks end on sentence or paragraph boundaries where one is available.
+ */
+class OPENAIAPI_API FOpenAITextChunker
+{
+public:
+	static int32 EstimateTokens(const FStringView& Text);
+
+	/** Chunks of at most ChunkTokens, each starting OverlapTokens before the end of the previous one. */
+	static TArray<FString> Chunk(const FString& Text, int32 ChunkTokens = 400, int32 OverlapTokens = 50);
+
+	/** Chunks every document in parallel, large documents are first split into sections at paragraph breaks. */
+	static TArray<FString> ChunkDocuments(const TArray<FString>& Documents, int32 ChunkTokens = 400, int32 OverlapTokens = 50);
+
+	/** Hex SHA1 of the UTF-8 text, identical chunks get identical ids. */
+	static FString HashChunk(const FString& Chunk);
+};
@@ -0,0 +1,83 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "Interfaces/IHttpRequest.h"
+#include "OpenAITranscribeLongAudio.generated.h"
+
+class FOpenAIRequestQueue;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnLongTranscriptionProgressPin, const FTranscriptionSegment&, Piece, int32, PiecesDone, int32, PiecesTotal);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnLongTranscriptionFinishedPin, const FString&, Transcription, const TArray<FTranscriptionSegment>&, Segments, const FString&, ErrorMessage, bool, Success);
+
+/**
+ * Transcription of recordings too long for one request.
+ * The audio is decoded, downmixed and resampled on worker threads and split into pieces that end in pauses,
+ * silence between pieces is never uploaded. Pieces are transcribed concurrently under the request limits
+ * and stitched back in order, with segment timestamps offset to the position of their piece in the recording.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAITranscribeLongAudio : public UBlueprintAsyncActionBase
+{
+public:
+	GENERATED_BODY()
+
+public:
+	UOpenAITranscribeLongAudio();
+	~UOpenAITranscribeLongAudio();
+
+	/** PCM wav file, absolute or relative to the project directory. */
+	FString FilePath;
+
+	/** Interleaved float samples transcribed instead of FilePath, for C++ callers that already have the audio. */
+	TArray<float> Samples;
+	int32 SampleRate = 48000;
+	int32 NumChannels = 1;
+
+	FLongTranscriptionSettings Settings;
+
+	/** Fires for every transcribed piece, in completion order. */
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnLongTranscriptionProgressPin Progress;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnLongTranscriptionFinishedPin Finished;
+
+	/** Stops sending pieces, Finished fires once the pieces in flight are back. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Cancel();
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+	static UOpenAITranscribeLongAudio* OpenAITranscribeLongAudio(FString FilePath, FLongTranscriptionSettings Settings);
+
+	virtual void Activate() override;
+
+	struct FPiece
+	{
+		TArray<uint8> Wav;
+		float StartTime = 0.0f;
+		float EndTime = 0.0f;
+		TArray<FTranscriptionSegment> Segments;
+	};
+
+	void OnSplit(TArray<FPiece>&& InPieces);
+	void SendPiece(int32 PieceIndex, int32 Attempt, TFunction<void()> Done);
+	void OnPieceResponse(int32 PieceIndex, int32 Attempt, TFunction<void()> Done, FHttpResponsePtr Response, bool WasSuccessful);
+	void OnPieceDone();
+	void Finish();
+
+	FString ApiKey;
+	TArray<FPiece> Pieces;
+	TSharedPtr<FOpenAIRequestQueue> RequestQueue;
+
+	int32 NumPiecesExpected = 0;
+	int32 NumPiecesDone = 0;
+	int32 NumPiecesFailed = 0;
+	FString LastError;
+	bool bCancelled = false;
+	bool bFinished = false;
+};
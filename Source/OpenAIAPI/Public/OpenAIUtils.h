@@ -55,6 +55,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "OpenAI")
 	static float HDVectorDotProductSIMD(const FHighDimensionalVector& A, const FHighDimensionalVector& B);
 
+	/** Name of the SIMD kernel picked for this CPU, e.g. AVX2 or NEON. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static FString GetHDVectorSIMDKernelName();
+
 	UFUNCTION(BlueprintCallable, Category = "OpenAI")
 	static float HDVectorLengthSIMD(const FHighDimensionalVector& Vector);
 
@@ -69,4 +73,63 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "OpenAI")
 	static float HDVectorCosineSimilarity(const FHighDimensionalVector& A, const FHighDimensionalVector& B);
+
+public:
+	/** Returns the vector scaled to unit length. Cosine similarity between normalized vectors is just their dot product. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static FHighDimensionalVector HDVectorNormalize(const FHighDimensionalVector& Vector);
+
+	/** Fast path for vectors that went through HDVectorNormalize, skips the length computation entirely. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static float HDVectorCosineSimilarityNormalized(const FHighDimensionalVector& A, const FHighDimensionalVector& B);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static FHighDimensionalVectorMatrix MakeHDVectorMatrix(const TArray<FHighDimensionalVector>& Vectors);
+
+	/**
+	 * Cosine similarity of the query against every vector, in input order. Set bNormalized if all vectors are unit length.
+	 * Vectors of another dimension are skipped with a warning and score 0.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static TArray<float> HDVectorCosineSimilarityBatch(const FHighDimensionalVector& Query, const TArray<FHighDimensionalVector>& Vectors, bool bNormalized = false);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static TArray<float> HDVectorMatrixCosineSimilarityBatch(const FHighDimensionalVector& Query, const FHighDimensionalVectorMatrix& Matrix, bool bNormalized = false);
+
+	/** Indices of the TopK most similar vectors with their scores, best first. Vectors of another dimension are left out. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static TArray<FHDVectorSearchResult> HDVectorRankBySimilarity(const FHighDimensionalVector& Query, const TArray<FHighDimensionalVector>& Vectors, int32 TopK = 10, bool bNormalized = false);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static TArray<FHDVectorSearchResult> HDVectorMatrixRankBySimilarity(const FHighDimensionalVector& Query, const FHighDimensionalVectorMatrix& Matrix, int32 TopK = 10, bool bNormalized = false);
+
+public:
+	/** Packs a vector as FP16 or INT8. Use QuantizeHDVectorProduct for product quantization. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static FQuantizedHighDimensionalVector QuantizeHDVector(const FHighDimensionalVector& Vector, EOAVectorQuantization Format);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static FQuantizedHighDimensionalVector QuantizeHDVectorProduct(const FHighDimensionalVector& Vector, const FProductQuantizer& Quantizer);
+
+	/** Quantizer is only used for product quantized vectors. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static FHighDimensionalVector DequantizeHDVector(const FQuantizedHighDimensionalVector& Quantized, const FProductQuantizer& Quantizer);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static FProductQuantizer TrainProductQuantizer(const TArray<FHighDimensionalVector>& Samples, int32 NumSubspaces = 96, int32 NumCentroids = 256, int32 Iterations = 10);
+
+	/** Approximate dot product of a full precision query with an FP16 or INT8 vector. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static float HDVectorDotProductQuantized(const FHighDimensionalVector& Query, const FQuantizedHighDimensionalVector& Quantized);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static float HDVectorCosineSimilarityQuantized(const FHighDimensionalVector& Query, const FQuantizedHighDimensionalVector& Quantized);
+
+	/**
+	 * Ranks quantized candidates against the query, then rescores the ShortlistSize best with HDVectorCosineSimilarity.
+	 * Pass the float vectors in the same order as Candidates to rescore, or an empty array to keep approximate scores.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static TArray<FHDVectorSearchResult> HDVectorSearchQuantized(const FHighDimensionalVector& Query, const TArray<FQuantizedHighDimensionalVector>& Candidates,
+		const TArray<FHighDimensionalVector>& FullVectors, const FProductQuantizer& Quantizer, int32 TopK = 10, int32 ShortlistSize = 100);
 };
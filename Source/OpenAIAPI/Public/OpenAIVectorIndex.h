@@ -0,0 +1,88 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIVectorStore.h"
+#include "OpenAIBM25Index.h"
+#include "OpenAIVectorIndex.generated.h"
+
+/**
+ * Blueprint handle to an FOpenAIVectorStore holding text chunks and their embeddings.
+ * The chunk text is kept as the entry metadata so search results can go straight into a prompt.
+ */
+UCLASS(BlueprintType)
+class OPENAIAPI_API UOpenAIVectorIndex : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Opens or creates the index file at Path, relative paths are resolved against the project Saved directory. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static UOpenAIVectorIndex* OpenVectorIndex(const FString& Path, int32 Dimension = 1536);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static UOpenAIVectorIndex* CreateInMemoryVectorIndex(int32 Dimension = 1536);
+
+	/** The entry shows up in searches after Flush, or once enough entries are pending to publish them as a segment. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	bool AddEntry(const FString& Id, const FString& Text, const FHighDimensionalVector& Vector);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	bool Contains(const FString& Id) const;
+
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	int32 Num() const;
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	TArray<FVectorIndexMatch> Search(const FHighDimensionalVector& Query, int32 TopK = 5) const;
+
+	/** Coarse int8 scan over truncated vectors followed by an exact rerank of the shortlist, Score is the exact cosine similarity. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	TArray<FVectorIndexMatch> SearchTwoStage(const FHighDimensionalVector& Query, const FTwoStageSearchSettings& Settings) const;
+
+	/**
+	 * BM25 keyword search over the entry text. The keyword index is brought up to date on a worker,
+	 * so entries published since the last search may only show up in the next one.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	TArray<FVectorIndexMatch> SearchLexical(const FString& QueryText, int32 TopK = 5) const;
+
+	/** Keyword and vector search fused with reciprocal rank fusion, Score is the fused score. Keyword matches lag like in SearchLexical. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	TArray<FVectorIndexMatch> SearchHybrid(const FString& QueryText, const FHighDimensionalVector& QueryVector, const FHybridSearchSettings& Settings) const;
+
+	/** Makes pending entries searchable and flushes them to disk. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Flush();
+
+	/** Folds the append log into the index file on a worker thread. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Compact();
+
+	/** The underlying store, safe to search from any thread. */
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> GetStore() const { return Store; }
+
+	/** Keyword index over the entry text, mirrored from the store on a worker after opening and on every lexical or hybrid search. */
+	TSharedPtr<FOpenAIBM25Index, ESPMode::ThreadSafe> GetLexicalIndex() const { return LexicalIndex; }
+
+	/** Thread safe search, results are resolved to their ids and text. */
+	static TArray<FVectorIndexMatch> SearchStore(const FOpenAIVectorStore& Store, const FHighDimensionalVector& Query, int32 TopK);
+
+	/** Thread safe hybrid search, see SearchHybrid. Indexes any entries the keyword index is missing first, so call it off the game thread. */
+	static TArray<FVectorIndexMatch> SearchStoreHybrid(const FOpenAIVectorStore& Store, FOpenAIBM25Index& LexicalIndex, const FString& QueryText, const FHighDimensionalVector& QueryVector, const FHybridSearchSettings& Settings);
+
+private:
+	/** Starts mirroring new store entries into the keyword index on the thread pool unless that is already running. */
+	void StartLexicalSync() const;
+
+	static void SyncLexicalIndex(const FOpenAIVectorStore& Store, FOpenAIBM25Index& LexicalIndex);
+	static TArray<FVectorIndexMatch> SearchHybridIndexed(const FOpenAIVectorStore& Store, const FOpenAIBM25Index& LexicalIndex, const FString& QueryText, const FHighDimensionalVector& QueryVector, const FHybridSearchSettings& Settings);
+	static TArray<FVectorIndexMatch> ResolveMatches(const FOpenAIVectorStore& Store, const TArray<FHDVectorSearchResult>& Results);
+
+	TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Store;
+	TSharedPtr<FOpenAIBM25Index, ESPMode::ThreadSafe> LexicalIndex = MakeShared<FOpenAIBM25Index, ESPMode::ThreadSafe>();
+	mutable TFuture<void> LexicalSync;
+};
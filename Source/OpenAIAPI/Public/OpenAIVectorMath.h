@@ -0,0 +1,65 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+
+/**
+ * Float kernels behind the HDVector functions in UOpenAIUtils.
+ * The widest kernel the CPU supports (AVX-512, AVX2+FMA, SSE or NEON) is picked on first use,
+ * any dimension is accepted and the scalar kernel is kept as the reference the SIMD ones are verified against.
+ */
+class OPENAIAPI_API FOpenAIVectorMath
+{
+public:
+	static float DotProduct(const float* A, const float* B, int32 Num);
+
+	/** Plain loop, used as the reference implementation. */
+	static float DotProductScalar(const float* A, const float* B, int32 Num);
+
+	/** A.B, A.A and B.B accumulated in a single pass over both arrays. */
+	static void DotProductAndNorms(const float* A, const float* B, int32 Num, float& OutAB, float& OutAA, float& OutBB);
+
+	/** Single pass cosine similarity, 0 when either vector has no length. */
+	static float CosineSimilarity(const float* A, const float* B, int32 Num);
+
+	/** Scales Data to unit length in place, so cosine similarity against other unit vectors is a plain DotProduct. */
+	static void Normalize(float* Data, int32 Num);
+
+	/**
+	 * Scores one query against NumRows vectors of Num floats laid out back to back.
+	 * With bNormalized the rows and query are assumed unit length and only the dot product is taken.
+	 * Large batches are split across the task graph.
+	 */
+	static void CosineSimilarityBatch(const float* Query, const float* Rows, int32 NumRows, int32 Num, bool bNormalized, float* OutScores);
+
+	/** Same as above for vectors that are not contiguous in memory. */
+	static void CosineSimilarityBatch(const float* Query, TArrayView<const float* const> Rows, int32 Num, bool bNormalized, float* OutScores);
+
+	static int32 DotProductInt8(const int8* A, const int8* B, int32 Num);
+
+	/** Symmetric per-vector int8 quantization of Data into OutCodes, returns the scale that maps a code back to a float. */
+	static float QuantizeInt8(const float* Data, int32 Num, int8* OutCodes);
+
+	/** Int8 dot product of Query against NumRows rows of Num codes laid out back to back, each multiplied by its row weight. */
+	static void DotProductInt8Batch(const int8* Query, const int8* Rows, const float* RowWeights, int32 NumRows, int32 Num, float* OutScores);
+
+	/** Indices and scores of the K highest scores, sorted descending. */
+	static TArray<FHDVectorSearchResult> SelectTopK(TArrayView<const float> Scores, int32 K);
+
+	/** Keeps the K best results in Heap, a min-heap so the weakest kept result is always on top. */
+	static void PushTopResult(TArray<FHDVectorSearchResult>& Heap, int32 K, const FHDVectorSearchResult& Result);
+
+	/**
+	 * Reciprocal rank fusion: each result scores the sum of Weight / (RankConstant + rank) over the rankings it appears in.
+	 * Only ranks are used, so rankings with unrelated score scales (BM25, cosine) can be merged. Missing weights count as 1.
+	 */
+	static TArray<FHDVectorSearchResult> FuseReciprocalRank(TArrayView<const TArray<FHDVectorSearchResult>> Rankings, TArrayView<const float> Weights, int32 K, float RankConstant = 60.0f);
+
+	/** Name of the kernel DotProduct dispatches to, e.g. "AVX2". */
+	static const TCHAR* GetKernelName();
+
+	/** Checks every kernel available on this CPU against the scalar one for dimensions 0..MaxDimension. */
+	static bool VerifyKernels(int32 MaxDimension = 67);
+};
@@ -0,0 +1,41 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+
+/**
+ * Compact storage for embedding vectors.
+ * FP16 and INT8 vectors are scored directly against a float query, PRODUCT vectors through a per-query distance table.
+ */
+class OPENAIAPI_API FOpenAIVectorQuantization
+{
+public:
+	static FQuantizedHighDimensionalVector QuantizeFP16(const FHighDimensionalVector& Vector);
+	static FQuantizedHighDimensionalVector QuantizeInt8(const FHighDimensionalVector& Vector);
+	static FQuantizedHighDimensionalVector QuantizeProduct(const FHighDimensionalVector& Vector, const FProductQuantizer& Quantizer);
+
+	/** Reconstructs the float vector, PRODUCT vectors need the quantizer they were encoded with. */
+	static FHighDimensionalVector Dequantize(const FQuantizedHighDimensionalVector& Quantized, const FProductQuantizer* Quantizer = nullptr);
+
+	/** Runs k-means per subspace over the samples. NumCentroids is clamped to [1, 256] and to the sample count. */
+	static FProductQuantizer TrainProductQuantizer(const TArray<FHighDimensionalVector>& Samples, int32 NumSubspaces, int32 NumCentroids = 256, int32 Iterations = 10);
+
+	/** Inner products of each query subvector with each centroid of its subspace, NumSubspaces x NumCentroids. */
+	static void BuildDistanceTable(const float* Query, const FProductQuantizer& Quantizer, TArray<float>& OutTable);
+
+	/** Approximate dot product of a float query with an FP16 or INT8 vector. */
+	static float DotProduct(const float* Query, const FQuantizedHighDimensionalVector& Quantized);
+
+	/** Approximate dot product of a query with a PRODUCT vector, summed from a BuildDistanceTable table. */
+	static float DotProduct(const TArray<float>& DistanceTable, const FQuantizedHighDimensionalVector& Quantized, int32 NumCentroids);
+
+	/**
+	 * Scores every candidate with its quantized form, then rescores the best ShortlistSize exactly against FullVectors.
+	 * FullVectors may be empty, in which case the approximate scores are returned. Results are sorted by descending cosine similarity.
+	 * Candidates that don't match the query dimension or have broken codes are left out, so fewer than TopK results may come back.
+	 */
+	static TArray<FHDVectorSearchResult> Search(const FHighDimensionalVector& Query, const TArray<FQuantizedHighDimensionalVector>& Candidates,
+		const TArray<FHighDimensionalVector>& FullVectors, const FProductQuantizer* Quantizer, int32 TopK, int32 ShortlistSize);
+};
@@ -0,0 +1,152 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+#include "Async/Future.h"
+#include "Misc/ScopeRWLock.h"
+
+class IFileHandle;
+
+/**
+ * Persistent embedding store.
+ *
+ * The store file is a header, an id table, a 64 byte aligned block of float vectors and a metadata blob.
+ * It is memory mapped read-only, so opening costs nothing beyond validating the header and searches read the vectors in place.
+ * Vectors added after opening go to an append log next to the store (<Path>.log) that is replayed on open,
+ * Compact folds the log back into a fresh store file.
+ *
+ * Readers work on immutable snapshots of the store, a list of segments that is replaced as a whole when new entries are published.
+ * Searches only hold the snapshot lock long enough to copy a pointer, so they never wait on inserts or compaction.
+ * Added entries are buffered and published as one segment once SegmentSize are pending, on AddBatch or on Flush.
+ */
+class OPENAIAPI_API FOpenAIVectorStore : public TSharedFromThis<FOpenAIVectorStore, ESPMode::ThreadSafe>
+{
+public:
+	static constexpr uint32 FileMagic = 0x5356414F;	// "OAVS"
+	static constexpr uint32 FileVersion = 1;
+
+	/** Pending adds that trigger a publish. */
+	static constexpr int32 SegmentSize = 256;
+
+	~FOpenAIVectorStore();
+
+	/**
+	 * Maps the store at Path, creating an empty one when there is none.
+	 * With bNormalize vectors are stored unit length and searched with plain dot products, this is fixed when the file is created.
+	 */
+	static TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> Open(const FString& Path, int32 Dimension, bool bNormalize = true);
+
+	/** Store that lives only in memory, Compact and the append log are no-ops. */
+	static TSharedPtr<FOpenAIVectorStore, ESPMode::ThreadSafe> CreateInMemory(int32 Dimension, bool bNormalize = true);
+
+	/**
+	 * Appends a vector and writes it to the log. Ids are expected to be unique, use Contains to skip known ones.
+	 * The entry becomes visible to readers when its segment is published.
+	 */
+	bool Add(const FString& Id, const FHighDimensionalVector& Vector, const FString& Metadata = TEXT(""));
+
+	/** Appends every entry and publishes them together with anything still pending. */
+	bool AddBatch(const TArray<FString>& Ids, const TArray<FHighDimensionalVector>& Vectors, const TArray<FString>& Metadata);
+
+	/** Publishes pending entries and flushes the append log to disk, call after a batch of Add to make it survive a crash. */
+	void Flush();
+
+	/** Published entries. */
+	int32 Num() const;
+	int32 NumPending() const;
+	int32 GetDimension() const { return Dimension; }
+	bool IsNormalized() const { return bNormalized; }
+	const FString& GetPath() const { return Path; }
+
+	bool Contains(const FString& Id) const;
+
+	/** INDEX_NONE when the id is unknown. The id lookup table is built on first use so opening stays cheap. */
+	int32 FindIndex(const FString& Id) const;
+
+	FString GetId(int32 Index) const;
+	FString GetMetadata(int32 Index) const;
+
+	/** Copy of the vector at Index. */
+	FHighDimensionalVector GetVector(int32 Index) const;
+
+	/** Cosine similarity search over every published vector, best first. */
+	TArray<FHDVectorSearchResult> Search(const FHighDimensionalVector& Query, int32 TopK) const;
+
+	/** Cosine similarity search restricted to the entries in Indices, e.g. candidates from a lexical prefilter. */
+	TArray<FHDVectorSearchResult> Search(const FHighDimensionalVector& Query, TArrayView<const int32> Indices, int32 TopK) const;
+
+	/**
+	 * Approximate search that scans int8 codes of the leading Settings.coarseDimensions components of every vector,
+	 * then rescores the best Settings.shortlistSize with full precision cosine similarity.
+	 * The codes are built per segment on first use.
+	 */
+	TArray<FHDVectorSearchResult> SearchTwoStage(const FHighDimensionalVector& Query, const FTwoStageSearchSettings& Settings) const;
+
+	/**
+	 * Rewrites the store with the append log folded in and starts a new log. Blocks while the new file is written.
+	 * Returns false right away while a snapshot from before the previous compaction is still held, call again once searches on it are done.
+	 */
+	bool Compact();
+
+	/** Compact on the thread pool. Adds and searches keep working while the new file is written. */
+	TFuture<bool> CompactAsync();
+
+private:
+	struct FSegment;
+	struct FMappedSegment;
+	struct FMemorySegment;
+	struct FSnapshot;
+
+	using FSegmentPtr = TSharedPtr<const FSegment, ESPMode::ThreadSafe>;
+	using FSnapshotPtr = TSharedPtr<const FSnapshot, ESPMode::ThreadSafe>;
+
+	FOpenAIVectorStore(const FString& InPath, int32 InDimension, bool bInNormalize);
+
+	FSnapshotPtr GetSnapshot() const;
+	void Publish(FSnapshotPtr Snapshot);
+	void PublishPending();
+	bool AddPending(const FString& Id, const FHighDimensionalVector& Vector, const FString& Metadata);
+
+	bool OpenStoreFile();
+	FSegmentPtr MapStoreFile(const FString& FilePath, uint64& OutGeneration, bool& bOutNormalized) const;
+	bool ReplayLog();
+	bool OpenLogForAppend(bool bTruncate);
+	bool OpenLogFile(const FString& LogPath, bool bTruncate);
+
+	/** Replaces the log with one for the current generation holding the entries from FirstIndex on and the pending ones. */
+	bool RewriteLog(const FSnapshot& Snapshot, int32 FirstIndex);
+	bool WriteLogRecord(const FString& Id, const float* Vector, const FString& Metadata);
+	bool WriteStoreFile(const FString& TargetPath, uint64 Generation, const FSnapshot& Snapshot) const;
+
+	static FString DecodeUTF8(const uint8* Bytes, uint32 Length);
+
+private:
+	FString Path;
+	int32 Dimension = 0;
+	bool bNormalized = true;
+	bool bInMemory = false;
+
+	// the live store file alternates between Path and an alternate path, so compaction never overwrites a file a reader still maps
+	FString ActiveFilePath;
+	uint64 Generation = 0;
+	TWeakPtr<const FSegment, ESPMode::ThreadSafe> RetiredBase;
+
+	FSnapshotPtr Current;
+	mutable FRWLock SnapshotLock;
+
+	// entries added since the last publish, serialized with the log and publishing by WriteMutex
+	TArray<FString> PendingIds;
+	TArray<FString> PendingMetadata;
+	TArray<float> PendingVectors;
+
+	IFileHandle* LogHandle = nullptr;
+	mutable FCriticalSection WriteMutex;
+	FCriticalSection CompactionMutex;
+
+	// compaction keeps entry order, so the lookup stays valid and only grows
+	mutable TMap<FString, int32> IdLookup;
+	mutable int32 NumIdsIndexed = 0;
+	mutable FRWLock IdLookupLock;
+};